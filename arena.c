@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#if defined(__linux__)
+    #define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+
+struct arena_t {
+    char *base;
+    size_t size;
+    size_t used;
+    char *mapping;          /* What to unmap, may start before base. */
+    size_t mapping_size;
+    arena_pages_t pages;
+};
+
+/*
+ * Internal functions' prototypes
+ */
+
+#if defined(MAP_HUGETLB)
+static size_t huge_page_size(void);
+#endif
+
+arena_check_t arena_init(arena_t **arena_ptr, size_t size)
+{
+    arena_t *arena;
+    size_t slack;
+#if defined(MAP_HUGETLB)
+    size_t hugetlb_size;
+#endif
+
+    if ((*arena_ptr = arena = calloc(1, sizeof(arena_t))) == NULL)
+        return ARENA_CHECK_ERR_MEM_ALLOC;
+
+    size = arena_round((size > 0) ? size : 1, ARENA_REGION_ALIGN);
+
+#if defined(MAP_HUGETLB)
+    /* Explicit huge pages only exist if the administrator reserved them. */
+    hugetlb_size = arena_round(size, huge_page_size());
+    arena->mapping = mmap(NULL, hugetlb_size, PROT_READ|PROT_WRITE,
+                          MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+
+    if (arena->mapping != MAP_FAILED) {
+        arena->base = arena->mapping;
+        arena->mapping_size = hugetlb_size;
+        arena->size = hugetlb_size;
+        arena->pages = ARENA_PAGES_HUGETLB;
+
+        return ARENA_CHECK_OK;
+    }
+#endif
+
+    /*
+     * Map a bit more and start at a huge page boundary, so the kernel can
+     * back the arena with transparent huge pages from the first byte.
+     */
+    slack = ARENA_REGION_ALIGN;
+    arena->mapping = mmap(NULL, size + slack, PROT_READ|PROT_WRITE,
+                          MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+    if (arena->mapping == MAP_FAILED) {
+        free(arena);
+        *arena_ptr = NULL;
+        return ARENA_CHECK_ERR_MEM_ALLOC;
+    }
+
+    arena->mapping_size = size + slack;
+    arena->base = (char*)arena_round((uintptr_t)arena->mapping, ARENA_REGION_ALIGN);
+    arena->size = size;
+    arena->pages = ARENA_PAGES_NORMAL;
+
+#if defined(MADV_HUGEPAGE)
+    if (madvise(arena->base, arena->size, MADV_HUGEPAGE) == 0)
+        arena->pages = ARENA_PAGES_THP;
+#endif
+
+    return ARENA_CHECK_OK;
+}
+
+/* Returns NULL once the arena is used up. */
+void *arena_alloc(arena_t *arena, size_t size, size_t align)
+{
+    size_t offset = arena_round(arena->used, align);
+
+    if (offset > arena->size || size > arena->size - offset)
+        return NULL;
+
+    arena->used = offset + size;
+
+    return arena->base + offset;
+}
+
+size_t arena_size(arena_t *arena)
+{
+    return arena->size;
+}
+
+arena_pages_t arena_pages(arena_t *arena)
+{
+    return arena->pages;
+}
+
+const char *arena_pages_name(arena_pages_t pages)
+{
+    switch (pages) {
+        case ARENA_PAGES_HUGETLB:
+            return "huge pages";
+
+        case ARENA_PAGES_THP:
+            return "transparent huge pages";
+
+        default:
+            return "normal pages";
+    }
+}
+
+void arena_destroy(arena_t *arena)
+{
+    if (arena == NULL)
+        return;
+
+    munmap(arena->mapping, arena->mapping_size);
+    free(arena);
+}
+
+#if defined(MAP_HUGETLB)
+/* The default huge page size, which MAP_HUGETLB mappings are made of. */
+static size_t huge_page_size(void)
+{
+    FILE *meminfo;
+    char line[128];
+    unsigned long size_kb;
+    size_t size = ARENA_REGION_ALIGN;
+
+    if ((meminfo = fopen("/proc/meminfo", "r")) == NULL)
+        return size;
+
+    while (fgets(line, sizeof(line), meminfo) != NULL) {
+        if (sscanf(line, "Hugepagesize: %lu kB", &size_kb) == 1) {
+            size = size_kb * 1024;
+            break;
+        }
+    }
+
+    fclose(meminfo);
+
+    return size;
+}
+#endif
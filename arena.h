@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * One big mapping that every I/O buffer of the run is carved from. It is
+ * backed by explicit huge pages (MAP_HUGETLB) when the system has them
+ * reserved, and otherwise asks for transparent huge pages. Large blocks
+ * then need far fewer TLB entries when they are filled and compared, and
+ * the kernel pins far fewer pages when the buffers are set up for DMA.
+ *
+ * Buffers are carved by a bump allocator before the workers start, so
+ * there is no locking and nothing is ever freed on its own.
+ */
+
+#define ARENA_BUFFER_ALIGN 4096
+#define ARENA_REGION_ALIGN (2 * 1024 * 1024)
+
+typedef struct arena_t arena_t;
+
+typedef enum {
+    ARENA_CHECK_OK = 0,
+    ARENA_CHECK_ERR_MEM_ALLOC
+} arena_check_t;
+
+typedef enum {
+    ARENA_PAGES_HUGETLB = 0,
+    ARENA_PAGES_THP,
+    ARENA_PAGES_NORMAL
+} arena_pages_t;
+
+static inline size_t arena_round(size_t size, size_t align)
+{
+    return (size + align - 1) / align * align;
+}
+
+arena_check_t arena_init(arena_t**, size_t);
+void *arena_alloc(arena_t*, size_t, size_t);
+size_t arena_size(arena_t*);
+arena_pages_t arena_pages(arena_t*);
+const char *arena_pages_name(arena_pages_t);
+void arena_destroy(arena_t*);
+
+#endif
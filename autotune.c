@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+    #include <limits.h>
+    #include <sys/sysmacros.h>
+#endif
+
+#include "arena.h"
+#include "badmap.h"
+#include "stats.h"
+#include "utils.h"
+#include "autotune.h"
+
+/* Candidates of each setting, beyond that the hints add. */
+#define AUTOTUNE_MAX_CANDIDATES 8
+#define AUTOTUNE_MIN_BLOCK_SIZE (64 * 1024)
+#define AUTOTUNE_MAX_BLOCK_SIZE (16 * 1024 * 1024)
+
+/* Chunks per worker in a probe, so no worker runs out of work early. */
+#define AUTOTUNE_CHUNKS_PER_WORKER 4
+#define AUTOTUNE_POLL_NS (10 * 1000000L)
+
+static const unsigned int block_sizes[] = {64 * 1024, 256 * 1024, 1024 * 1024, 4 * 1024 * 1024};
+static const unsigned int ssd_workers[] = {1, 2, 4, 8, 16};
+static const unsigned int hdd_workers[] = {1, 2, 4};
+static const unsigned int queue_depths[] = {4, 16, 64};
+
+/*
+ * Internal functions' prototypes
+ */
+
+#if defined(__linux__)
+static bool read_sysfs_uint(const char*, const char*, unsigned int*);
+#endif
+static void add_candidate(unsigned int*, unsigned int*, unsigned int);
+static bool fits_config(const workers_config_t*, unsigned int);
+static autotune_check_t run_probe(const workers_config_t*, uint64_t*);
+
+#if defined(__linux__)
+
+/* The request queue limits sysfs shows for the device, or for the disk of a partition. */
+autotune_check_t autotune_hints(const char *device_name, autotune_hints_t *hints)
+{
+    struct stat st;
+    char block_path[PATH_MAX];
+    char path[PATH_MAX + 32];
+    char *slash;
+    unsigned int value;
+
+    memset(hints, 0, sizeof(autotune_hints_t));
+
+    if (stat(device_name, &st) == -1)
+        return AUTOTUNE_CHECK_ERR_STAT;
+
+    snprintf(path, sizeof(path), "/sys/dev/block/%u:%u", major(st.st_rdev), minor(st.st_rdev));
+
+    if (realpath(path, block_path) == NULL)
+        return AUTOTUNE_CHECK_ERR_UNSUPPORTED;
+
+    snprintf(path, sizeof(path), "%s/partition", block_path);
+
+    if (access(path, F_OK) == 0 && (slash = strrchr(block_path, '/')) != NULL)
+        *slash = '\0';
+
+    if (read_sysfs_uint(block_path, "rotational", &value))
+        hints->rotational = value != 0;
+
+    read_sysfs_uint(block_path, "nr_requests", &hints->nr_requests);
+    read_sysfs_uint(block_path, "optimal_io_size", &hints->optimal_io_size);
+
+    if (read_sysfs_uint(block_path, "max_hw_sectors_kb", &value) && value < UINT_MAX / 1024)
+        hints->max_io_size = value * 1024;
+
+    return AUTOTUNE_CHECK_OK;
+}
+
+static bool read_sysfs_uint(const char *block_path, const char *name, unsigned int *value)
+{
+    char path[PATH_MAX + 32];
+    FILE *file;
+    bool result;
+
+    snprintf(path, sizeof(path), "%s/queue/%s", block_path, name);
+
+    if ((file = fopen(path, "r")) == NULL)
+        return false;
+
+    result = fscanf(file, "%u", value) == 1;
+    fclose(file);
+
+    return result;
+}
+
+#else
+
+/* Elsewhere the probes alone decide. */
+autotune_check_t autotune_hints(const char *device_name, autotune_hints_t *hints)
+{
+    (void)device_name;
+
+    memset(hints, 0, sizeof(autotune_hints_t));
+
+    return AUTOTUNE_CHECK_ERR_UNSUPPORTED;
+}
+
+#endif
+
+/*
+ * Probe every block size with every number of workers at the configured
+ * queue depth, then the queue depths at the best of those. The winner is
+ * written back to config, and its write+verify throughput to rate.
+ * Candidates that need more I/O buffers than memory_limit are skipped.
+ */
+autotune_check_t autotune_run(workers_config_t *config, const autotune_hints_t *hints,
+                              unsigned int fixed, size_t memory_limit, uint64_t *rate)
+{
+    workers_config_t probe_config = *config;
+    unsigned int sizes[AUTOTUNE_MAX_CANDIDATES];
+    unsigned int workers[AUTOTUNE_MAX_CANDIDATES];
+    unsigned int depths[AUTOTUNE_MAX_CANDIDATES];
+    unsigned int num_sizes = 0;
+    unsigned int num_workers = 0;
+    unsigned int num_depths = 0;
+    unsigned int depth = config->queue_depth;
+    uint64_t probe_rate;
+    char size[32];
+    autotune_check_t result;
+
+    *rate = 0;
+
+    if (fixed & AUTOTUNE_FIXED_BLOCKSIZE) {
+        add_candidate(sizes, &num_sizes, config->blocksize);
+    } else {
+        for (size_t i = 0; i < sizeof(block_sizes) / sizeof(block_sizes[0]); i++)
+            add_candidate(sizes, &num_sizes, block_sizes[i]);
+
+        /* A block of the preferred size, and one that fills a whole hardware request. */
+        if (hints->optimal_io_size >= AUTOTUNE_MIN_BLOCK_SIZE &&
+            hints->optimal_io_size <= AUTOTUNE_MAX_BLOCK_SIZE)
+            add_candidate(sizes, &num_sizes, hints->optimal_io_size);
+
+        if (hints->max_io_size >= AUTOTUNE_MIN_BLOCK_SIZE &&
+            hints->max_io_size <= AUTOTUNE_MAX_BLOCK_SIZE)
+            add_candidate(sizes, &num_sizes, hints->max_io_size);
+    }
+
+    /* A spinning disk seeks between streams, so it never gets many of them. */
+    if (fixed & AUTOTUNE_FIXED_WORKERS) {
+        add_candidate(workers, &num_workers, config->num_workers);
+    } else if (hints->rotational) {
+        for (size_t i = 0; i < sizeof(hdd_workers) / sizeof(hdd_workers[0]); i++)
+            add_candidate(workers, &num_workers, hdd_workers[i]);
+    } else {
+        for (size_t i = 0; i < sizeof(ssd_workers) / sizeof(ssd_workers[0]); i++)
+            add_candidate(workers, &num_workers, ssd_workers[i]);
+    }
+
+    /*
+     * psync keeps one block in flight per worker. Deeper queues than the
+     * device's request queue only wait in the block layer.
+     */
+    if (!(fixed & AUTOTUNE_FIXED_QUEUE_DEPTH) && config->engine == IOENGINE_IO_URING) {
+        for (size_t i = 0; i < sizeof(queue_depths) / sizeof(queue_depths[0]); i++) {
+            if (hints->nr_requests == 0 || queue_depths[i] <= hints->nr_requests)
+                add_candidate(depths, &num_depths, queue_depths[i]);
+        }
+
+        if (hints->nr_requests > 0 && depth > hints->nr_requests)
+            depth = hints->nr_requests;
+    }
+
+    probe_config.queue_depth = depth;
+    config->blocksize = 0;
+
+    for (unsigned int i = 0; i < num_sizes; i++) {
+        if (!fits_config(config, sizes[i]))
+            continue;
+
+        format_size(size, sizeof(size), sizes[i]);
+
+        for (unsigned int j = 0; j < num_workers; j++) {
+            if (workers_buffer_size(workers[j], depth, sizes[i], 0) > memory_limit)
+                continue;
+
+            probe_config.blocksize = sizes[i];
+            probe_config.num_workers = workers[j];
+
+            if ((result = run_probe(&probe_config, &probe_rate)) != AUTOTUNE_CHECK_OK)
+                return result;
+
+            fprintf(stderr, "  -b %s -w %u -q %u: %llu MB/s\n", size, workers[j], depth,
+                            (unsigned long long)(probe_rate / 1024 / 1024));
+
+            if (probe_rate > *rate || config->blocksize == 0) {
+                *rate = probe_rate;
+                config->blocksize = sizes[i];
+                config->num_workers = workers[j];
+                config->queue_depth = depth;
+            }
+        }
+    }
+
+    if (config->blocksize == 0)
+        return AUTOTUNE_CHECK_ERR_NO_CANDIDATE;
+
+    probe_config.blocksize = config->blocksize;
+    probe_config.num_workers = config->num_workers;
+    format_size(size, sizeof(size), config->blocksize);
+
+    for (unsigned int i = 0; i < num_depths; i++) {
+        if (depths[i] == depth ||
+            workers_buffer_size(config->num_workers, depths[i], config->blocksize, 0) >
+            memory_limit)
+            continue;
+
+        probe_config.queue_depth = depths[i];
+
+        if ((result = run_probe(&probe_config, &probe_rate)) != AUTOTUNE_CHECK_OK)
+            return result;
+
+        fprintf(stderr, "  -b %s -w %u -q %u: %llu MB/s\n", size, config->num_workers, depths[i],
+                        (unsigned long long)(probe_rate / 1024 / 1024));
+
+        if (probe_rate > *rate) {
+            *rate = probe_rate;
+            config->queue_depth = depths[i];
+        }
+    }
+
+    return AUTOTUNE_CHECK_OK;
+}
+
+/* Keep the candidates sorted and without duplicates. */
+static void add_candidate(unsigned int *candidates, unsigned int *num_candidates,
+                          unsigned int value)
+{
+    unsigned int i = 0;
+
+    while (i < *num_candidates && candidates[i] < value)
+        i++;
+
+    if ((i < *num_candidates && candidates[i] == value) ||
+        *num_candidates == AUTOTUNE_MAX_CANDIDATES)
+        return;
+
+    memmove(&candidates[i + 1], &candidates[i], (*num_candidates - i) * sizeof(unsigned int));
+    candidates[i] = value;
+    (*num_candidates)++;
+}
+
+/* A block size has to suit the sectors, the streaming window and the chunks of the run. */
+static bool fits_config(const workers_config_t *config, unsigned int blocksize)
+{
+    return blocksize >= config->sector_size && blocksize % config->sector_size == 0 &&
+           config->stream_window % blocksize == 0 && config->chunk_size % blocksize == 0 &&
+           (off_t)blocksize <= config->disk_size;
+}
+
+/*
+ * One pass over the scratch region with the settings of config, cut
+ * short after AUTOTUNE_PROBE_NS. The rate is what the workers moved over
+ * the time the slowest of them took, or 0 if any block failed.
+ */
+static autotune_check_t run_probe(const workers_config_t *config, uint64_t *rate)
+{
+    workers_config_t probe_config = *config;
+    off_t region = (config->disk_size < AUTOTUNE_REGION) ? config->disk_size : AUTOTUNE_REGION;
+    off_t chunk_size;
+    arena_t *arena;
+    workers_t *workers = NULL;
+    worker_stats_t *stats;
+    badmap_t badmap;
+    struct timespec nap = {0, AUTOTUNE_POLL_NS};
+    uint64_t start_ns;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+    uint64_t busy_ns = 0;
+    autotune_check_t result = AUTOTUNE_CHECK_OK;
+
+    *rate = 0;
+
+    chunk_size = region / config->num_workers / AUTOTUNE_CHUNKS_PER_WORKER;
+    chunk_size -= chunk_size % config->blocksize;
+
+    probe_config.disk_size = region - region % config->blocksize;
+    probe_config.chunk_size = (chunk_size > 0) ? chunk_size : config->blocksize;
+    probe_config.undo = NULL;
+    probe_config.badmap = &badmap;
+    probe_config.zone_size = 0;
+    probe_config.probe = true;
+
+    if (badmap_init(&badmap) != BADMAP_CHECK_OK)
+        return AUTOTUNE_CHECK_ERR_MEM_ALLOC;
+
+    if (arena_init(&arena, workers_buffer_size(config->num_workers, config->queue_depth,
+                                               config->blocksize, 0)) != ARENA_CHECK_OK) {
+        badmap_destroy(&badmap);
+        return AUTOTUNE_CHECK_ERR_MEM_ALLOC;
+    }
+
+    probe_config.arena = arena;
+
+    switch (init_workers(&workers, &probe_config)) {
+        case WORKERS_CHECK_OK:
+            break;
+
+        case WORKERS_CHECK_ERR_MEM_ALLOC:
+            result = AUTOTUNE_CHECK_ERR_MEM_ALLOC;
+            goto out;
+
+        default:
+            result = AUTOTUNE_CHECK_ERR_PTHREAD;
+            goto out;
+    }
+
+    if (start_workers(workers, 1, NULL) != WORKERS_CHECK_OK) {
+        result = AUTOTUNE_CHECK_ERR_PTHREAD;
+        goto out;
+    }
+
+    start_ns = stats_now_ns();
+
+    while (are_workers_running(workers)) {
+        if (stats_now_ns() - start_ns >= AUTOTUNE_PROBE_NS)
+            halt_workers(workers);
+
+        nanosleep(&nap, NULL);
+    }
+
+    if (have_workers_failed(workers)) {
+        result = AUTOTUNE_CHECK_ERR_DEVICE;
+        goto out;
+    }
+
+    /* An interrupted probe measured nothing, and the run is over. */
+    if (are_workers_stopped()) {
+        result = AUTOTUNE_CHECK_ERR_STOPPED;
+        goto out;
+    }
+
+    stats = get_workers_stats(workers);
+
+    for (unsigned int i = 0; i < config->num_workers; i++) {
+        bytes += stats_get(&stats[i].written_bytes) + stats_get(&stats[i].verified_bytes);
+        errors += stats_get(&stats[i].mismatched_blocks) + stats_get(&stats[i].read_errors) +
+                  stats_get(&stats[i].write_errors);
+
+        if (stats_get(&stats[i].busy_ns) > busy_ns)
+            busy_ns = stats_get(&stats[i].busy_ns);
+    }
+
+    if (errors == 0 && busy_ns > 0)
+        *rate = (uint64_t)((double)bytes * 1e9 / busy_ns);
+
+out:
+    cleanup_workers(workers);
+    arena_destroy(arena);
+    badmap_destroy(&badmap);
+
+    return result;
+}
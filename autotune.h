@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "workers.h"
+
+/*
+ * Finds the block size, the workers per device and the queue depth at
+ * which a disk runs fastest. The queue limits of the block layer narrow
+ * the candidates down, and a short probe of every candidate on a scratch
+ * region at the start of the disk measures the write+verify throughput
+ * it really gets. A probe stops after AUTOTUNE_PROBE_NS, so slow disks
+ * don't take long to tune; a probe that hits any error doesn't count.
+ */
+
+#define AUTOTUNE_REGION (1024 * 1024 * 1024)
+#define AUTOTUNE_PROBE_NS (2 * 1000000000ULL)
+
+/* Settings given on the command line, which are kept as they are. */
+#define AUTOTUNE_FIXED_BLOCKSIZE 0x1
+#define AUTOTUNE_FIXED_WORKERS 0x2
+#define AUTOTUNE_FIXED_QUEUE_DEPTH 0x4
+
+/* Queue limits of the device, 0 where sysfs doesn't tell. */
+typedef struct autotune_hints_t {
+    bool rotational;
+    unsigned int nr_requests;
+    unsigned int max_io_size;       /* Largest request the hardware takes, in bytes. */
+    unsigned int optimal_io_size;   /* Preferred request size, e.g. the stripe of a RAID. */
+} autotune_hints_t;
+
+typedef enum {
+    AUTOTUNE_CHECK_OK = 0,
+    AUTOTUNE_CHECK_ERR_UNSUPPORTED,
+    AUTOTUNE_CHECK_ERR_STAT,
+    AUTOTUNE_CHECK_ERR_MEM_ALLOC,
+    AUTOTUNE_CHECK_ERR_PTHREAD,
+    AUTOTUNE_CHECK_ERR_DEVICE,
+    AUTOTUNE_CHECK_ERR_STOPPED,
+    AUTOTUNE_CHECK_ERR_NO_CANDIDATE
+} autotune_check_t;
+
+autotune_check_t autotune_hints(const char*, autotune_hints_t*);
+autotune_check_t autotune_run(workers_config_t*, const autotune_hints_t*, unsigned int, size_t,
+                              uint64_t*);
+
+#endif
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "badmap.h"
+#include "utils.h"
+
+#define BADMAP_INITIAL_CAPACITY 16
+
+/*
+ * Internal functions' prototypes
+ */
+
+static size_t first_touching(const badmap_t*, uint64_t);
+static bool write_ranges(FILE*, badmap_t*, badmap_format_t, const char*, unsigned int);
+
+badmap_check_t badmap_init(badmap_t *badmap)
+{
+    memset(badmap, 0, sizeof(badmap_t));
+
+    if ((errno = pthread_mutex_init(&badmap->mutex, NULL)) != 0)
+        return BADMAP_CHECK_ERR_MEM_ALLOC;
+
+    return BADMAP_CHECK_OK;
+}
+
+/*
+ * Add the bad range [offset, offset + len), merging it with every range
+ * it overlaps or touches.
+ */
+badmap_check_t badmap_add(badmap_t *badmap, uint64_t offset, uint64_t len)
+{
+    badmap_range_t *ranges;
+    uint64_t end = offset + len;
+    size_t first;
+    size_t last;
+
+    if (len == 0)
+        return BADMAP_CHECK_OK;
+
+    pthread_mutex_lock(&badmap->mutex);
+
+    first = first_touching(badmap, offset);
+    last = first;
+
+    while (last < badmap->num_ranges && badmap->ranges[last].offset <= end) {
+        if (badmap->ranges[last].offset < offset)
+            offset = badmap->ranges[last].offset;
+        if (badmap->ranges[last].offset + badmap->ranges[last].len > end)
+            end = badmap->ranges[last].offset + badmap->ranges[last].len;
+
+        badmap->bad_bytes -= badmap->ranges[last].len;
+        last++;
+    }
+
+    /* A range that touches none of the others needs a new entry. */
+    if (first == last) {
+        if (badmap->num_ranges == badmap->capacity) {
+            badmap->capacity = (badmap->capacity == 0) ? BADMAP_INITIAL_CAPACITY
+                                                        : badmap->capacity * 2;
+
+            if ((ranges = realloc(badmap->ranges,
+                                  badmap->capacity * sizeof(badmap_range_t))) == NULL) {
+                badmap->capacity = badmap->num_ranges;
+                pthread_mutex_unlock(&badmap->mutex);
+                return BADMAP_CHECK_ERR_MEM_ALLOC;
+            }
+
+            badmap->ranges = ranges;
+        }
+
+        memmove(&badmap->ranges[first + 1], &badmap->ranges[first],
+                (badmap->num_ranges - first) * sizeof(badmap_range_t));
+        badmap->num_ranges++;
+        last = first + 1;
+    } else if (last - first > 1) {
+        memmove(&badmap->ranges[first + 1], &badmap->ranges[last],
+                (badmap->num_ranges - last) * sizeof(badmap_range_t));
+        badmap->num_ranges -= last - first - 1;
+    }
+
+    badmap->ranges[first].offset = offset;
+    badmap->ranges[first].len = end - offset;
+    badmap->bad_bytes += end - offset;
+
+    pthread_mutex_unlock(&badmap->mutex);
+
+    return BADMAP_CHECK_OK;
+}
+
+/* Total bytes of bad sectors and the number of ranges they form. */
+void badmap_get(badmap_t *badmap, uint64_t *bad_bytes, size_t *num_ranges)
+{
+    pthread_mutex_lock(&badmap->mutex);
+    *bad_bytes = badmap->bad_bytes;
+    *num_ranges = badmap->num_ranges;
+    pthread_mutex_unlock(&badmap->mutex);
+}
+
+badmap_check_t badmap_parse_format(const char *name, badmap_format_t *format)
+{
+    if (strcmp(name, "badblocks") == 0)
+        *format = BADMAP_FORMAT_BADBLOCKS;
+    else if (strcmp(name, "json") == 0)
+        *format = BADMAP_FORMAT_JSON;
+    else
+        return BADMAP_CHECK_ERR_UNKNOWN_FORMAT;
+
+    return BADMAP_CHECK_OK;
+}
+
+const char *badmap_suffix(badmap_format_t format)
+{
+    return (format == BADMAP_FORMAT_JSON) ? BADMAP_SUFFIX_JSON : BADMAP_SUFFIX_BADBLOCKS;
+}
+
+/*
+ * Write the map to path, replacing the previous export only once the new
+ * one is complete. In the badblocks format every bad sector is a line
+ * with its number, counted in sectors of sector_size bytes.
+ */
+badmap_check_t badmap_export(badmap_t *badmap, const char *path, badmap_format_t format,
+                             const char *device_name, unsigned int sector_size)
+{
+    FILE *file;
+    char *tmp_path;
+    bool written;
+
+    if ((tmp_path = malloc(strlen(path) + sizeof(".tmp"))) == NULL)
+        return BADMAP_CHECK_ERR_MEM_ALLOC;
+
+    sprintf(tmp_path, "%s.tmp", path);
+
+    if ((file = fopen(tmp_path, "w")) == NULL) {
+        free(tmp_path);
+        return BADMAP_CHECK_ERR_IO;
+    }
+
+    pthread_mutex_lock(&badmap->mutex);
+    written = write_ranges(file, badmap, format, device_name, sector_size);
+    pthread_mutex_unlock(&badmap->mutex);
+
+    written = (fclose(file) == 0) && written;
+
+    if (!written || rename(tmp_path, path) == -1) {
+        unlink(tmp_path);
+        free(tmp_path);
+        return BADMAP_CHECK_ERR_IO;
+    }
+
+    free(tmp_path);
+
+    return BADMAP_CHECK_OK;
+}
+
+void badmap_destroy(badmap_t *badmap)
+{
+    pthread_mutex_destroy(&badmap->mutex);
+    free(badmap->ranges);
+    badmap->ranges = NULL;
+    badmap->num_ranges = 0;
+    badmap->capacity = 0;
+}
+
+/* Index of the first range that ends at or after offset: the first one it can merge with. */
+static size_t first_touching(const badmap_t *badmap, uint64_t offset)
+{
+    size_t low = 0;
+    size_t high = badmap->num_ranges;
+    size_t middle;
+
+    while (low < high) {
+        middle = low + (high - low) / 2;
+
+        if (badmap->ranges[middle].offset + badmap->ranges[middle].len < offset)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+static bool write_ranges(FILE *file, badmap_t *badmap, badmap_format_t format,
+                         const char *device_name, unsigned int sector_size)
+{
+    badmap_range_t *range;
+
+    if (format == BADMAP_FORMAT_BADBLOCKS) {
+        for (size_t i = 0; i < badmap->num_ranges; i++) {
+            range = &badmap->ranges[i];
+
+            for (uint64_t sector = range->offset / sector_size;
+                 sector < (range->offset + range->len) / sector_size; sector++)
+                fprintf(file, "%" PRIu64 "\n", sector);
+        }
+
+        return !ferror(file);
+    }
+
+    fprintf(file, "{\n  \"device\": ");
+    write_json_string(file, device_name);
+    fprintf(file, ",\n  \"sector_size\": %u,\n"
+                  "  \"bad_sectors\": %" PRIu64 ",\n  \"bad_bytes\": %" PRIu64 ",\n"
+                  "  \"ranges\": [",
+                  sector_size, badmap->bad_bytes / sector_size, badmap->bad_bytes);
+
+    for (size_t i = 0; i < badmap->num_ranges; i++) {
+        range = &badmap->ranges[i];
+        fprintf(file, "%s\n    {\"offset\": %" PRIu64 ", \"length\": %" PRIu64 ", "
+                      "\"first_sector\": %" PRIu64 ", \"sectors\": %" PRIu64 "}",
+                      (i > 0) ? "," : "", range->offset, range->len, range->offset / sector_size,
+                      range->len / sector_size);
+    }
+
+    fprintf(file, "%s]\n}\n", (badmap->num_ranges > 0) ? "\n  " : "");
+
+    return !ferror(file);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef BADMAP_H
+#define BADMAP_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Map of the bad sectors of one device. I/O that fails even after its
+ * retries is bisected down to single sectors, and the sectors that still
+ * fail end up here. Neighbouring bad sectors are merged into ranges kept
+ * sorted by offset, so a damaged area of thousands of sectors stays one
+ * entry. The workers of a device share the map, and it is kept over all
+ * passes, so a sector that fails in any pass is in it once.
+ *
+ * At the end of every pass the map is exported, either as a list of bad
+ * sector numbers as printed by badblocks(8) or as JSON with the byte
+ * ranges, so drives can be graded by how much of them is bad.
+ */
+
+#define BADMAP_SUFFIX_BADBLOCKS ".badblocks"
+#define BADMAP_SUFFIX_JSON ".badblocks.json"
+
+typedef struct badmap_range_t {
+    uint64_t offset;
+    uint64_t len;
+} badmap_range_t;
+
+typedef struct badmap_t {
+    pthread_mutex_t mutex;
+    badmap_range_t *ranges;
+    size_t num_ranges;
+    size_t capacity;
+    uint64_t bad_bytes;
+} badmap_t;
+
+typedef enum {
+    BADMAP_FORMAT_BADBLOCKS = 0,
+    BADMAP_FORMAT_JSON
+} badmap_format_t;
+
+typedef enum {
+    BADMAP_CHECK_OK = 0,
+    BADMAP_CHECK_ERR_MEM_ALLOC,
+    BADMAP_CHECK_ERR_UNKNOWN_FORMAT,
+    BADMAP_CHECK_ERR_IO
+} badmap_check_t;
+
+badmap_check_t badmap_init(badmap_t*);
+badmap_check_t badmap_add(badmap_t*, uint64_t, uint64_t);
+void badmap_get(badmap_t*, uint64_t*, size_t*);
+badmap_check_t badmap_parse_format(const char*, badmap_format_t*);
+const char *badmap_suffix(badmap_format_t);
+badmap_check_t badmap_export(badmap_t*, const char*, badmap_format_t, const char*, unsigned int);
+void badmap_destroy(badmap_t*);
+
+#endif
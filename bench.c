@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*
+ * Benchmarks of the hot paths, built with -O2 and run by `make bench`:
+ * the data patterns, the verify and CRC kernels, the per-block progress
+ * accounting, and whole passes of the workers on null: and mem: disks,
+ * plus a regular file when one is given. Each result is one JSON object
+ * per line on stdout, so the output of two commits can be compared line
+ * by line. GB are 10^9 bytes; an op is a block, or one accounted block.
+ *
+ * Usage: diskroaster-bench [FILE]
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "badmap.h"
+#include "crc32c.h"
+#include "disk.h"
+#include "ioengine.h"
+#include "pattern.h"
+#include "stats.h"
+#include "verify.h"
+#include "workers.h"
+#include "zones.h"
+
+#define BENCH_NS (500 * 1000000ULL)            /* Time of every kernel benchmark. */
+#define BENCH_PASS_NS (2 * 1000000000ULL)      /* Time a pass of the workers is cut short at. */
+#define BENCH_POLL_NS (10 * 1000000L)
+#define BENCH_BLOCK_SIZE (1024 * 1024)
+#define BENCH_SECTOR_SIZE 512
+#define BENCH_RUN_ID 0x5eed1e55
+#define BENCH_NUM_WORKERS 4
+#define BENCH_URING_QUEUE_DEPTH 32
+#define BENCH_NULL_DISK "null:64g"
+#define BENCH_MEM_DISK "mem:1g"
+
+/* What a kernel benchmark works on. */
+typedef struct bench_ctx_t {
+    pattern_t pattern;
+    char *buffer;
+    size_t len;
+    off_t offset;
+    worker_stats_t *stats;
+    zones_t zones;
+    uint32_t crc;
+} bench_ctx_t;
+
+typedef void (*bench_fn_t)(bench_ctx_t*, uint64_t);
+
+/*
+ * Internal functions' prototypes
+ */
+
+static void run_kernel(const char*, bench_fn_t, bench_ctx_t*, size_t);
+static void run_pass(const char*, ioengine_type_t, unsigned int);
+static void print_result(const char*, uint64_t, uint64_t, uint64_t);
+static void bench_pattern_fill(bench_ctx_t*, uint64_t);
+static void bench_pattern_stamp(bench_ctx_t*, uint64_t);
+static void bench_pattern_check(bench_ctx_t*, uint64_t);
+static void bench_verify_fill(bench_ctx_t*, uint64_t);
+static void bench_verify_compare(bench_ctx_t*, uint64_t);
+static void bench_crc32c(bench_ctx_t*, uint64_t);
+static void bench_accounting(bench_ctx_t*, uint64_t);
+
+int main(int argc, char **argv)
+{
+    bench_ctx_t ctx;
+    bool have_uring = ioengine_probe(IOENGINE_IO_URING) == IOENGINE_CHECK_OK;
+    const unsigned int blocksizes[] = {4096, BENCH_BLOCK_SIZE};
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.len = BENCH_BLOCK_SIZE;
+    ctx.pattern.data = PATTERN_DATA_RANDOM;
+    ctx.pattern.blocksize = BENCH_BLOCK_SIZE;
+    ctx.pattern.sector_size = BENCH_SECTOR_SIZE;
+    ctx.pattern.tagged = true;
+    ctx.pattern.run_id = BENCH_RUN_ID;
+    ctx.pattern.pass = 1;
+
+    if (posix_memalign((void**)&ctx.buffer, ARENA_BUFFER_ALIGN, BENCH_BLOCK_SIZE) != 0 ||
+        posix_memalign((void**)&ctx.stats, STATS_CACHE_LINE, sizeof(worker_stats_t)) != 0 ||
+        zones_init(&ctx.zones, (off_t)1 << 40, 0) != ZONES_CHECK_OK) {
+        fprintf(stderr, "%s\n", "No free memory to allocate.");
+        exit(EXIT_FAILURE);
+    }
+
+    memset(ctx.stats, 0, sizeof(worker_stats_t));
+
+    printf("{\"bench\":\"info\",\"verify_kernel\":\"%s\",\"crc32c\":\"%s\",\"cpus\":%ld,"
+           "\"io_uring\":%s}\n", verify_impl_name(), crc32c_impl_name(),
+           sysconf(_SC_NPROCESSORS_ONLN), have_uring ? "true" : "false");
+    fflush(stdout);
+
+    run_kernel("pattern_fill", bench_pattern_fill, &ctx, BENCH_BLOCK_SIZE);
+    run_kernel("pattern_stamp", bench_pattern_stamp, &ctx, BENCH_BLOCK_SIZE);
+    run_kernel("pattern_check", bench_pattern_check, &ctx, BENCH_BLOCK_SIZE);
+
+    /* The fixed-byte patterns of --patterns should cost no more per byte. */
+    pattern_set_fill(&ctx.pattern, 0xaa);
+    run_kernel("pattern_fill_byte", bench_pattern_fill, &ctx, BENCH_BLOCK_SIZE);
+    run_kernel("pattern_check_byte", bench_pattern_check, &ctx, BENCH_BLOCK_SIZE);
+    pattern_set_fill(&ctx.pattern, PATTERN_FILL_RANDOM);
+
+    run_kernel("verify_fill", bench_verify_fill, &ctx, BENCH_BLOCK_SIZE);
+    run_kernel("verify_compare", bench_verify_compare, &ctx, BENCH_BLOCK_SIZE);
+    run_kernel("crc32c", bench_crc32c, &ctx, BENCH_BLOCK_SIZE);
+    run_kernel("accounting", bench_accounting, &ctx, 0);
+
+    for (unsigned int i = 0; i < sizeof(blocksizes) / sizeof(blocksizes[0]); i++) {
+        run_pass(BENCH_NULL_DISK, IOENGINE_PSYNC, blocksizes[i]);
+        run_pass(BENCH_MEM_DISK, IOENGINE_PSYNC, blocksizes[i]);
+
+        if (have_uring)
+            run_pass(BENCH_MEM_DISK, IOENGINE_IO_URING, blocksizes[i]);
+
+        if (argc > 1) {
+            run_pass(argv[1], IOENGINE_PSYNC, blocksizes[i]);
+
+            if (have_uring)
+                run_pass(argv[1], IOENGINE_IO_URING, blocksizes[i]);
+        }
+    }
+
+    zones_destroy(&ctx.zones);
+    free(ctx.stats);
+    free(ctx.buffer);
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Run a kernel in ever larger batches until BENCH_NS have passed, so the
+ * clock is read rarely even for kernels that take nanoseconds. bytes is
+ * what one op moves, 0 for kernels that are only about ops.
+ */
+static void run_kernel(const char *name, bench_fn_t fn, bench_ctx_t *ctx, size_t bytes)
+{
+    uint64_t batch = 1;
+    uint64_t ops = 0;
+    uint64_t elapsed_ns = 0;
+    uint64_t start_ns;
+    char label[128];
+
+    pattern_fill_block(&ctx->pattern, ctx->buffer, ctx->len, 0);
+    ctx->offset = 0;
+
+    while (elapsed_ns < BENCH_NS) {
+        start_ns = stats_now_ns();
+        fn(ctx, batch);
+        elapsed_ns += stats_now_ns() - start_ns;
+        ops += batch;
+        batch *= 2;
+    }
+
+    snprintf(label, sizeof(label), "\"bench\":\"%s\",\"block_size\":%zu", name,
+             bytes ? ctx->len : 0);
+    print_result(label, ops * bytes, ops, elapsed_ns);
+}
+
+/*
+ * A pass of BENCH_NUM_WORKERS workers over a disk, cut short after
+ * BENCH_PASS_NS, through the same code path as a real test. Its rate is
+ * over the time the slowest worker took.
+ */
+static void run_pass(const char *device_name, ioengine_type_t engine, unsigned int blocksize)
+{
+    workers_config_t config;
+    workers_t *workers = NULL;
+    worker_stats_t *stats;
+    arena_t *arena;
+    badmap_t badmap;
+    struct timespec nap = {0, BENCH_POLL_NS};
+    uint64_t start_ns;
+    uint64_t bytes = 0;
+    uint64_t ops = 0;
+    uint64_t busy_ns = 0;
+    uint64_t errors = 0;
+    char label[256];
+
+    memset(&config, 0, sizeof(config));
+    config.device_name = device_name;
+    config.num_workers = BENCH_NUM_WORKERS;
+    config.blocksize = blocksize;
+    config.engine = engine;
+    config.queue_depth = (engine == IOENGINE_IO_URING) ? BENCH_URING_QUEUE_DEPTH : 1;
+    config.tag_sectors = true;
+    config.retries = 1;
+    config.probe = true;
+    config.run_id = BENCH_RUN_ID;
+
+    if (get_disk_sector_size(device_name, &config.sector_size) != DISKDEV_CHECK_OK ||
+        get_disk_size(device_name, &config.disk_size) != DISKDEV_CHECK_OK) {
+        fprintf(stderr, "Can't open device: %s\n", device_name);
+        exit(EXIT_FAILURE);
+    }
+
+    if (badmap_init(&badmap) != BADMAP_CHECK_OK ||
+        arena_init(&arena, workers_buffer_size(config.num_workers, config.queue_depth,
+                                               blocksize, 0)) != ARENA_CHECK_OK) {
+        fprintf(stderr, "%s\n", "No free memory to allocate.");
+        exit(EXIT_FAILURE);
+    }
+
+    config.arena = arena;
+    config.badmap = &badmap;
+
+    if (init_workers(&workers, &config) != WORKERS_CHECK_OK ||
+        start_workers(workers, 1, NULL) != WORKERS_CHECK_OK) {
+        fprintf(stderr, "Error starting workers for %s\n", device_name);
+        exit(EXIT_FAILURE);
+    }
+
+    start_ns = stats_now_ns();
+
+    while (are_workers_running(workers)) {
+        if (stats_now_ns() - start_ns >= BENCH_PASS_NS)
+            halt_workers(workers);
+
+        nanosleep(&nap, NULL);
+    }
+
+    stats = get_workers_stats(workers);
+
+    for (unsigned int i = 0; i < config.num_workers; i++) {
+        bytes += stats_get(&stats[i].written_bytes) + stats_get(&stats[i].verified_bytes);
+        ops += stats_get(&stats[i].write_latency.count) + stats_get(&stats[i].read_latency.count);
+        errors += stats_get(&stats[i].mismatched_blocks) + stats_get(&stats[i].read_errors) +
+                  stats_get(&stats[i].write_errors);
+
+        if (stats_get(&stats[i].busy_ns) > busy_ns)
+            busy_ns = stats_get(&stats[i].busy_ns);
+    }
+
+    snprintf(label, sizeof(label), "\"bench\":\"pass\",\"disk\":\"%s\",\"engine\":\"%s\","
+             "\"block_size\":%u,\"workers\":%u,\"queue_depth\":%u,\"errors\":%llu,"
+             "\"failed\":%s", device_name, ioengine_name(engine), blocksize, config.num_workers,
+             config.queue_depth, (unsigned long long)errors,
+             have_workers_failed(workers) ? "true" : "false");
+    print_result(label, bytes, ops, busy_ns);
+
+    cleanup_workers(workers);
+    arena_destroy(arena);
+    badmap_destroy(&badmap);
+}
+
+static void print_result(const char *label, uint64_t bytes, uint64_t ops, uint64_t elapsed_ns)
+{
+    double secs = (elapsed_ns > 0) ? elapsed_ns / 1e9 : 1e-9;
+
+    printf("{%s,\"seconds\":%.3f,\"bytes\":%llu,\"ops\":%llu,\"gb_per_s\":%.3f,"
+           "\"ops_per_s\":%.1f}\n", label, secs, (unsigned long long)bytes,
+           (unsigned long long)ops, bytes / secs / 1e9, ops / secs);
+    fflush(stdout);
+}
+
+/* Every op fills a fresh block, as a worker does for its first write. */
+static void bench_pattern_fill(bench_ctx_t *ctx, uint64_t ops)
+{
+    for (uint64_t i = 0; i < ops; i++) {
+        pattern_fill_block(&ctx->pattern, ctx->buffer, ctx->len, ctx->offset);
+        ctx->offset += ctx->len;
+    }
+}
+
+/* Every op restamps a block for the next offset, as every later write does. */
+static void bench_pattern_stamp(bench_ctx_t *ctx, uint64_t ops)
+{
+    for (uint64_t i = 0; i < ops; i++) {
+        ctx->offset += ctx->len;
+        pattern_stamp_block(&ctx->pattern, ctx->buffer, ctx->len, ctx->offset);
+    }
+}
+
+/* Every op checks a good block: tags, header, CRC and data. */
+static void bench_pattern_check(bench_ctx_t *ctx, uint64_t ops)
+{
+    block_check_t check;
+
+    for (uint64_t i = 0; i < ops; i++) {
+        if (!pattern_check_block(&ctx->pattern, ctx->buffer, ctx->len, 0, &check)) {
+            fprintf(stderr, "%s\n", "The benchmark block doesn't verify.");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static void bench_verify_fill(bench_ctx_t *ctx, uint64_t ops)
+{
+    verify_stream_t stream;
+
+    for (uint64_t i = 0; i < ops; i++) {
+        verify_stream_init(&stream, ctx->pattern.run_id);
+        verify_stream_fill(&stream, ctx->buffer, ctx->len);
+    }
+}
+
+static void bench_verify_compare(bench_ctx_t *ctx, uint64_t ops)
+{
+    verify_stream_t stream;
+
+    verify_stream_init(&stream, ctx->pattern.run_id);
+    verify_stream_fill(&stream, ctx->buffer, ctx->len);
+
+    for (uint64_t i = 0; i < ops; i++) {
+        verify_stream_init(&stream, ctx->pattern.run_id);
+
+        if (!verify_stream_compare(&stream, ctx->buffer, ctx->len)) {
+            fprintf(stderr, "%s\n", "The benchmark block doesn't compare.");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static void bench_crc32c(bench_ctx_t *ctx, uint64_t ops)
+{
+    for (uint64_t i = 0; i < ops; i++)
+        ctx->crc = crc32c(ctx->crc, ctx->buffer, ctx->len);
+}
+
+/* What a worker records for every completed block: latency, zone and progress. */
+static void bench_accounting(bench_ctx_t *ctx, uint64_t ops)
+{
+    uint64_t now_ns;
+
+    for (uint64_t i = 0; i < ops; i++) {
+        now_ns = stats_now_ns();
+        hist_record(&ctx->stats->write_latency, now_ns & 0xfffff);
+        zones_record(&ctx->zones, IO_OP_WRITE, ctx->offset, ctx->len, 1000, now_ns & 0xfffff);
+        stats_add(&ctx->stats->written_bytes, ctx->len);
+        ctx->offset = (ctx->offset + ctx->len) & (((off_t)1 << 40) - 1);
+    }
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #include <nmmintrin.h>
+    #define HAVE_CRC32C_SSE42 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    #include <arm_acle.h>
+    #define HAVE_CRC32C_ARMV8 1
+#endif
+
+#include "crc32c.h"
+
+#define CRC32C_POLY 0x82f63b78U     /* Reflected Castagnoli polynomial. */
+
+typedef uint32_t (*crc32c_fn_t)(uint32_t, const unsigned char*, size_t);
+
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+static crc32c_fn_t crc32c_fn;
+static const char *crc32c_name;
+static uint32_t crc32c_table[8][256];
+
+/*
+ * Internal functions' prototypes
+ */
+
+static void crc32c_init(void);
+static uint32_t crc32c_sw(uint32_t, const unsigned char*, size_t);
+
+uint32_t crc32c(uint32_t crc, const void *buffer, size_t len)
+{
+    pthread_once(&crc32c_once, crc32c_init);
+
+    return ~crc32c_fn(~crc, buffer, len);
+}
+
+const char *crc32c_impl_name(void)
+{
+    pthread_once(&crc32c_once, crc32c_init);
+
+    return crc32c_name;
+}
+
+#if defined(HAVE_CRC32C_SSE42)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char *buffer, size_t len)
+{
+    uint64_t crc64 = crc;
+    uint64_t word;
+
+    for (; len > 0 && ((uintptr_t)buffer & 7) != 0; len--)
+        crc64 = _mm_crc32_u8((uint32_t)crc64, *buffer++);
+
+    for (; len >= 8; len -= 8, buffer += 8) {
+        memcpy(&word, buffer, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+
+    for (; len > 0; len--)
+        crc64 = _mm_crc32_u8((uint32_t)crc64, *buffer++);
+
+    return (uint32_t)crc64;
+}
+#endif
+
+#if defined(HAVE_CRC32C_ARMV8)
+static uint32_t crc32c_armv8(uint32_t crc, const unsigned char *buffer, size_t len)
+{
+    uint64_t word;
+
+    for (; len > 0 && ((uintptr_t)buffer & 7) != 0; len--)
+        crc = __crc32cb(crc, *buffer++);
+
+    for (; len >= 8; len -= 8, buffer += 8) {
+        memcpy(&word, buffer, sizeof(word));
+        crc = __crc32cd(crc, word);
+    }
+
+    for (; len > 0; len--)
+        crc = __crc32cb(crc, *buffer++);
+
+    return crc;
+}
+#endif
+
+static void crc32c_init(void)
+{
+    uint32_t crc;
+
+    for (unsigned int n = 0; n < 256; n++) {
+        crc = n;
+
+        for (int k = 0; k < 8; k++)
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+
+        crc32c_table[0][n] = crc;
+    }
+
+    /* Extra tables for processing eight bytes per step. */
+    for (unsigned int n = 0; n < 256; n++) {
+        crc = crc32c_table[0][n];
+
+        for (int k = 1; k < 8; k++) {
+            crc = crc32c_table[0][crc & 0xff] ^ (crc >> 8);
+            crc32c_table[k][n] = crc;
+        }
+    }
+
+    crc32c_fn = crc32c_sw;
+    crc32c_name = "software";
+
+#if defined(HAVE_CRC32C_SSE42)
+    if (__builtin_cpu_supports("sse4.2")) {
+        crc32c_fn = crc32c_sse42;
+        crc32c_name = "sse4.2";
+    }
+#elif defined(HAVE_CRC32C_ARMV8)
+    crc32c_fn = crc32c_armv8;
+    crc32c_name = "armv8-crc";
+#endif
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char *buffer, size_t len)
+{
+    uint64_t word;
+
+    for (; len > 0 && ((uintptr_t)buffer & 7) != 0; len--)
+        crc = crc32c_table[0][(crc ^ *buffer++) & 0xff] ^ (crc >> 8);
+
+    /* Slicing-by-8, little-endian words only. */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; len >= 8; len -= 8, buffer += 8) {
+        memcpy(&word, buffer, sizeof(word));
+        word ^= crc;
+        crc = crc32c_table[7][word & 0xff] ^
+              crc32c_table[6][(word >> 8) & 0xff] ^
+              crc32c_table[5][(word >> 16) & 0xff] ^
+              crc32c_table[4][(word >> 24) & 0xff] ^
+              crc32c_table[3][(word >> 32) & 0xff] ^
+              crc32c_table[2][(word >> 40) & 0xff] ^
+              crc32c_table[1][(word >> 48) & 0xff] ^
+              crc32c_table[0][word >> 56];
+    }
+#else
+    (void)word;
+#endif
+
+    for (; len > 0; len--)
+        crc = crc32c_table[0][(crc ^ *buffer++) & 0xff] ^ (crc >> 8);
+
+    return crc;
+}
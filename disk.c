@@ -28,8 +28,18 @@
  * OF SUCH DAMAGE.
  */
 
+/* Linux open() syscall's O_DIRECT flag requires to define _GNU_SOURCE. */
+#if defined(__linux__)
+    #define _GNU_SOURCE
+#endif
 
+#include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -41,14 +51,39 @@
 #endif
 
 #include "disk.h"
+#include "utils.h"
+
+/* A memory disk and the shared memory behind it, which lives as long as the process. */
+typedef struct mem_disk_t {
+    char *name;
+    int fd;
+} mem_disk_t;
+
+static mem_disk_t *mem_disks = NULL;
+static unsigned int num_mem_disks = 0;
+static pthread_mutex_t mutex_mem_disks = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Internal functions' prototypes
+ */
+
+static bool virtual_disk_size(const char*, off_t*);
+static diskdev_check_t open_mem_disk(const char*, int*);
 
 diskdev_check_t disk_device_check(const char *device_name)
 {
     struct stat st;
+    off_t size;
+
+    if (is_virtual_disk(device_name))
+        return virtual_disk_size(device_name, &size) ? DISKDEV_CHECK_OK : DISKDEV_CHECK_ERR_SIZE;
 
     if (stat(device_name, &st) == -1)
         return DISKDEV_CHECK_ERR_STAT;
 
+    if ((st.st_mode & S_IFMT) == S_IFREG)
+        return DISKDEV_CHECK_OK;
+
     /* FreeBSD uses character device nodes for disk devices. */
 #if defined(__FreeBSD__)
     if ((st.st_mode & S_IFMT) != S_IFCHR)
@@ -61,11 +96,138 @@ diskdev_check_t disk_device_check(const char *device_name)
     return DISKDEV_CHECK_OK;
 }
 
+disk_type_t get_disk_type(const char *device_name)
+{
+    struct stat st;
+
+    if (strncmp(device_name, DISK_MEM_PREFIX, strlen(DISK_MEM_PREFIX)) == 0)
+        return DISK_TYPE_MEM;
+
+    if (strncmp(device_name, DISK_NULL_PREFIX, strlen(DISK_NULL_PREFIX)) == 0)
+        return DISK_TYPE_NULL;
+
+    if (stat(device_name, &st) == 0 && (st.st_mode & S_IFMT) == S_IFREG)
+        return DISK_TYPE_FILE;
+
+    return DISK_TYPE_DEVICE;
+}
+
+/* mem: and null: disks, whose data doesn't outlive the process. */
+bool is_virtual_disk(const char *device_name)
+{
+    return get_disk_type(device_name) == DISK_TYPE_MEM ||
+           get_disk_type(device_name) == DISK_TYPE_NULL;
+}
+
+/*
+ * Open a disk bypassing the page cache where it can be. A null disk has
+ * no file descriptor: fd is set to -1 and its I/O goes to the null engine.
+ */
+diskdev_check_t open_disk(const char *device_name, int flags, int *fd)
+{
+    switch (get_disk_type(device_name)) {
+        case DISK_TYPE_NULL:
+            *fd = -1;
+            return DISKDEV_CHECK_OK;
+
+        case DISK_TYPE_MEM:
+            return open_mem_disk(device_name, fd);
+
+        case DISK_TYPE_FILE:
+            /* Some file systems, tmpfs before Linux 6.6 among them, have no direct I/O. */
+            if ((*fd = open(device_name, flags|O_DIRECT)) == -1 && errno == EINVAL)
+                *fd = open(device_name, flags);
+            break;
+
+        default:
+            *fd = open(device_name, flags|O_DIRECT);
+            break;
+    }
+
+    return (*fd == -1) ? DISKDEV_CHECK_ERR_OPEN : DISKDEV_CHECK_OK;
+}
+
+/* The size after the prefix of a virtual disk, in whole sectors. */
+static bool virtual_disk_size(const char *device_name, off_t *size)
+{
+    const char *size_str = strchr(device_name, ':') + 1;
+
+    if (get_large_size_in_bytes(size_str, size) != UTILS_CHECK_OK)
+        return false;
+
+    *size -= *size % DISK_VIRTUAL_SECTOR_SIZE;
+
+    return *size > 0;
+}
+
+/* Every worker gets its own descriptor of the same shared memory, created on first use. */
+static diskdev_check_t open_mem_disk(const char *device_name, int *fd)
+{
+    mem_disk_t *disks;
+    off_t size;
+    int local_errno;
+
+    if (!virtual_disk_size(device_name, &size)) {
+        errno = EINVAL;
+        return DISKDEV_CHECK_ERR_OPEN;
+    }
+
+    pthread_mutex_lock(&mutex_mem_disks);
+
+    for (unsigned int i = 0; i < num_mem_disks; i++) {
+        if (strcmp(mem_disks[i].name, device_name) == 0) {
+            *fd = dup(mem_disks[i].fd);
+            pthread_mutex_unlock(&mutex_mem_disks);
+            return (*fd == -1) ? DISKDEV_CHECK_ERR_OPEN : DISKDEV_CHECK_OK;
+        }
+    }
+
+    if ((disks = realloc(mem_disks, (num_mem_disks + 1) * sizeof(mem_disk_t))) == NULL) {
+        pthread_mutex_unlock(&mutex_mem_disks);
+        return DISKDEV_CHECK_ERR_MEM_ALLOC;
+    }
+
+    mem_disks = disks;
+
+#if defined(__linux__)
+    *fd = memfd_create("diskroaster", MFD_CLOEXEC);
+#elif defined(__FreeBSD__)
+    *fd = shm_open(SHM_ANON, O_RDWR|O_CLOEXEC, 0600);
+#else
+    *fd = -1;
+    errno = ENOSYS;
+#endif
+
+    if (*fd == -1 || ftruncate(*fd, size) == -1 ||
+        (mem_disks[num_mem_disks].name = strdup(device_name)) == NULL) {
+        local_errno = errno;
+
+        if (*fd != -1)
+            close(*fd);
+
+        pthread_mutex_unlock(&mutex_mem_disks);
+        errno = local_errno;
+        return DISKDEV_CHECK_ERR_OPEN;
+    }
+
+    mem_disks[num_mem_disks++].fd = *fd;
+    *fd = dup(*fd);
+
+    pthread_mutex_unlock(&mutex_mem_disks);
+
+    return (*fd == -1) ? DISKDEV_CHECK_ERR_OPEN : DISKDEV_CHECK_OK;
+}
+
 diskdev_check_t get_disk_sector_size(const char* device_name, unsigned int *sector_size)
 {
     int fd;
     unsigned long ioctl_op;
 
+    if (get_disk_type(device_name) != DISK_TYPE_DEVICE) {
+        *sector_size = DISK_VIRTUAL_SECTOR_SIZE;
+        return DISKDEV_CHECK_OK;
+    }
+
     if ((fd = open(device_name, O_RDONLY)) == -1)
         return DISKDEV_CHECK_ERR_OPEN;
 
@@ -89,6 +251,10 @@ diskdev_check_t get_disk_size(const char* device_name, off_t *disk_size)
 {
     int fd;
 
+    if (is_virtual_disk(device_name))
+        return virtual_disk_size(device_name, disk_size) ? DISKDEV_CHECK_OK :
+                                                            DISKDEV_CHECK_ERR_SIZE;
+
     if ((fd = open(device_name, O_RDONLY)) == -1)
         return DISKDEV_CHECK_ERR_OPEN;
 
@@ -118,3 +284,118 @@ off_t get_disk_segment_size(off_t disk_size, int blocksize, int num_segments)
     return disk_segment_size;
 }
 
+diskdev_check_t read_disk_sector(const char *device_name, off_t offset, char *sector,
+                                 unsigned int sector_size)
+{
+    int fd;
+    int local_errno;
+    char *buffer = NULL;
+    ssize_t read_bytes;
+
+    /* Bypass the page cache, the sector has to come from the disk itself. */
+    if (open_disk(device_name, O_RDONLY, &fd) != DISKDEV_CHECK_OK)
+        return DISKDEV_CHECK_ERR_OPEN;
+
+    /* A null disk keeps nothing to read. */
+    if (fd == -1) {
+        errno = ENXIO;
+        return DISKDEV_CHECK_ERR_OPEN;
+    }
+
+    if (posix_memalign((void**)&buffer, sector_size, sector_size) != 0) {
+        close(fd);
+        return DISKDEV_CHECK_ERR_MEM_ALLOC;
+    }
+
+    read_bytes = pread(fd, buffer, sector_size, offset);
+    local_errno = errno;
+
+    close(fd);
+
+    if (read_bytes != (ssize_t)sector_size) {
+        free(buffer);
+        errno = (read_bytes == -1) ? local_errno : EIO;
+        return DISKDEV_CHECK_ERR_READ;
+    }
+
+    memcpy(sector, buffer, sector_size);
+    free(buffer);
+
+    return DISKDEV_CHECK_OK;
+}
+
+diskdev_check_t disk_parse_wipe(const char *name, disk_wipe_t *wipe)
+{
+    if (strcmp(name, "zero") == 0)
+        *wipe = DISK_WIPE_ZERO;
+    else if (strcmp(name, "discard") == 0)
+        *wipe = DISK_WIPE_DISCARD;
+    else if (strcmp(name, "secure-discard") == 0)
+        *wipe = DISK_WIPE_SECURE_DISCARD;
+    else
+        return DISKDEV_CHECK_ERR_UNKNOWN_MODE;
+
+    return DISKDEV_CHECK_OK;
+}
+
+const char *disk_wipe_name(disk_wipe_t wipe)
+{
+    switch (wipe) {
+        case DISK_WIPE_ZERO:
+            return "zero";
+
+        case DISK_WIPE_DISCARD:
+            return "discard";
+
+        case DISK_WIPE_SECURE_DISCARD:
+            return "secure-discard";
+
+        default:
+            return "none";
+    }
+}
+
+/*
+ * Wipe len bytes at offset, which are multiples of the sector size. The
+ * kernel splits the range into as many commands as the device takes, so
+ * a whole chunk goes down in one call.
+ */
+diskdev_check_t disk_wipe_range(int fd, disk_wipe_t wipe, off_t offset, off_t len)
+{
+    struct stat st;
+    int result = -1;
+
+    if (fstat(fd, &st) == -1)
+        return DISKDEV_CHECK_ERR_STAT;
+
+    errno = EOPNOTSUPP;
+
+#if defined(__linux__)
+    uint64_t range[2] = {(uint64_t)offset, (uint64_t)len};
+
+    if (S_ISREG(st.st_mode) && wipe == DISK_WIPE_ZERO)
+        result = fallocate(fd, FALLOC_FL_ZERO_RANGE|FALLOC_FL_KEEP_SIZE, offset, len);
+    else if (S_ISREG(st.st_mode) && wipe == DISK_WIPE_DISCARD)
+        result = fallocate(fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE, offset, len);
+    else if (S_ISBLK(st.st_mode) && wipe == DISK_WIPE_ZERO)
+        result = ioctl(fd, BLKZEROOUT, range);
+    else if (S_ISBLK(st.st_mode) && wipe == DISK_WIPE_DISCARD)
+        result = ioctl(fd, BLKDISCARD, range);
+    else if (S_ISBLK(st.st_mode) && wipe == DISK_WIPE_SECURE_DISCARD)
+        result = ioctl(fd, BLKSECDISCARD, range);
+#elif defined(__FreeBSD__)
+    /* BIO_DELETE is the only offload; it doesn't promise zeros. */
+    off_t range[2] = {offset, len};
+
+    if (S_ISCHR(st.st_mode) && wipe == DISK_WIPE_DISCARD)
+        result = ioctl(fd, DIOCGDELETE, range);
+#endif
+
+    if (result == 0)
+        return DISKDEV_CHECK_OK;
+
+    if (errno == EOPNOTSUPP || errno == ENOTTY || errno == ENODEV)
+        return DISKDEV_CHECK_ERR_UNSUPPORTED;
+
+    return DISKDEV_CHECK_ERR_IOCTL;
+}
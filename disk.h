@@ -31,19 +31,69 @@
 #ifndef DISK_H
 #define DISK_H
 
+#include <stdbool.h>
+#include <sys/types.h>
+
+/*
+ * Besides disk devices, regular files and two kinds of virtual disks can
+ * be tested, so the I/O path can be measured without hardware or root.
+ * "mem:SIZE" keeps its data in anonymous shared memory for as long as the
+ * process runs. "null:SIZE" discards what is written and reads back the
+ * data the verification expects, so only the CPU side of a test is left.
+ * Files and virtual disks have 4 KiB sectors, which O_DIRECT on any
+ * common file system accepts.
+ */
+
+#define DISK_MEM_PREFIX "mem:"
+#define DISK_NULL_PREFIX "null:"
+#define DISK_VIRTUAL_SECTOR_SIZE 4096
+
+typedef enum {
+    DISK_TYPE_DEVICE = 0,
+    DISK_TYPE_FILE,
+    DISK_TYPE_MEM,
+    DISK_TYPE_NULL
+} disk_type_t;
+
 typedef enum {
     DISKDEV_CHECK_OK = 0,
     DISKDEV_CHECK_ERR_STAT,
     DISKDEV_CHECK_ERR_OPEN,
     DISKDEV_CHECK_ERR_IOCTL,
     DISKDEV_CHECK_ERR_LSEEK,
-    DISKDEV_CHECK_ERR_NOT_DISK
+    DISKDEV_CHECK_ERR_NOT_DISK,
+    DISKDEV_CHECK_ERR_MEM_ALLOC,
+    DISKDEV_CHECK_ERR_READ,
+    DISKDEV_CHECK_ERR_SIZE,
+    DISKDEV_CHECK_ERR_UNSUPPORTED,
+    DISKDEV_CHECK_ERR_UNKNOWN_MODE
 } diskdev_check_t;
 
+/*
+ * Write-only ways to wipe a range that leave the work to the device: a
+ * zero-out (BLKZEROOUT, or zeroing a range of a regular file), a discard
+ * (BLKDISCARD or DIOCGDELETE, punching a hole in a file) and a secure
+ * discard (BLKSECDISCARD). What a disk can't offload is reported as
+ * DISKDEV_CHECK_ERR_UNSUPPORTED.
+ */
+typedef enum {
+    DISK_WIPE_NONE = 0,
+    DISK_WIPE_ZERO,
+    DISK_WIPE_DISCARD,
+    DISK_WIPE_SECURE_DISCARD
+} disk_wipe_t;
+
 diskdev_check_t disk_device_check(const char *);
+disk_type_t get_disk_type(const char*);
+bool is_virtual_disk(const char*);
+diskdev_check_t open_disk(const char*, int, int*);
 diskdev_check_t get_disk_sector_size(const char*, unsigned int*);
 diskdev_check_t get_disk_size(const char*, off_t*);
 off_t get_disk_segment_size(off_t, int, int);
+diskdev_check_t read_disk_sector(const char*, off_t, char*, unsigned int);
+diskdev_check_t disk_parse_wipe(const char*, disk_wipe_t*);
+const char *disk_wipe_name(disk_wipe_t);
+diskdev_check_t disk_wipe_range(int, disk_wipe_t, off_t, off_t);
 
 #endif
 
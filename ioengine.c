@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#if defined(__linux__)
+    #define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "ioengine.h"
+#include "stats.h"
+#include "uring.h"
+
+/*
+ * The pwritev2() and io_uring flag for a write that is durable once it
+ * completes. A C library too old to know it still runs on a kernel that
+ * does, so io_uring gets the value of the kernel ABI from <linux/fs.h>;
+ * psync writes flush by hand there. Only Linux has io_uring at all.
+ */
+#if defined(RWF_DSYNC)
+    #define RW_DSYNC RWF_DSYNC
+#elif defined(__linux__)
+    #define RW_DSYNC 0x00000002
+#else
+    #define RW_DSYNC 0
+#endif
+
+struct ioengine_t {
+    ioengine_type_t type;
+    int fd;
+    unsigned int depth;
+    unsigned int inflight;
+
+    /* Writes are durable on completion: FUA, or a write and a flush without it. */
+    bool dsync;
+
+    /* psync and null: requests complete at queue time and wait here to be reaped. */
+    io_completion_t *completed;
+    unsigned int num_completed;
+
+    /* null */
+    ioengine_source_t source;
+    void *source_arg;
+
+    /* io_uring */
+    uring_t *ring;
+    bool fixed_buffers;
+};
+
+/*
+ * Internal functions' prototypes
+ */
+
+static ssize_t write_dsync(int, const char*, size_t, off_t);
+
+ioengine_check_t ioengine_parse(const char *name, ioengine_type_t *type)
+{
+    if (strcmp(name, "psync") == 0) {
+        *type = IOENGINE_PSYNC;
+    } else if (strcmp(name, "io_uring") == 0) {
+        *type = IOENGINE_IO_URING;
+    } else {
+        return IOENGINE_CHECK_ERR_UNKNOWN;
+    }
+
+    return IOENGINE_CHECK_OK;
+}
+
+const char *ioengine_name(ioengine_type_t type)
+{
+    switch (type) {
+        case IOENGINE_IO_URING:
+            return "io_uring";
+
+        case IOENGINE_NULL:
+            return "null";
+
+        default:
+            return "psync";
+    }
+}
+
+ioengine_check_t ioengine_probe(ioengine_type_t type)
+{
+    uring_t *ring;
+    int ret;
+
+    if (type != IOENGINE_IO_URING)
+        return IOENGINE_CHECK_OK;
+
+#if !defined(HAVE_IO_URING)
+    return IOENGINE_CHECK_ERR_UNSUPPORTED;
+#endif
+
+    /* The kernel may be too old, or io_uring may be disabled by sysctl or seccomp. */
+    if ((ret = uring_init(&ring, 1)) < 0) {
+        errno = -ret;
+        return IOENGINE_CHECK_ERR_SETUP;
+    }
+
+    uring_destroy(ring);
+
+    return IOENGINE_CHECK_OK;
+}
+
+ioengine_check_t ioengine_init(
+    ioengine_t **engine_ptr,
+    ioengine_type_t type,
+    int fd,
+    unsigned int depth,
+    const struct iovec *buffers,
+    unsigned int num_buffers
+) {
+    ioengine_t *engine;
+    int ret;
+
+    if ((engine = calloc(1, sizeof(ioengine_t))) == NULL)
+        return IOENGINE_CHECK_ERR_MEM_ALLOC;
+
+    engine->type = type;
+    engine->fd = fd;
+    engine->depth = depth;
+
+    if (type != IOENGINE_IO_URING) {
+        engine->completed = malloc(depth * sizeof(io_completion_t));
+
+        if (engine->completed == NULL) {
+            free(engine);
+            return IOENGINE_CHECK_ERR_MEM_ALLOC;
+        }
+
+        *engine_ptr = engine;
+
+        return IOENGINE_CHECK_OK;
+    }
+
+    if ((ret = uring_init(&engine->ring, depth)) < 0) {
+        free(engine);
+        errno = -ret;
+        return (ret == -ENOSYS) ? IOENGINE_CHECK_ERR_UNSUPPORTED : IOENGINE_CHECK_ERR_SETUP;
+    }
+
+    /*
+     * Registered buffers and files save the kernel from pinning pages and
+     * taking file references on every request. Both are optimizations only,
+     * so a failure here (e.g. RLIMIT_MEMLOCK) falls back to plain requests.
+     */
+    if (buffers != NULL && num_buffers > 0)
+        engine->fixed_buffers = (uring_register_buffers(engine->ring, buffers, num_buffers) == 0);
+
+    uring_register_file(engine->ring, fd);
+
+    *engine_ptr = engine;
+
+    return IOENGINE_CHECK_OK;
+}
+
+ioengine_check_t ioengine_queue(
+    ioengine_t *engine,
+    io_op_t op,
+    int buf_index,
+    char *buffer,
+    size_t len,
+    off_t offset,
+    unsigned int tag
+) {
+    io_completion_t *completion;
+    ssize_t result;
+    int ret;
+
+    if (engine->inflight >= engine->depth)
+        return IOENGINE_CHECK_ERR_QUEUE_FULL;
+
+    if (engine->type == IOENGINE_PSYNC) {
+        result = (op == IO_OP_WRITE) ? ioengine_pwrite(engine, buffer, len, offset)
+                                     : pread(engine->fd, buffer, len, offset);
+
+        completion = &engine->completed[engine->num_completed++];
+        completion->tag = tag;
+        completion->result = (result == -1) ? -errno : result;
+        completion->end_ns = stats_now_ns();
+        engine->inflight++;
+
+        return IOENGINE_CHECK_OK;
+    }
+
+    if (engine->type == IOENGINE_NULL) {
+        if (op == IO_OP_READ && engine->source != NULL)
+            engine->source(engine->source_arg, buffer, len, offset);
+
+        completion = &engine->completed[engine->num_completed++];
+        completion->tag = tag;
+        completion->result = len;
+        completion->end_ns = stats_now_ns();
+        engine->inflight++;
+
+        return IOENGINE_CHECK_OK;
+    }
+
+    if (!engine->fixed_buffers)
+        buf_index = IOENGINE_NO_BUF_INDEX;
+
+    ret = uring_prep_rw(engine->ring, op == IO_OP_WRITE, engine->fd, buf_index, buffer, len,
+                        offset, (op == IO_OP_WRITE && engine->dsync) ? RW_DSYNC : 0, tag);
+
+    if (ret < 0) {
+        errno = -ret;
+        return IOENGINE_CHECK_ERR_QUEUE_FULL;
+    }
+
+    engine->inflight++;
+
+    return IOENGINE_CHECK_OK;
+}
+
+ioengine_check_t ioengine_submit(ioengine_t *engine, unsigned int wait_nr)
+{
+    int ret;
+
+    if (engine->type != IOENGINE_IO_URING)
+        return IOENGINE_CHECK_OK;
+
+    if (wait_nr > engine->inflight)
+        wait_nr = engine->inflight;
+
+    if ((ret = uring_submit(engine->ring, wait_nr)) < 0) {
+        errno = -ret;
+        return IOENGINE_CHECK_ERR_SUBMIT;
+    }
+
+    return IOENGINE_CHECK_OK;
+}
+
+unsigned int ioengine_reap(ioengine_t *engine, io_completion_t *completions, unsigned int max)
+{
+    unsigned int count = 0;
+    uring_cqe_t cqe;
+    uint64_t now;
+
+    if (engine->type != IOENGINE_IO_URING) {
+        count = (engine->num_completed < max) ? engine->num_completed : max;
+        memcpy(completions, engine->completed, count * sizeof(io_completion_t));
+        memmove(engine->completed, engine->completed + count,
+                (engine->num_completed - count) * sizeof(io_completion_t));
+        engine->num_completed -= count;
+        engine->inflight -= count;
+
+        return count;
+    }
+
+    now = stats_now_ns();
+
+    while (count < max && uring_peek_cqe(engine->ring, &cqe)) {
+        completions[count].tag = (unsigned int)cqe.user_data;
+        completions[count].result = cqe.res;
+        completions[count].end_ns = now;
+        count++;
+    }
+
+    engine->inflight -= count;
+
+    return count;
+}
+
+/* A synchronous write outside the queue, as durable as the queued ones. */
+ssize_t ioengine_pwrite(ioengine_t *engine, const char *buffer, size_t len, off_t offset)
+{
+    return engine->dsync ? write_dsync(engine->fd, buffer, len, offset)
+                         : pwrite(engine->fd, buffer, len, offset);
+}
+
+void ioengine_set_source(ioengine_t *engine, ioengine_source_t source, void *arg)
+{
+    engine->source = source;
+    engine->source_arg = arg;
+}
+
+void ioengine_set_dsync(ioengine_t *engine, bool dsync)
+{
+    engine->dsync = dsync;
+}
+
+void ioengine_destroy(ioengine_t *engine)
+{
+    if (engine == NULL)
+        return;
+
+    uring_destroy(engine->ring);
+    free(engine->completed);
+    free(engine);
+}
+
+/*
+ * The kernel turns an RWF_DSYNC write into a FUA write, or into a write
+ * followed by a cache flush where the drive has no FUA. Elsewhere the
+ * flush is issued by hand.
+ */
+static ssize_t write_dsync(int fd, const char *buffer, size_t len, off_t offset)
+{
+    ssize_t result;
+
+#if defined(__linux__) && defined(RWF_DSYNC)
+    struct iovec iov = {(void*)buffer, len};
+
+    result = pwritev2(fd, &iov, 1, offset, RWF_DSYNC);
+#else
+    result = pwrite(fd, buffer, len, offset);
+
+    if (result != -1 && fdatasync(fd) == -1)
+        return -1;
+#endif
+
+    return result;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef IOENGINE_H
+#define IOENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/* Passed as buffer index for buffers that were not registered with the engine. */
+#define IOENGINE_NO_BUF_INDEX -1
+
+/*
+ * The null engine serves null: disks without any system call: writes
+ * complete at once, and reads get the data the source callback makes up.
+ * It can't be picked with -e; a null disk always uses it.
+ */
+typedef enum {
+    IOENGINE_PSYNC = 0,
+    IOENGINE_IO_URING,
+    IOENGINE_NULL
+} ioengine_type_t;
+
+typedef enum {
+    IOENGINE_CHECK_OK = 0,
+    IOENGINE_CHECK_ERR_UNKNOWN,
+    IOENGINE_CHECK_ERR_UNSUPPORTED,
+    IOENGINE_CHECK_ERR_MEM_ALLOC,
+    IOENGINE_CHECK_ERR_SETUP,
+    IOENGINE_CHECK_ERR_QUEUE_FULL,
+    IOENGINE_CHECK_ERR_SUBMIT
+} ioengine_check_t;
+
+typedef enum {
+    IO_OP_WRITE = 0,
+    IO_OP_READ
+} io_op_t;
+
+typedef struct io_completion_t {
+    unsigned int tag;
+    ssize_t result;     /* Transferred bytes, or -errno on failure. */
+    uint64_t end_ns;    /* When the completion was seen, CLOCK_MONOTONIC. */
+} io_completion_t;
+
+typedef struct ioengine_t ioengine_t;
+
+/* Fills a buffer with what the null engine reads at an offset. */
+typedef void (*ioengine_source_t)(void*, char*, size_t, off_t);
+
+ioengine_check_t ioengine_parse(const char*, ioengine_type_t*);
+const char *ioengine_name(ioengine_type_t);
+ioengine_check_t ioengine_probe(ioengine_type_t);
+ioengine_check_t ioengine_init(ioengine_t**, ioengine_type_t, int, unsigned int,
+                               const struct iovec*, unsigned int);
+ioengine_check_t ioengine_queue(ioengine_t*, io_op_t, int, char*, size_t, off_t, unsigned int);
+ioengine_check_t ioengine_submit(ioengine_t*, unsigned int);
+unsigned int ioengine_reap(ioengine_t*, io_completion_t*, unsigned int);
+ssize_t ioengine_pwrite(ioengine_t*, const char*, size_t, off_t);
+void ioengine_set_source(ioengine_t*, ioengine_source_t, void*);
+void ioengine_set_dsync(ioengine_t*, bool);
+void ioengine_destroy(ioengine_t*);
+
+#endif
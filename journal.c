@@ -0,0 +1,393 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "crc32c.h"
+#include "journal.h"
+#include "utils.h"
+
+#define DONE_WORDS(num_chunks) (((num_chunks) + 63) / 64)
+#define IS_DONE(done, chunk) (((done)[(chunk) / 64] >> ((chunk) % 64)) & 1)
+
+#define FLAG_VERIFY_ONLY 0x1
+#define FLAG_ZERO_FILL 0x2
+#define FLAG_SCAN 0x4
+#define FLAG_NON_DESTRUCTIVE 0x8
+#define FLAG_RANDOM 0x10
+#define FLAG_WIPE_ZERO 0x20
+#define FLAG_WIPE_DISCARD 0x40
+#define FLAG_WIPE_SECURE_DISCARD 0x80
+
+/* On-disk layout: the header, then num_ranges runs of finished chunks. */
+typedef struct journal_header_t {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t crc;           /* Of the whole file with this field zeroed. */
+    uint32_t run_id;
+    uint32_t pass;
+    uint32_t num_passes;
+    uint32_t blocksize;
+    uint32_t data_pass;
+    uint32_t flags;
+    uint64_t disk_size;
+    uint64_t chunk_size;
+    uint64_t num_chunks;
+    uint64_t num_ranges;
+    uint64_t num_patterns;
+    int16_t patterns[PATTERN_SCHEDULE_MAX];
+} journal_header_t;
+
+typedef struct journal_range_t {
+    uint64_t first;
+    uint64_t count;
+} journal_range_t;
+
+/*
+ * Internal functions' prototypes
+ */
+
+static uint64_t done_ranges(const journal_t*, journal_range_t*);
+
+/*
+ * Where the journal of a device lives, e.g. /var/tmp/diskroaster-sdd.journal.
+ * The undo log of a non-destructive run sits next to it with its own suffix.
+ */
+char *journal_path(const char *dir, const char *device_name, const char *suffix)
+{
+    char *path;
+    size_t size;
+
+    if (strncmp(device_name, "/dev/", 5) == 0)
+        device_name += 5;
+
+    size = strlen(dir) + strlen(device_name) + strlen(suffix) + sizeof("/diskroaster-");
+
+    if ((path = malloc(size)) == NULL)
+        return NULL;
+
+    snprintf(path, size, "%s/diskroaster-%s%s", dir, device_name, suffix);
+
+    /* A by-id or by-path name must not turn into subdirectories. */
+    for (char *c = path + strlen(dir) + 1; *c != '\0'; c++) {
+        if (*c == '/')
+            *c = '_';
+    }
+
+    return path;
+}
+
+journal_check_t journal_alloc(journal_t *journal, uint64_t num_chunks)
+{
+    journal->num_chunks = num_chunks;
+
+    if ((journal->done = calloc(DONE_WORDS(num_chunks), sizeof(uint64_t))) == NULL)
+        return JOURNAL_CHECK_ERR_MEM_ALLOC;
+
+    return JOURNAL_CHECK_OK;
+}
+
+journal_check_t journal_save(const char *path, const journal_t *journal)
+{
+    journal_header_t *header;
+    char *buffer;
+    char *tmp_path;
+    size_t size;
+    int fd;
+    bool written;
+
+    /* Finished chunks form a few long runs, one or two per worker, so runs are what is stored. */
+    size = sizeof(journal_header_t) + done_ranges(journal, NULL) * sizeof(journal_range_t);
+
+    if ((buffer = calloc(1, size)) == NULL ||
+        (tmp_path = malloc(strlen(path) + sizeof(".tmp"))) == NULL) {
+        free(buffer);
+        return JOURNAL_CHECK_ERR_MEM_ALLOC;
+    }
+
+    header = (journal_header_t*)buffer;
+    header->magic = JOURNAL_MAGIC;
+    header->version = JOURNAL_VERSION;
+    header->run_id = journal->run_id;
+    header->pass = journal->pass;
+    header->num_passes = journal->num_passes;
+    header->blocksize = journal->blocksize;
+    header->data_pass = journal->data_pass;
+    header->flags = (journal->verify_only ? FLAG_VERIFY_ONLY : 0) |
+                    (journal->zero_fill ? FLAG_ZERO_FILL : 0) |
+                    (journal->scan ? FLAG_SCAN : 0) |
+                    (journal->non_destructive ? FLAG_NON_DESTRUCTIVE : 0) |
+                    (journal->random ? FLAG_RANDOM : 0) |
+                    ((journal->wipe == DISK_WIPE_ZERO) ? FLAG_WIPE_ZERO : 0) |
+                    ((journal->wipe == DISK_WIPE_DISCARD) ? FLAG_WIPE_DISCARD : 0) |
+                    ((journal->wipe == DISK_WIPE_SECURE_DISCARD) ? FLAG_WIPE_SECURE_DISCARD : 0);
+    header->disk_size = (uint64_t)journal->disk_size;
+    header->chunk_size = (uint64_t)journal->chunk_size;
+    header->num_chunks = journal->num_chunks;
+    header->num_patterns = journal->patterns.length;
+
+    for (unsigned int i = 0; i < journal->patterns.length; i++)
+        header->patterns[i] = (int16_t)journal->patterns.fills[i];
+
+    header->num_ranges = done_ranges(journal,
+                                     (journal_range_t*)(buffer + sizeof(journal_header_t)));
+    header->crc = crc32c(0, buffer, size);
+
+    sprintf(tmp_path, "%s.tmp", path);
+
+    if ((fd = open(tmp_path, O_WRONLY|O_CREAT|O_TRUNC, 0644)) == -1) {
+        free(tmp_path);
+        free(buffer);
+        return JOURNAL_CHECK_ERR_IO;
+    }
+
+    written = write_all(fd, buffer, size, -1) && fsync(fd) == 0;
+    written = (close(fd) == 0) && written;
+
+    if (!written || rename(tmp_path, path) == -1) {
+        unlink(tmp_path);
+        free(tmp_path);
+        free(buffer);
+        return JOURNAL_CHECK_ERR_IO;
+    }
+
+    /* The rename itself only survives a crash once the directory is synced. */
+    journal_sync_dir(path);
+
+    free(tmp_path);
+    free(buffer);
+
+    return JOURNAL_CHECK_OK;
+}
+
+journal_check_t journal_load(const char *path, journal_t *journal)
+{
+    journal_header_t header;
+    journal_range_t *ranges;
+    char *buffer;
+    struct stat st;
+    size_t size;
+    uint32_t crc;
+    int fd;
+    bool corrupt;
+
+    memset(journal, 0, sizeof(journal_t));
+
+    if ((fd = open(path, O_RDONLY)) == -1)
+        return (errno == ENOENT) ? JOURNAL_CHECK_ERR_NOT_FOUND : JOURNAL_CHECK_ERR_IO;
+
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return JOURNAL_CHECK_ERR_IO;
+    }
+
+    size = (size_t)st.st_size;
+
+    if (size < sizeof(journal_header_t)) {
+        close(fd);
+        return JOURNAL_CHECK_ERR_CORRUPT;
+    }
+
+    if ((buffer = malloc(size)) == NULL) {
+        close(fd);
+        return JOURNAL_CHECK_ERR_MEM_ALLOC;
+    }
+
+    if (read(fd, buffer, size) != (ssize_t)size) {
+        close(fd);
+        free(buffer);
+        return JOURNAL_CHECK_ERR_IO;
+    }
+
+    close(fd);
+
+    memcpy(&header, buffer, sizeof(header));
+    crc = header.crc;
+    memset(buffer + offsetof(journal_header_t, crc), 0, sizeof(uint32_t));
+
+    corrupt = header.magic != JOURNAL_MAGIC || header.version != JOURNAL_VERSION ||
+              header.num_ranges > (size - sizeof(header)) / sizeof(journal_range_t) ||
+              size != sizeof(header) + header.num_ranges * sizeof(journal_range_t) ||
+              crc32c(0, buffer, size) != crc || header.chunk_size == 0 ||
+              header.num_chunks != (header.disk_size + header.chunk_size - 1) / header.chunk_size ||
+              header.num_patterns > PATTERN_SCHEDULE_MAX;
+
+    if (corrupt) {
+        free(buffer);
+        return JOURNAL_CHECK_ERR_CORRUPT;
+    }
+
+    journal->run_id = header.run_id;
+    journal->pass = header.pass;
+    journal->num_passes = header.num_passes;
+    journal->blocksize = header.blocksize;
+    journal->data_pass = header.data_pass;
+    journal->verify_only = (header.flags & FLAG_VERIFY_ONLY) != 0;
+    journal->zero_fill = (header.flags & FLAG_ZERO_FILL) != 0;
+    journal->scan = (header.flags & FLAG_SCAN) != 0;
+    journal->non_destructive = (header.flags & FLAG_NON_DESTRUCTIVE) != 0;
+    journal->random = (header.flags & FLAG_RANDOM) != 0;
+    journal->wipe = (header.flags & FLAG_WIPE_ZERO) ? DISK_WIPE_ZERO :
+                    (header.flags & FLAG_WIPE_DISCARD) ? DISK_WIPE_DISCARD :
+                    (header.flags & FLAG_WIPE_SECURE_DISCARD) ? DISK_WIPE_SECURE_DISCARD
+                                                              : DISK_WIPE_NONE;
+    journal->disk_size = (off_t)header.disk_size;
+    journal->chunk_size = (off_t)header.chunk_size;
+    journal->patterns.length = (unsigned int)header.num_patterns;
+
+    for (unsigned int i = 0; i < journal->patterns.length; i++)
+        journal->patterns.fills[i] = header.patterns[i];
+
+    if (journal_alloc(journal, header.num_chunks) != JOURNAL_CHECK_OK) {
+        free(buffer);
+        return JOURNAL_CHECK_ERR_MEM_ALLOC;
+    }
+
+    ranges = (journal_range_t*)(buffer + sizeof(header));
+
+    for (uint64_t i = 0; i < header.num_ranges; i++) {
+        if (ranges[i].first > header.num_chunks ||
+            ranges[i].count > header.num_chunks - ranges[i].first) {
+            journal_free(journal);
+            free(buffer);
+            return JOURNAL_CHECK_ERR_CORRUPT;
+        }
+
+        for (uint64_t chunk = ranges[i].first; chunk < ranges[i].first + ranges[i].count; chunk++)
+            journal->done[chunk / 64] |= 1ULL << (chunk % 64);
+    }
+
+    free(buffer);
+
+    return JOURNAL_CHECK_OK;
+}
+
+/* Bytes of the disk in finished chunks; the last chunk may be short. */
+off_t journal_done_bytes(const journal_t *journal)
+{
+    off_t bytes = 0;
+
+    for (uint64_t chunk = 0; chunk < journal->num_chunks; chunk++) {
+        if (!IS_DONE(journal->done, chunk))
+            continue;
+
+        bytes += (chunk == journal->num_chunks - 1)
+                 ? journal->disk_size - (off_t)chunk * journal->chunk_size
+                 : journal->chunk_size;
+    }
+
+    return bytes;
+}
+
+void journal_clear(journal_t *journal)
+{
+    memset(journal->done, 0, DONE_WORDS(journal->num_chunks) * sizeof(uint64_t));
+}
+
+void journal_remove(const char *path)
+{
+    if (unlink(path) == 0)
+        journal_sync_dir(path);
+}
+
+/* Make a new or removed file in the directory of path survive a crash. */
+void journal_sync_dir(const char *path)
+{
+    char *dir;
+    char *slash;
+    int fd;
+
+    if ((dir = strdup(path)) == NULL)
+        return;
+
+    slash = strrchr(dir, '/');
+
+    if (slash == dir)
+        slash[1] = '\0';
+    else if (slash != NULL)
+        *slash = '\0';
+    else
+        strcpy(dir, ".");
+
+    if ((fd = open(dir, O_RDONLY)) != -1) {
+        fsync(fd);
+        close(fd);
+    }
+
+    free(dir);
+}
+
+void journal_free(journal_t *journal)
+{
+    free(journal->done);
+    journal->done = NULL;
+}
+
+/* Count the runs of finished chunks and, if ranges is given, store them. */
+static uint64_t done_ranges(const journal_t *journal, journal_range_t *ranges)
+{
+    uint64_t num_ranges = 0;
+    uint64_t chunk = 0;
+    uint64_t first;
+
+    while (chunk < journal->num_chunks) {
+        /* Whole words of unfinished chunks are skipped at once. */
+        if (chunk % 64 == 0 && journal->done[chunk / 64] == 0) {
+            chunk += 64;
+            continue;
+        }
+
+        if (!IS_DONE(journal->done, chunk)) {
+            chunk++;
+            continue;
+        }
+
+        first = chunk;
+
+        while (chunk < journal->num_chunks && IS_DONE(journal->done, chunk))
+            chunk++;
+
+        if (ranges != NULL) {
+            ranges[num_ranges].first = first;
+            ranges[num_ranges].count = chunk - first;
+        }
+
+        num_ranges++;
+    }
+
+    return num_ranges;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "disk.h"
+#include "pattern.h"
+
+/*
+ * Checkpoint journal of one device. It records the pass in progress and
+ * the chunks of it that have already been written and verified, together
+ * with everything needed to carry on with the same data: the run ID, the
+ * block and chunk sizes, the fill or wipe mode and the pattern schedule.
+ * An interrupted run continues from it with --resume instead of starting
+ * over from LBA 0.
+ *
+ * The journal is replaced atomically: it is written to a temporary file,
+ * synced and renamed over the old one, so a crash or power loss leaves
+ * either the old or the new checkpoint, never a torn one. A CRC32C guards
+ * against anything else.
+ */
+
+#define JOURNAL_MAGIC 0x4c4e524a4b534944ULL     /* "DISKJRNL" */
+#define JOURNAL_VERSION 2
+#define JOURNAL_DEFAULT_DIR "/var/tmp"
+#define JOURNAL_SUFFIX ".journal"
+
+typedef struct journal_t {
+    uint32_t run_id;
+    unsigned int pass;          /* Pass in progress. */
+    unsigned int num_passes;
+    unsigned int blocksize;
+    unsigned int data_pass;     /* Pass a verify-only run checks. */
+    bool verify_only;
+    bool zero_fill;
+    bool scan;
+    bool non_destructive;
+    bool random;
+    disk_wipe_t wipe;
+    pattern_schedule_t patterns;
+    off_t disk_size;
+    off_t chunk_size;
+    uint64_t num_chunks;
+    uint64_t *done;             /* One bit per chunk finished in this pass. */
+} journal_t;
+
+typedef enum {
+    JOURNAL_CHECK_OK = 0,
+    JOURNAL_CHECK_ERR_MEM_ALLOC,
+    JOURNAL_CHECK_ERR_NOT_FOUND,
+    JOURNAL_CHECK_ERR_IO,
+    JOURNAL_CHECK_ERR_CORRUPT
+} journal_check_t;
+
+char *journal_path(const char*, const char*, const char*);
+journal_check_t journal_alloc(journal_t*, uint64_t);
+journal_check_t journal_save(const char*, const journal_t*);
+journal_check_t journal_load(const char*, journal_t*);
+off_t journal_done_bytes(const journal_t*);
+void journal_clear(journal_t*);
+void journal_remove(const char*);
+void journal_sync_dir(const char*);
+void journal_free(journal_t*);
+
+#endif
@@ -28,6 +28,7 @@
  * OF SUCH DAMAGE.
  */
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -35,9 +36,21 @@
 #include <stdbool.h>
 #include <signal.h>
 #include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
 
 #include "utils.h"
+#include "arena.h"
+#include "autotune.h"
+#include "badmap.h"
 #include "disk.h"
+#include "journal.h"
+#include "pattern.h"
+#include "steady.h"
+#include "telemetry.h"
+#include "undo.h"
+#include "verify.h"
+#include "zones.h"
 #include "workers.h"
 
 #define PROGNAME "diskroaster"
@@ -46,6 +59,126 @@
 #define DEFAULT_BLOCK_SIZE 4096
 #define DEFAULT_NUM_WORKERS 4
 #define DEFAULT_NUM_PASSES 1
+#define DEFAULT_URING_QUEUE_DEPTH 32
+#define DEFAULT_LARGE_BLOCK_SIZE (1024 * 1024)
+#define DEFAULT_BATCH_SIZE (16 * 1024 * 1024)
+#define DEFAULT_RETRIES 2
+#define DEFAULT_STEADY_ROUND 60
+#define DEFAULT_FLUSH_INTERVAL (16 * 1024 * 1024)
+
+/* Long-only options. */
+#define OPT_VERIFY_ONLY 256
+#define OPT_NO_NUMA 257
+#define OPT_RESUME 258
+#define OPT_JOURNAL 259
+#define OPT_SCAN 260
+#define OPT_NON_DESTRUCTIVE 261
+#define OPT_RETRIES 262
+#define OPT_BAD_BLOCKS 263
+#define OPT_BAD_BLOCKS_FORMAT 264
+#define OPT_ZONES 265
+#define OPT_ZONES_FORMAT 266
+#define OPT_ZONE_SIZE 267
+#define OPT_JSON 268
+#define OPT_PROMETHEUS 269
+#define OPT_RATE 270
+#define OPT_IOPS 271
+#define OPT_AUTOTUNE 272
+#define OPT_PATTERNS 273
+#define OPT_WIPE 274
+#define OPT_PRECONDITION 275
+#define OPT_STEADY_ROUND 276
+#define OPT_VERIFY_LAG 277
+#define OPT_VERIFY_FLUSH 278
+#define OPT_SYNC 279
+
+/* I/O buffers autotuning may give the workers of one device without a memory budget. */
+#define AUTOTUNE_MEMORY (1024 * 1024 * 1024)
+
+/* Passes a --rate or --iops list can set apart; the last limit holds for the rest. */
+#define MAX_PASS_LIMITS 64
+
+/* Seconds between two checkpoints of the journal. */
+#define JOURNAL_INTERVAL 30
+
+/* A device under test and its progress over the whole run. */
+typedef struct device_t {
+    const char *name;
+    off_t disk_size;
+    unsigned int sector_size;
+    unsigned int blocksize;
+    unsigned int batch_size;    /* Window a non-destructive run saves and restores at once. */
+    uint32_t run_id;
+    unsigned int data_pass;
+    int data_fill;              /* Base data of the blocks a verify-only run checks. */
+    workers_t *workers;
+    off_t total_bytes;          /* Bytes to write and verify in one pass. */
+    off_t written_bytes;
+    off_t verified_bytes;
+    off_t written_bytes_prev;
+    off_t verified_bytes_prev;
+    uint64_t write_ops_prev;
+    uint64_t read_ops_prev;
+    off_t write_rate;           /* Bytes written and verified in the last second. */
+    off_t read_rate;
+    off_t peak_rate;            /* Highest write+verify bytes in one second. */
+    off_t run_written_bytes;
+    off_t run_verified_bytes;
+    uint64_t mismatched_blocks;
+    uint64_t mismatched_sectors;
+    uint64_t read_errors;
+    uint64_t write_errors;
+    badmap_t badmap;            /* Bad sectors found over the whole run. */
+    char *badmap_path;          /* NULL unless the map is exported. */
+    bool badmap_failed;         /* Exporting the map failed, which was reported once. */
+    char *journal_path;
+    journal_t journal;
+    char *undo_path;
+    undo_t *undo;
+    bool journal_failed;        /* Saving the journal failed, which was reported once. */
+    bool ephemeral;             /* A mem: or null: disk, which has nothing to resume. */
+    bool finished;              /* All passes are done and the journal is gone. */
+    bool can_discard;           /* Preconditioning starts with a discard of the whole device. */
+    steady_t steady;            /* Write rate of the random-write phase of preconditioning. */
+    bool settled;               /* Steady, or out of rounds: no more preconditioning passes. */
+    bool sat_out;               /* The device has no part in the current pass. */
+} device_t;
+
+static void probe_device(device_t*, unsigned int, bool, bool);
+static void tune_devices(device_t*, unsigned int, workers_config_t*, unsigned int, size_t);
+static void resume_device(device_t*, const char*);
+static void check_resumed_data(device_t*);
+static void restore_device(device_t*);
+static void close_undo(device_t*);
+static void checkpoint_device(device_t*, unsigned int);
+static void save_journal(device_t*);
+static void export_badmap(device_t*, badmap_format_t);
+static void print_badmap(device_t*);
+static void export_zones(device_t*, const char*, zones_format_t, unsigned int, unsigned int);
+static void parse_limits(const char*, bool, uint64_t*, unsigned int*);
+static uint64_t pass_limit(const uint64_t*, unsigned int, unsigned int);
+static void record_telemetry(telemetry_t*, const char*, device_t*, unsigned int, unsigned int,
+                             unsigned int, unsigned int);
+static size_t buffer_memory(device_t*, unsigned int, unsigned int, unsigned int);
+static bool are_devices_running(device_t*, unsigned int);
+static bool have_devices_failed(device_t*, unsigned int);
+static bool are_devices_failed(device_t*, unsigned int);
+static void print_progress(device_t*, unsigned int, unsigned int, unsigned int, off_t, bool);
+static void format_rate(char*, size_t, off_t, uint64_t);
+static void print_summary(device_t*, unsigned int, uint64_t);
+static void print_wipe_rate(worker_stats_t*, unsigned int, disk_wipe_t);
+static bool probe_wipe(device_t*, disk_wipe_t);
+static const char *precondition_phase(unsigned int, unsigned int);
+static void track_steady_state(device_t*, unsigned int);
+static bool are_devices_settled(device_t*, unsigned int);
+static void print_steady_state(device_t*);
+static void cleanup_devices(device_t*, unsigned int);
+
+/* Highest aggregate write+verify bytes in one second over all devices. */
+static off_t peak_rate = 0;
+
+/* Random mode is about operations more than bytes, so the progress shows both. */
+static bool show_iops = false;
 
 bool terminate = false;
 
@@ -65,16 +198,78 @@ void usage(void)
 {
     char *usage =
     PROGNAME " - Multi-threaded disk testing utility, v" PROG_VERSION "\n\n"
-    "Usage: " PROGNAME " [OPTIONS] DEVICE\n\n"
+    "Usage: " PROGNAME " [OPTIONS] DEVICE [DEVICE...]\n\n"
+    "A DEVICE is a disk, a regular file, mem:<size> for a disk in memory\n"
+    "or null:<size> for one that discards writes and reads back the expected data\n\n"
     "Options:\n"
     "  -h               - Print help and exit\n"
-    "  -w <workers>     - Number of parallel worker threads (default: 4)\n"
+    "  -w <workers>     - Number of parallel worker threads per device (default: 4)\n"
     "  -n <passes>      - Number of write+verify passes to perform (default: 1)\n"
     "  -b <blocksize>   - Block size for write operations (default: 4096)\n"
     "                     Supports k and m suffixes (e.g., 64k, 1m, 32m)\n"
+    "  -e <engine>      - I/O engine: psync or io_uring (default: psync)\n"
+    "  -q <depth>       - Blocks kept in flight per worker\n"
+    "                     (default: 1 for psync, 32 for io_uring)\n"
+    "  -m <budget>      - Memory budget for I/O buffers; lowers the queue depth to fit\n"
+    "                     Supports k, m and g suffixes (e.g., 512m, 4g)\n"
+    "  -c <chunksize>   - Unit of work handed out to the workers (default: 64m)\n"
+    "                     Must be a multiple of the block size\n"
+    "  -s               - Streaming mode: write each chunk sequentially,\n"
+    "                     then read it back and verify it sequentially\n"
+    "  -W <window>      - Streaming window instead of the whole chunk\n"
+    "                     Implies -s, must be a multiple of the block size\n"
+    "  -r               - Random mode: visit every block once in a pseudo-random order\n"
+    "                     and report IOPS\n"
     "  -y               - Skip confirmation prompt and start immediately\n"
     "                     This will destroy all data on the target disk\n"
-    "  -z               - Write zero-filled blocks instead of random data\n";
+    "  -z               - Write zero-filled blocks instead of random data\n"
+    "  --patterns <list> - Base data of pass 1, 2 and so on in turn, e.g.\n"
+    "                     0x00,0xff,0xaa,0x55,random (default: random)\n"
+    "  --wipe <mode>    - Only wipe the device, without verifying: zero, discard or\n"
+    "                     secure-discard, offloaded to the device where it can\n"
+    "                     (default: 1m blocks for zeros it can't offload)\n"
+    "  --precondition <fills> - Precondition an SSD instead of testing it: discard it,\n"
+    "                     fill it sequentially fills times, then write random blocks\n"
+    "                     until the write rate reaches steady state\n"
+    "                     (default: io_uring; -b sets the random block size)\n"
+    "  --steady-round <seconds> - Length of one round of the steady-state window\n"
+    "                     (default: 60)\n"
+    "  --verify-lag <size> - Read a block back only after each worker has written\n"
+    "                     another size bytes, so it comes from the media and not\n"
+    "                     from the drive's write cache, e.g. 64m (default: 0)\n"
+    "  --verify-flush   - Flush the drive's write cache before the lagged read-backs\n"
+    "  --sync <mode>    - Make the writes durable: dsync makes every write a FUA write\n"
+    "                     (RWF_DSYNC), fdatasync[:<size>] flushes the drive's write\n"
+    "                     cache every size bytes of each worker (default: 16m)\n"
+    "  --verify-only    - Check the checksummed blocks left by an earlier run\n"
+    "                     without writing; block size and run ID are read from the disk\n"
+    "  --scan           - Read-only surface scan: report unreadable and slow regions\n"
+    "                     without writing (default: 1m blocks with io_uring)\n"
+    "  --non-destructive - Save each batch of the disk, test it and write it back,\n"
+    "                     keeping the saved data in an undo log until it is restored\n"
+    "                     (default: 1m blocks with io_uring, -W sets the batch: 16m)\n"
+    "  --retries <n>    - Attempts at a failed block before it is narrowed down\n"
+    "                     to its bad sectors (default: 2)\n"
+    "  --bad-blocks <dir> - Export the bad sectors of every device to a file in dir\n"
+    "  --bad-blocks-format <format> - badblocks or json (default: badblocks)\n"
+    "  --zones <dir>    - Export the throughput and latency per LBA zone of every pass\n"
+    "                     to a file in dir\n"
+    "  --zones-format <format> - csv or json (default: csv)\n"
+    "  --zone-size <size> - LBA range of one zone (default: 1g)\n"
+    "  --rate <rate>    - Limit the write and read traffic of every device in MB/s,\n"
+    "                     e.g. 200m; a list such as 100m,400m,0 sets every pass\n"
+    "  --iops <iops>    - Limit the I/O operations per second of every device,\n"
+    "                     a list sets every pass like --rate\n"
+    "  --autotune       - Probe block sizes, worker counts and queue depths on the\n"
+    "                     start of the first device and test with the fastest;\n"
+    "                     -b, -w and -q given on the command line are kept\n"
+    "  --json <target>  - Write a JSON record per device every second to a file,\n"
+    "                     fd:N or unix:/path/to/socket\n"
+    "  --prometheus <file> - Keep a node_exporter textfile up to date\n"
+    "  --no-numa        - Don't pin workers and their buffers to the device's NUMA node\n"
+    "  --resume         - Continue an interrupted run from its checkpoint journal\n"
+    "  --journal <dir>  - Directory of the checkpoint journals\n"
+    "                     (default: " JOURNAL_DEFAULT_DIR ")\n";
 
     fprintf(stderr, "%s", usage);
 }
@@ -83,21 +278,106 @@ int main(int argc, char **argv)
 {
 
     int opt;
-    off_t disk_size;
-    char eta[9];
     utils_check_t result;
     unsigned int blocksize = DEFAULT_BLOCK_SIZE;
     unsigned num_workers = DEFAULT_NUM_WORKERS;
     unsigned num_passes = DEFAULT_NUM_PASSES;
-    unsigned int pass;
-    unsigned int sector_size;
+    unsigned int pass = 1;
+    unsigned int queue_depth = 0;
+    unsigned int requested_queue_depth;
+    off_t memory_budget = 0;
+    size_t memory_needed;
+    arena_t *arena;
+    ioengine_type_t engine = IOENGINE_PSYNC;
+    workers_config_t workers_config;
+    unsigned int stream_window = 0;
+    unsigned int chunk_size = 0;
+    uint32_t run_id;
+    const char *journal_dir = JOURNAL_DEFAULT_DIR;
+    const char *badmap_dir = NULL;
+    badmap_format_t badmap_format = BADMAP_FORMAT_BADBLOCKS;
+    unsigned int retries = DEFAULT_RETRIES;
+    const char *zones_dir = NULL;
+    zones_format_t zones_format = ZONES_FORMAT_CSV;
+    off_t zone_size = 0;
+    const char *json_target = NULL;
+    const char *prom_path = NULL;
+    telemetry_t *telemetry = NULL;
+    uint64_t rate_limits[MAX_PASS_LIMITS];
+    uint64_t iops_limits[MAX_PASS_LIMITS];
+    unsigned int num_rate_limits = 0;
+    unsigned int num_iops_limits = 0;
+    pattern_schedule_t patterns;
+    char pattern_name[16];
+    off_t device_chunk_size;
+    uint64_t num_chunks;
+    unsigned int seconds;
+    bool resume = false;
+    bool num_passes_set = false;
+    bool stream = false;
+    bool verify_only = false;
+    bool scan = false;
+    bool non_destructive = false;
+    bool random = false;
+    bool engine_set = false;
+    bool blocksize_set = false;
+    bool workers_set = false;
+    bool queue_depth_set = false;
+    bool autotune = false;
+    unsigned int autotune_fixed = 0;
     bool write_zeros = false;
+    bool patterns_set = false;
+    disk_wipe_t wipe = DISK_WIPE_NONE;
+    bool precondition = false;
+    unsigned int num_fills = 0;
+    unsigned int steady_round = DEFAULT_STEADY_ROUND;
+    bool steady_round_set = false;
+    disk_wipe_t pass_wipe;
+    off_t verify_lag = 0;
+    bool verify_flush = false;
+    bool dsync = false;
+    off_t flush_interval = 0;
+    char detail[48];
     bool skip_prompt = false;
-    char *device_name = NULL;
-    char *wr_data = NULL;
-    off_t verified_bytes;
+    bool numa = true;
+    bool redraw;
+    device_t *devices;
+    device_t *device;
+    unsigned int num_devices;
+    worker_stats_t *stats;
+    off_t total_bytes;
+    uint64_t start_ns;
+    int exit_code;
+
+    static const struct option long_options[] = {
+        {"verify-only", no_argument, NULL, OPT_VERIFY_ONLY},
+        {"no-numa", no_argument, NULL, OPT_NO_NUMA},
+        {"resume", no_argument, NULL, OPT_RESUME},
+        {"journal", required_argument, NULL, OPT_JOURNAL},
+        {"scan", no_argument, NULL, OPT_SCAN},
+        {"non-destructive", no_argument, NULL, OPT_NON_DESTRUCTIVE},
+        {"retries", required_argument, NULL, OPT_RETRIES},
+        {"bad-blocks", required_argument, NULL, OPT_BAD_BLOCKS},
+        {"bad-blocks-format", required_argument, NULL, OPT_BAD_BLOCKS_FORMAT},
+        {"zones", required_argument, NULL, OPT_ZONES},
+        {"zones-format", required_argument, NULL, OPT_ZONES_FORMAT},
+        {"zone-size", required_argument, NULL, OPT_ZONE_SIZE},
+        {"json", required_argument, NULL, OPT_JSON},
+        {"prometheus", required_argument, NULL, OPT_PROMETHEUS},
+        {"rate", required_argument, NULL, OPT_RATE},
+        {"iops", required_argument, NULL, OPT_IOPS},
+        {"autotune", no_argument, NULL, OPT_AUTOTUNE},
+        {"patterns", required_argument, NULL, OPT_PATTERNS},
+        {"wipe", required_argument, NULL, OPT_WIPE},
+        {"precondition", required_argument, NULL, OPT_PRECONDITION},
+        {"steady-round", required_argument, NULL, OPT_STEADY_ROUND},
+        {"verify-lag", required_argument, NULL, OPT_VERIFY_LAG},
+        {"verify-flush", no_argument, NULL, OPT_VERIFY_FLUSH},
+        {"sync", required_argument, NULL, OPT_SYNC},
+        {NULL, 0, NULL, 0}
+    };
 
-    while ((opt = getopt(argc, argv, "b:w:n:zhy")) != -1) {
+    while ((opt = getopt_long(argc, argv, "b:w:n:e:q:m:c:sW:rzhy", long_options, NULL)) != -1) {
 
         switch (opt) {
             case 'b':
@@ -113,6 +393,8 @@ int main(int argc, char **argv)
                     fprintf(stderr, "Block size is required to be a multiple of 512 bytes.\n");
                     exit(EXIT_FAILURE);
                 }
+
+                blocksize_set = true;
                 break;
 
             case 'w':
@@ -123,6 +405,7 @@ int main(int argc, char **argv)
                     exit(EXIT_FAILURE);
                 }
 
+                workers_set = true;
                 break;
 
             case 'n':
@@ -133,6 +416,74 @@ int main(int argc, char **argv)
                     exit(EXIT_FAILURE);
                 }
 
+                num_passes_set = true;
+                break;
+
+            case 'e':
+                if (ioengine_parse(optarg, &engine) != IOENGINE_CHECK_OK) {
+                    fprintf(stderr, "Unknown I/O engine: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+                engine_set = true;
+                break;
+
+            case 'q':
+                result = str_to_uint(optarg, &queue_depth);
+
+                if (result == UTILS_CHECK_ERR_NAN) {
+                    fprintf(stderr, "%s\n", "Invalid queue depth.");
+                    exit(EXIT_FAILURE);
+                }
+
+                break;
+
+            case 'm':
+                result = get_large_size_in_bytes(optarg, &memory_budget);
+
+                if (result == UTILS_CHECK_ERR_UNKNOWN_UNIT) {
+                    fprintf(stderr, "%s\n", "Unknown unit suffix set in memory budget.");
+                    exit(EXIT_FAILURE);
+                } else if (result == UTILS_CHECK_ERR_NAN) {
+                    fprintf(stderr, "%s\n", "Invalid memory budget value.");
+                    exit(EXIT_FAILURE);
+                }
+
+                break;
+
+            case 'c':
+                result = get_size_in_bytes(optarg, &chunk_size);
+
+                if (result == UTILS_CHECK_ERR_UNKNOWN_UNIT) {
+                    fprintf(stderr, "%s\n", "Unknown unit suffix set in chunk size.");
+                    exit(EXIT_FAILURE);
+                } else if (result == UTILS_CHECK_ERR_NAN || chunk_size == 0) {
+                    fprintf(stderr, "%s\n", "Invalid chunk size value.");
+                    exit(EXIT_FAILURE);
+                }
+
+                break;
+
+            case 's':
+                stream = true;
+                break;
+
+            case 'W':
+                result = get_size_in_bytes(optarg, &stream_window);
+
+                if (result == UTILS_CHECK_ERR_UNKNOWN_UNIT) {
+                    fprintf(stderr, "%s\n", "Unknown unit suffix set in streaming window.");
+                    exit(EXIT_FAILURE);
+                } else if (result == UTILS_CHECK_ERR_NAN) {
+                    fprintf(stderr, "%s\n", "Invalid streaming window value.");
+                    exit(EXIT_FAILURE);
+                }
+
+                stream = true;
+                break;
+
+            case 'r':
+                random = true;
                 break;
 
             case 'z':
@@ -143,6 +494,184 @@ int main(int argc, char **argv)
                 skip_prompt = true;
                 break;
 
+            case OPT_VERIFY_ONLY:
+                verify_only = true;
+                break;
+
+            case OPT_NO_NUMA:
+                numa = false;
+                break;
+
+            case OPT_RESUME:
+                resume = true;
+                break;
+
+            case OPT_JOURNAL:
+                journal_dir = optarg;
+                break;
+
+            case OPT_SCAN:
+                scan = true;
+                break;
+
+            case OPT_NON_DESTRUCTIVE:
+                non_destructive = true;
+                break;
+
+            case OPT_RETRIES:
+                result = str_to_uint(optarg, &retries);
+
+                if (result == UTILS_CHECK_ERR_NAN) {
+                    fprintf(stderr, "%s\n", "Invalid number of retries.");
+                    exit(EXIT_FAILURE);
+                }
+
+                break;
+
+            case OPT_BAD_BLOCKS:
+                badmap_dir = optarg;
+                break;
+
+            case OPT_BAD_BLOCKS_FORMAT:
+                if (badmap_parse_format(optarg, &badmap_format) != BADMAP_CHECK_OK) {
+                    fprintf(stderr, "Unknown bad-block map format: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+                break;
+
+            case OPT_ZONES:
+                zones_dir = optarg;
+                break;
+
+            case OPT_ZONES_FORMAT:
+                if (zones_parse_format(optarg, &zones_format) != ZONES_CHECK_OK) {
+                    fprintf(stderr, "Unknown zone profile format: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+                break;
+
+            case OPT_ZONE_SIZE:
+                result = get_large_size_in_bytes(optarg, &zone_size);
+
+                if (result == UTILS_CHECK_ERR_UNKNOWN_UNIT) {
+                    fprintf(stderr, "%s\n", "Unknown unit suffix set in zone size.");
+                    exit(EXIT_FAILURE);
+                } else if (result == UTILS_CHECK_ERR_NAN || zone_size <= 0) {
+                    fprintf(stderr, "%s\n", "Invalid zone size value.");
+                    exit(EXIT_FAILURE);
+                }
+
+                break;
+
+            case OPT_JSON:
+                json_target = optarg;
+                break;
+
+            case OPT_PROMETHEUS:
+                prom_path = optarg;
+                break;
+
+            case OPT_RATE:
+                parse_limits(optarg, true, rate_limits, &num_rate_limits);
+                break;
+
+            case OPT_IOPS:
+                parse_limits(optarg, false, iops_limits, &num_iops_limits);
+                break;
+
+            case OPT_AUTOTUNE:
+                autotune = true;
+                break;
+
+            case OPT_PATTERNS:
+                switch (pattern_parse_schedule(optarg, &patterns)) {
+                    case PATTERN_CHECK_OK:
+                        break;
+
+                    case PATTERN_CHECK_ERR_TOO_MANY:
+                        fprintf(stderr, "At most %d patterns can be given.\n",
+                                        PATTERN_SCHEDULE_MAX);
+                        exit(EXIT_FAILURE);
+
+                    default:
+                        fprintf(stderr, "Invalid pattern list: %s\n", optarg);
+                        exit(EXIT_FAILURE);
+                }
+
+                patterns_set = true;
+                break;
+
+            case OPT_WIPE:
+                if (disk_parse_wipe(optarg, &wipe) != DISKDEV_CHECK_OK) {
+                    fprintf(stderr, "Unknown wipe mode: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case OPT_PRECONDITION:
+                result = str_to_uint(optarg, &num_fills);
+
+                if (result == UTILS_CHECK_ERR_NAN) {
+                    fprintf(stderr, "%s\n", "Invalid number of fills.");
+                    exit(EXIT_FAILURE);
+                }
+
+                precondition = true;
+                break;
+
+            case OPT_STEADY_ROUND:
+                result = str_to_uint(optarg, &steady_round);
+
+                if (result == UTILS_CHECK_ERR_NAN || steady_round == 0) {
+                    fprintf(stderr, "%s\n", "Invalid steady-state round length.");
+                    exit(EXIT_FAILURE);
+                }
+
+                steady_round_set = true;
+                break;
+
+            case OPT_VERIFY_LAG:
+                result = get_large_size_in_bytes(optarg, &verify_lag);
+
+                if (result == UTILS_CHECK_ERR_UNKNOWN_UNIT) {
+                    fprintf(stderr, "%s\n", "Unknown unit suffix set in verify lag.");
+                    exit(EXIT_FAILURE);
+                } else if (result == UTILS_CHECK_ERR_NAN) {
+                    fprintf(stderr, "%s\n", "Invalid verify lag value.");
+                    exit(EXIT_FAILURE);
+                }
+
+                break;
+
+            case OPT_VERIFY_FLUSH:
+                verify_flush = true;
+                break;
+
+            case OPT_SYNC:
+                dsync = (strcmp(optarg, "dsync") == 0);
+                flush_interval = 0;
+
+                if (strcmp(optarg, "fdatasync") == 0) {
+                    flush_interval = DEFAULT_FLUSH_INTERVAL;
+                } else if (strncmp(optarg, "fdatasync:", strlen("fdatasync:")) == 0) {
+                    result = get_large_size_in_bytes(optarg + strlen("fdatasync:"),
+                                                     &flush_interval);
+
+                    if (result == UTILS_CHECK_ERR_UNKNOWN_UNIT) {
+                        fprintf(stderr, "%s\n", "Unknown unit suffix set in fdatasync interval.");
+                        exit(EXIT_FAILURE);
+                    } else if (result == UTILS_CHECK_ERR_NAN || flush_interval == 0) {
+                        fprintf(stderr, "%s\n", "Invalid fdatasync interval value.");
+                        exit(EXIT_FAILURE);
+                    }
+                } else if (!dsync) {
+                    fprintf(stderr, "Unknown sync mode: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
             case 'h':
             case '?':
 
@@ -157,122 +686,1631 @@ int main(int argc, char **argv)
         exit(EXIT_SUCCESS);
     }
 
-    device_name = argv[optind];
+    if (verify_only && write_zeros) {
+        fprintf(stderr, "Zero-filled blocks carry no checksums and can't be verified "
+                        "with --verify-only.\n");
+        exit(EXIT_FAILURE);
+    }
 
-    switch (disk_device_check(device_name)) {
-        case DISKDEV_CHECK_ERR_STAT:
-            fprintf(stderr, "Can't access device: %s: %s\n", device_name, strerror(errno));
-            exit(EXIT_FAILURE);
+    if (scan && (verify_only || write_zeros)) {
+        fprintf(stderr, "A surface scan only reads and can't be combined with -z "
+                        "or --verify-only.\n");
+        exit(EXIT_FAILURE);
+    }
 
-        case DISKDEV_CHECK_ERR_NOT_DISK:
-            fprintf(stderr, "Error: %s is not a disk device.\n", device_name);
-            exit(EXIT_FAILURE);
+    /* Zero-filled blocks are untagged, --patterns 0x00 writes zeros under the tags. */
+    if (patterns_set && (write_zeros || verify_only || scan)) {
+        fprintf(stderr, "--patterns can't be combined with -z, --verify-only or --scan.\n");
+        exit(EXIT_FAILURE);
+    }
 
-        default:
-            break;
+    if (non_destructive && (verify_only || scan)) {
+        fprintf(stderr, "A non-destructive run writes and can't be combined with --verify-only "
+                        "or --scan.\n");
+        exit(EXIT_FAILURE);
     }
 
-    switch (get_disk_sector_size(device_name, &sector_size)) {
-        case DISKDEV_CHECK_ERR_OPEN:
-            fprintf(stderr, "Can't open device: %s: %s\n", device_name,
-                            strerror(errno));
-            exit(EXIT_FAILURE);
+    /* A wipe only writes whatever the device makes of the range, there is nothing to check. */
+    if (wipe != DISK_WIPE_NONE && (write_zeros || patterns_set || random || verify_only || scan ||
+                                   non_destructive || autotune)) {
+        fprintf(stderr, "--wipe can't be combined with -z, -r, --patterns, --verify-only, --scan, "
+                        "--non-destructive or --autotune.\n");
+        exit(EXIT_FAILURE);
+    }
 
-        case DISKDEV_CHECK_ERR_IOCTL:
-            fprintf(stderr, "Can't get sector size of the device: %s: %s\n", device_name,
-                            strerror(errno));
-            exit(EXIT_FAILURE);
+    /*
+     * Preconditioning sets the data, the order and the passes itself, and
+     * it leaves the drive written over, so there is nothing to resume.
+     */
+    if (precondition && (num_passes_set || write_zeros || patterns_set || random || verify_only ||
+                         scan || non_destructive || wipe != DISK_WIPE_NONE || resume)) {
+        fprintf(stderr, "--precondition can't be combined with -n, -r, -z, --patterns, "
+                        "--verify-only, --scan, --non-destructive, --wipe or --resume.\n");
+        exit(EXIT_FAILURE);
+    }
 
-        default:
-            break;
+    if (steady_round_set && !precondition) {
+        fprintf(stderr, "--steady-round only applies to --precondition.\n");
+        exit(EXIT_FAILURE);
+    }
 
+    /*
+     * Only blocks read back right after their write can lag. A streaming
+     * window is read back once all of it is written, which lags already.
+     */
+    if (verify_lag > 0 && (stream || verify_only || scan || non_destructive ||
+                           wipe != DISK_WIPE_NONE || precondition)) {
+        fprintf(stderr, "--verify-lag can't be combined with -s, -W, --verify-only, --scan, "
+                        "--non-destructive, --wipe or --precondition.\n");
+        exit(EXIT_FAILURE);
     }
 
-    if (blocksize < sector_size) {
-        fprintf(stderr, "The block size can't be less than the disk's sector size (%u).\n",
-                        sector_size);
+    if (verify_flush && verify_lag == 0) {
+        fprintf(stderr, "--verify-flush only applies to --verify-lag.\n");
         exit(EXIT_FAILURE);
     }
 
-    switch (get_disk_size(device_name, &disk_size)) {
-        case DISKDEV_CHECK_ERR_OPEN:
-            fprintf(stderr, "Can't open device: %s: %s\n", device_name,
-                            strerror(errno));
-            exit(EXIT_FAILURE);
+    /* A wipe goes to the device as a whole, the others don't write at all. */
+    if ((dsync || flush_interval > 0) && (verify_only || scan || wipe != DISK_WIPE_NONE)) {
+        fprintf(stderr, "--sync can't be combined with --verify-only, --scan or --wipe.\n");
+        exit(EXIT_FAILURE);
+    }
 
-        case DISKDEV_CHECK_ERR_LSEEK:
-            fprintf(stderr, "Can't get disk size from the device: %s: %s\n", device_name,
-                            strerror(errno));
-            exit(EXIT_FAILURE);
+    /* A discard pass, the fills and the random writes, which go on until the drive settles. */
+    if (precondition)
+        num_passes = num_fills + 2;
 
-        default:
-            break;
+    /* The undo log saves contiguous batches, a random window is scattered over the disk. */
+    if (non_destructive && random) {
+        fprintf(stderr, "A non-destructive run can't visit the blocks in random order.\n");
+        exit(EXIT_FAILURE);
     }
 
-    /* Continue to perform data destructive disk testing? */
-    if (!skip_prompt && display_prompt())
-        exit(EXIT_SUCCESS);
+    /* A resumed run has to go on with the same data and the same chunks. */
+    if (resume && (blocksize_set || chunk_size != 0 || num_passes_set || write_zeros || random ||
+                   verify_only || scan || non_destructive || patterns_set ||
+                   wipe != DISK_WIPE_NONE)) {
+        fprintf(stderr, "-b, -c, -n, -r, -z, --verify-only, --scan, --non-destructive, "
+                        "--patterns and --wipe are taken from the journal with --resume.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (resume && autotune) {
+        fprintf(stderr, "A resumed run goes on with the settings it was started with and can't "
+                        "be autotuned.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Without --patterns every pass writes the data stream, or zeros with -z. */
+    if (!patterns_set) {
+        memset(&patterns, 0, sizeof(patterns));
+        patterns.length = write_zeros ? 1 : 0;
+    }
+
+    /*
+     * Large blocks scan at full speed; nothing is written, so the size
+     * doesn't matter otherwise. A non-destructive run moves every byte
+     * four times and needs large blocks even more.
+     */
+    if ((scan || non_destructive || wipe != DISK_WIPE_NONE) && !blocksize_set)
+        blocksize = DEFAULT_LARGE_BLOCK_SIZE;
+
+    if (stream_window % blocksize != 0) {
+        fprintf(stderr, "Streaming window is required to be a multiple of the block size.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (chunk_size % blocksize != 0) {
+        fprintf(stderr, "Chunk size is required to be a multiple of the block size.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Every remaining argument is a device to test. */
+    num_devices = argc - optind;
 
-    if (posix_memalign((void**)&wr_data, sector_size, blocksize)  != 0) {
+    if ((devices = calloc(num_devices, sizeof(device_t))) == NULL) {
         fprintf(stderr, "%s\n", "No free memory to allocate.");
-            exit(EXIT_FAILURE);
+        exit(EXIT_FAILURE);
     }
 
-    (write_zeros)? memset(wr_data, 0, blocksize) : fill_random_data(wr_data, blocksize);
+    for (unsigned int i = 0; i < num_devices; i++) {
+        devices[i].name = argv[optind + i];
 
-    signal(SIGINT, handle_sigint);
+        for (unsigned int j = 0; j < i; j++) {
+            if (strcmp(devices[i].name, devices[j].name) == 0) {
+                fprintf(stderr, "Device %s is listed more than once.\n", devices[i].name);
+                exit(EXIT_FAILURE);
+            }
+        }
 
-    switch (init_workers(num_workers, device_name, disk_size, blocksize, sector_size, wr_data)) {
-        case WORKERS_CHECK_ERR_MEM_ALLOC:
+        if ((devices[i].journal_path = journal_path(journal_dir, devices[i].name,
+                                                    JOURNAL_SUFFIX)) == NULL ||
+            (devices[i].undo_path = journal_path(journal_dir, devices[i].name,
+                                                 UNDO_SUFFIX)) == NULL ||
+            (badmap_dir != NULL &&
+             (devices[i].badmap_path = journal_path(badmap_dir, devices[i].name,
+                                                    badmap_suffix(badmap_format))) == NULL) ||
+            badmap_init(&devices[i].badmap) != BADMAP_CHECK_OK) {
             fprintf(stderr, "%s\n", "No free memory to allocate.");
-            free(wr_data);
+            exit(EXIT_FAILURE);
+        }
+
+        if (!resume) {
+            probe_device(&devices[i], blocksize, blocksize_set, verify_only);
+            restore_device(&devices[i]);
+            continue;
+        }
+
+        resume_device(&devices[i], journal_dir);
+
+        /* All devices of a run go through their passes together. */
+        if (i == 0) {
+            pass = devices[0].journal.pass;
+            num_passes = devices[0].journal.num_passes;
+            verify_only = devices[0].journal.verify_only;
+            write_zeros = devices[0].journal.zero_fill;
+            scan = devices[0].journal.scan;
+            non_destructive = devices[0].journal.non_destructive;
+            random = devices[0].journal.random;
+            patterns = devices[0].journal.patterns;
+            wipe = devices[0].journal.wipe;
+        } else if (devices[i].journal.pass != pass ||
+                   devices[i].journal.num_passes != num_passes ||
+                   devices[i].journal.verify_only != verify_only ||
+                   devices[i].journal.scan != scan ||
+                   devices[i].journal.non_destructive != non_destructive ||
+                   devices[i].journal.random != random ||
+                   devices[i].journal.zero_fill != write_zeros ||
+                   devices[i].journal.wipe != wipe ||
+                   devices[i].journal.patterns.length != patterns.length ||
+                   memcmp(devices[i].journal.patterns.fills, patterns.fills,
+                          patterns.length * sizeof(int)) != 0) {
+            fprintf(stderr, "%s and %s were interrupted at different points of different runs; "
+                            "resume them separately.\n", devices[0].name, devices[i].name);
+            exit(EXIT_FAILURE);
+        }
+
+        probe_device(&devices[i], devices[i].journal.blocksize, true, verify_only);
+
+        if (devices[i].disk_size != devices[i].journal.disk_size) {
+            fprintf(stderr, "%s is not the disk recorded in %s: its size differs.\n",
+                            devices[i].name, devices[i].journal_path);
+            exit(EXIT_FAILURE);
+        }
+
+        if (stream_window % devices[i].blocksize != 0) {
+            fprintf(stderr, "Streaming window is required to be a multiple of the block size.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        restore_device(&devices[i]);
+        check_resumed_data(&devices[i]);
+    }
+
+    /*
+     * A surface scan keeps many reads in flight unless an engine was asked
+     * for, and so do a non-destructive run and preconditioning.
+     */
+    if ((scan || non_destructive || precondition) && !engine_set &&
+        ioengine_probe(IOENGINE_IO_URING) == IOENGINE_CHECK_OK)
+        engine = IOENGINE_IO_URING;
+
+    switch (ioengine_probe(engine)) {
+        case IOENGINE_CHECK_ERR_UNSUPPORTED:
+            fprintf(stderr, "The %s I/O engine is not supported on this system.\n",
+                            ioengine_name(engine));
             exit(EXIT_FAILURE);
 
-        case WORKERS_CHECK_ERR_PTHREAD:
-            fprintf(stderr, "Error initializing workers: %s\n", strerror(pthread_errno));
-            free(wr_data);
+        case IOENGINE_CHECK_ERR_SETUP:
+            fprintf(stderr, "Can't set up the %s I/O engine: %s\n", ioengine_name(engine),
+                            strerror(errno));
             exit(EXIT_FAILURE);
 
         default:
             break;
     }
 
-    pass = 1;
+    queue_depth_set = queue_depth != 0;
 
-    do {
+    if (queue_depth == 0)
+        queue_depth = (engine == IOENGINE_IO_URING) ? DEFAULT_URING_QUEUE_DEPTH : 1;
 
-        if (start_workers() == WORKERS_CHECK_ERR_PTHREAD) {
-            fprintf(stderr, "Error starting workers: %s\n", strerror(pthread_errno));
-            cleanup_workers();
-            exit(EXIT_FAILURE);
-        }
+    if (num_devices > 1) {
+        fprintf(stderr, "Testing %u devices:", num_devices);
 
-        while (are_workers_running()) {
-            /* If SIGINT is received,  wait for all workers to stop. */
-            if (terminate) {
-                sleep(1);
-                continue;
-            }
+        for (unsigned int i = 0; i < num_devices; i++)
+            fprintf(stderr, " %s", devices[i].name);
 
-            verified_bytes = get_workers_progress();
+        fprintf(stderr, "\n");
+    }
 
-            get_eta(eta, verified_bytes, disk_size);
+    /* Continue to perform data destructive disk testing? Autotuning already writes. */
+    if (!verify_only && !scan && !non_destructive && !skip_prompt && display_prompt())
+        exit(EXIT_SUCCESS);
 
-            fprintf(stderr, "\033[2K\rpass: %d/%d, verified: %ld MB, completed: %ld%%, ETA: %s\r",
-                            pass,
-                            num_passes,
-                            (verified_bytes / 1024 / 1024),
-                            (verified_bytes * 100) / disk_size,
-                            eta);
-            sleep(1);
-        }
+    /*
+     * The probes use the engine and the mode of the run, but a run that
+     * must not destroy data probes by reading only. A random run is about
+     * the block size it was given, and a verify-only run reads the blocks
+     * it finds on the disk.
+     */
+    if (autotune) {
+        if (blocksize_set || random || verify_only)
+            autotune_fixed |= AUTOTUNE_FIXED_BLOCKSIZE;
 
-        pass++;
-    } while (pass <= num_passes && terminate == false);
+        if (workers_set)
+            autotune_fixed |= AUTOTUNE_FIXED_WORKERS;
 
-    putchar('\n');
-    cleanup_workers();
+        if (queue_depth_set)
+            autotune_fixed |= AUTOTUNE_FIXED_QUEUE_DEPTH;
 
-    return 0;
-}
+        memset(&workers_config, 0, sizeof(workers_config));
+        workers_config.num_workers = num_workers;
+        workers_config.blocksize = devices[0].blocksize;
+        workers_config.engine = engine;
+        workers_config.queue_depth = queue_depth;
+        workers_config.stream = stream;
+        workers_config.stream_window = stream_window;
+        workers_config.chunk_size = chunk_size;
+        workers_config.patterns = patterns;
+        workers_config.tag_sectors = !write_zeros;
+        workers_config.scan = verify_only || scan || non_destructive;
+        workers_config.random = random;
+        workers_config.retries = retries;
+        workers_config.numa = numa;
+        workers_config.run_id = generate_run_id();
+
+        signal(SIGINT, handle_sigint);
+
+        tune_devices(devices, num_devices, &workers_config, autotune_fixed,
+                     (memory_budget > 0) ? (size_t)memory_budget / num_devices : AUTOTUNE_MEMORY);
+
+        if (terminate)
+            exit(EXIT_SUCCESS);
 
+        num_workers = workers_config.num_workers;
+        queue_depth = workers_config.queue_depth;
+    }
+
+    /*
+     * Only now that the data may go can a discard be tried. A drive that
+     * can't discard starts preconditioning with the fill instead.
+     */
+    for (unsigned int i = 0; i < num_devices && precondition; i++) {
+        devices[i].ephemeral = true;
+        devices[i].can_discard = probe_wipe(&devices[i], DISK_WIPE_DISCARD);
+        steady_init(&devices[i].steady, steady_round);
+
+        if (!devices[i].can_discard)
+            fprintf(stderr, "%s can't discard, preconditioning starts with the fill.\n",
+                            devices[i].name);
+    }
+
+    /*
+     * A discard can't be emulated, so a device that can't take one would
+     * only fail in every worker once the wipe has started, and leave a
+     * checkpoint that can never complete. Zeros are written where they
+     * can't be offloaded.
+     */
+    for (unsigned int i = 0; i < num_devices && wipe != DISK_WIPE_NONE && wipe != DISK_WIPE_ZERO;
+         i++) {
+        if (!probe_wipe(&devices[i], wipe)) {
+            fprintf(stderr, "%s can't %s: %s\n", devices[i].name,
+                            (wipe == DISK_WIPE_DISCARD) ? "discard" : "discard securely",
+                            strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /*
+     * A non-destructive run saves, tests and restores one streaming window
+     * at a time, 16 MB unless -W says otherwise, so a handful of syncs per
+     * batch don't hold up the I/O.
+     */
+    for (unsigned int i = 0; i < num_devices && non_destructive; i++) {
+        if (stream_window != 0)
+            devices[i].batch_size = stream_window;
+        else if (devices[i].blocksize >= DEFAULT_BATCH_SIZE)
+            devices[i].batch_size = devices[i].blocksize;
+        else
+            devices[i].batch_size = DEFAULT_BATCH_SIZE - DEFAULT_BATCH_SIZE % devices[i].blocksize;
+    }
+
+    /*
+     * A memory budget caps the buffers of all workers by lowering the
+     * number of blocks each of them keeps in flight.
+     */
+    requested_queue_depth = queue_depth;
+
+    while (memory_budget > 0 && queue_depth > 1 &&
+           buffer_memory(devices, num_devices, num_workers, queue_depth) >
+           (size_t)memory_budget)
+        queue_depth--;
+
+    memory_needed = buffer_memory(devices, num_devices, num_workers, queue_depth);
+
+    if (memory_budget > 0 && memory_needed > (size_t)memory_budget) {
+        fprintf(stderr, "The memory budget is too small: %u workers per device need "
+                        "at least %zu MB.\n", num_workers, memory_needed / 1024 / 1024);
+        exit(EXIT_FAILURE);
+    }
+
+    if (queue_depth < requested_queue_depth)
+        fprintf(stderr, "The memory budget limits the queue depth to %u.\n", queue_depth);
+
+    if (arena_init(&arena, memory_needed) != ARENA_CHECK_OK) {
+        fprintf(stderr, "%s\n", "No free memory to allocate.");
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(stderr, "I/O buffers: %zu MB in %s\n", arena_size(arena) / 1024 / 1024,
+                    arena_pages_name(arena_pages(arena)));
+    fprintf(stderr, "Verify kernel: %s\n", verify_impl_name());
+
+    /*
+     * Every device gets its own run ID, so data that an HBA or expander
+     * delivers to the wrong disk is reported as coming from another run.
+     * The run ID also seeds the data, so a verify-only run regenerates it
+     * from the ID found on the disk.
+     */
+    run_id = generate_run_id();
+
+    for (unsigned int i = 0; i < num_devices && !verify_only && !resume; i++)
+        devices[i].run_id = run_id + i;
+
+    for (unsigned int i = 0; i < num_devices; i++) {
+        device = &devices[i];
+
+        workers_config.device_name = device->name;
+        workers_config.arena = arena;
+        workers_config.disk_size = device->disk_size;
+        workers_config.num_workers = num_workers;
+        workers_config.blocksize = device->blocksize;
+        workers_config.sector_size = device->sector_size;
+        workers_config.engine = engine;
+        workers_config.queue_depth = queue_depth;
+        workers_config.stream = stream;
+        workers_config.stream_window = non_destructive ? device->batch_size : stream_window;
+        workers_config.chunk_size = resume ? device->journal.chunk_size : chunk_size;
+        /* Zero-fill is used to wipe disks, so those blocks stay all zeros. */
+        workers_config.patterns = patterns;
+        workers_config.tag_sectors = !write_zeros;
+        workers_config.run_id = device->run_id;
+        workers_config.verify_only = verify_only;
+
+        /* A verify-only run checks whatever base data it found on the disk. */
+        if (verify_only) {
+            workers_config.patterns.length = 1;
+            workers_config.patterns.fills[0] = device->data_fill;
+        }
+        workers_config.scan = scan;
+        workers_config.wipe = wipe;
+        workers_config.undo = NULL;
+        workers_config.random = random;
+        workers_config.write_only = false;
+        workers_config.verify_lag = verify_lag;
+        workers_config.verify_flush = verify_flush;
+        workers_config.dsync = dsync;
+        workers_config.flush_interval = flush_interval;
+        workers_config.badmap = &device->badmap;
+        workers_config.retries = retries;
+        workers_config.zone_size = zone_size;
+        workers_config.numa = numa;
+        workers_config.probe = false;
+
+        if (non_destructive) {
+            switch (undo_create(&device->undo, device->undo_path, device->disk_size,
+                                num_workers, device->batch_size)) {
+                case UNDO_CHECK_OK:
+                    break;
+
+                case UNDO_CHECK_ERR_MEM_ALLOC:
+                    fprintf(stderr, "%s\n", "No free memory to allocate.");
+                    cleanup_devices(devices, num_devices);
+                    exit(EXIT_FAILURE);
+
+                default:
+                    fprintf(stderr, "Can't create the undo log %s: %s\n", device->undo_path,
+                                    strerror(errno));
+                    cleanup_devices(devices, num_devices);
+                    exit(EXIT_FAILURE);
+            }
+
+            workers_config.undo = device->undo;
+        }
+
+        switch (init_workers(&device->workers, &workers_config)) {
+            case WORKERS_CHECK_ERR_MEM_ALLOC:
+                fprintf(stderr, "%s\n", "No free memory to allocate.");
+                cleanup_devices(devices, num_devices);
+                exit(EXIT_FAILURE);
+
+            case WORKERS_CHECK_ERR_PTHREAD:
+                fprintf(stderr, "Error initializing workers: %s\n", strerror(pthread_errno));
+                cleanup_devices(devices, num_devices);
+                exit(EXIT_FAILURE);
+
+            default:
+                break;
+        }
+
+        get_workers_chunks(device->workers, &device_chunk_size, &num_chunks);
+
+        /*
+         * The block size comes from the journal, so the chunks only come out
+         * different with a larger -W or once the disk has changed its size.
+         */
+        if (resume && device_chunk_size != device->journal.chunk_size) {
+            fprintf(stderr, "The chunk size of %s would be %lld bytes, but its journal records "
+                            "%lld bytes; -W can't be larger than that on --resume.\n",
+                            device->name, (long long)device_chunk_size,
+                            (long long)device->journal.chunk_size);
+            cleanup_devices(devices, num_devices);
+            exit(EXIT_FAILURE);
+        }
+
+        if (resume && num_chunks != device->journal.num_chunks) {
+            fprintf(stderr, "%s now has %llu chunks, but its journal records %llu; "
+                            "the size of the disk has changed.\n", device->name,
+                            (unsigned long long)num_chunks,
+                            (unsigned long long)device->journal.num_chunks);
+            cleanup_devices(devices, num_devices);
+            exit(EXIT_FAILURE);
+        }
+
+        if (!resume) {
+            device->journal.run_id = device->run_id;
+            device->journal.num_passes = num_passes;
+            device->journal.blocksize = device->blocksize;
+            device->journal.data_pass = device->data_pass;
+            device->journal.verify_only = verify_only;
+            device->journal.scan = scan;
+            device->journal.non_destructive = non_destructive;
+            device->journal.random = random;
+            device->journal.zero_fill = write_zeros;
+            device->journal.patterns = patterns;
+            device->journal.wipe = wipe;
+            device->journal.disk_size = device->disk_size;
+            device->journal.chunk_size = device_chunk_size;
+
+            if (journal_alloc(&device->journal, num_chunks) != JOURNAL_CHECK_OK) {
+                fprintf(stderr, "%s\n", "No free memory to allocate.");
+                cleanup_devices(devices, num_devices);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        if (get_workers_numa_node(device->workers) >= 0)
+            fprintf(stderr, "Workers of %s run on NUMA node %d\n", device->name,
+                            get_workers_numa_node(device->workers));
+
+        if (!write_zeros && !verify_only && !scan && !non_destructive && wipe == DISK_WIPE_NONE) {
+            if (num_devices > 1)
+                fprintf(stderr, "Run ID: %08x: %s\n", device->run_id, device->name);
+            else
+                fprintf(stderr, "Run ID: %08x\n", device->run_id);
+        }
+    }
+
+    show_iops = random || precondition;
+
+    if (json_target != NULL || prom_path != NULL) {
+        switch (telemetry_open(&telemetry, json_target, prom_path, num_devices, num_workers)) {
+            case TELEMETRY_CHECK_OK:
+                break;
+
+            case TELEMETRY_CHECK_ERR_MEM_ALLOC:
+                fprintf(stderr, "%s\n", "No free memory to allocate.");
+                cleanup_devices(devices, num_devices);
+                exit(EXIT_FAILURE);
+
+            default:
+                fprintf(stderr, "Can't open the telemetry target %s: %s\n", json_target,
+                                strerror(errno));
+                cleanup_devices(devices, num_devices);
+                exit(EXIT_FAILURE);
+        }
+
+        /* A collector that goes away must not take the test with it. */
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    signal(SIGINT, handle_sigint);
+
+    start_ns = stats_now_ns();
+
+    do {
+        total_bytes = 0;
+
+        for (unsigned int i = 0; i < num_devices; i++) {
+            device = &devices[i];
+            device->written_bytes_prev = 0;
+            device->verified_bytes_prev = 0;
+            device->write_ops_prev = 0;
+            device->read_ops_prev = 0;
+
+            /* Chunks finished before the run was interrupted are skipped. */
+            device->total_bytes = device->disk_size -
+                                  (resume ? journal_done_bytes(&device->journal) : 0);
+
+            if (!verify_only && !scan && wipe == DISK_WIPE_NONE && !precondition)
+                device->total_bytes *= 2;
+
+            /*
+             * Preconditioning discards the drive, fills it sequentially and
+             * then writes random blocks, none of which are read back. A
+             * drive that can't discard skips the first pass, and one that
+             * has settled sits out the random passes still to come. So does
+             * a device that failed, while the others go on.
+             */
+            device->sat_out = have_workers_failed(device->workers) ||
+                              (precondition && ((pass == 1 && !device->can_discard) ||
+                                                device->settled));
+
+            /*
+             * Its workers keep the counters of the pass they last ran, which
+             * have no part in this one: it shows no progress and no rate.
+             */
+            if (device->sat_out) {
+                device->written_bytes = 0;
+                device->verified_bytes = 0;
+                device->write_rate = 0;
+                device->read_rate = 0;
+                continue;
+            }
+
+            if (precondition) {
+                set_workers_mode(device->workers, (pass == 1) ? DISK_WIPE_DISCARD : DISK_WIPE_NONE,
+                                 pass > num_fills + 1, true);
+            }
+
+            total_bytes += device->total_bytes;
+
+            throttle_workers(device->workers, pass_limit(rate_limits, num_rate_limits, pass),
+                             pass_limit(iops_limits, num_iops_limits, pass));
+
+            if (start_workers(device->workers, verify_only ? device->data_pass : pass,
+                              resume ? device->journal.done : NULL) ==
+                WORKERS_CHECK_ERR_PTHREAD) {
+                fprintf(stderr, "Error starting workers: %s\n", strerror(pthread_errno));
+                stop_workers();
+                exit(EXIT_FAILURE);
+            }
+
+            checkpoint_device(device, pass);
+        }
+
+        resume = false;
+        redraw = false;
+        seconds = 0;
+
+        while (are_devices_running(devices, num_devices)) {
+            /* If SIGINT is received,  wait for all workers to stop. */
+            if (terminate) {
+                sleep(1);
+                continue;
+            }
+
+            print_progress(devices, num_devices, pass, num_passes, total_bytes, redraw);
+            redraw = true;
+
+            /* The first call only starts the rate of the second to come. */
+            if (precondition && pass > num_fills + 1 && seconds > 0)
+                track_steady_state(devices, num_devices);
+
+            if (telemetry != NULL)
+                record_telemetry(telemetry, "progress", devices, num_devices, pass, num_passes,
+                                 num_workers);
+            sleep(1);
+
+            if (++seconds % JOURNAL_INTERVAL == 0) {
+                for (unsigned int i = 0; i < num_devices; i++)
+                    checkpoint_device(&devices[i], pass);
+            }
+        }
+
+        if (telemetry != NULL)
+            record_telemetry(telemetry, "pass", devices, num_devices, pass, num_passes,
+                             num_workers);
+
+        for (unsigned int i = 0; i < num_devices; i++) {
+            device = &devices[i];
+            stats = get_workers_stats(device->workers);
+
+            if (device->sat_out)
+                continue;
+
+            /* Fold this pass into the run totals before the next pass resets the counters. */
+            for (unsigned int j = 0; j < num_workers; j++) {
+                device->run_written_bytes += stats_get(&stats[j].written_bytes);
+                device->run_verified_bytes += stats_get(&stats[j].verified_bytes);
+                device->mismatched_blocks += stats_get(&stats[j].mismatched_blocks);
+                device->mismatched_sectors += stats_get(&stats[j].mismatched_sectors);
+                device->read_errors += stats_get(&stats[j].read_errors);
+                device->write_errors += stats_get(&stats[j].write_errors);
+            }
+
+            /* The map is exported after every pass, so an interrupted run keeps what it found. */
+            export_badmap(device, badmap_format);
+
+            if (zones_dir != NULL)
+                export_zones(device, zones_dir, zones_format, pass, num_workers);
+
+            /*
+             * An interrupted or failed pass keeps its finished chunks for
+             * --resume. A finished pass moves the journal on to the next
+             * one, and a finished run no longer needs it.
+             */
+            get_workers_done(device->workers, device->journal.done);
+
+            if (journal_done_bytes(&device->journal) < device->disk_size) {
+                checkpoint_device(device, pass);
+            } else if (pass < num_passes) {
+                journal_clear(&device->journal);
+                device->journal.pass = pass + 1;
+                save_journal(device);
+            } else {
+                journal_remove(device->journal_path);
+                device->finished = true;
+            }
+
+            if (have_workers_failed(device->workers)) {
+                if (num_devices > 1)
+                    fprintf(stderr, "\nPass %u: %s failed.\n", pass, device->name);
+                continue;
+            }
+
+            pattern_format_fill(pattern_schedule_fill(&patterns, pass), pattern_name,
+                                sizeof(pattern_name));
+            detail[0] = '\0';
+
+            if (precondition)
+                snprintf(detail, sizeof(detail), ", %s", precondition_phase(pass, num_fills));
+            else if (patterns.length > 1)
+                snprintf(detail, sizeof(detail), ", pattern %s", pattern_name);
+
+            if (num_devices > 1)
+                fprintf(stderr, "\nPass %u statistics for %s%s:\n", pass, device->name, detail);
+            else
+                fprintf(stderr, "\nPass %u statistics%s:\n", pass, detail);
+
+            stats_print_latency_report(stderr, stats, num_workers);
+
+            pass_wipe = (precondition && pass == 1) ? DISK_WIPE_DISCARD : wipe;
+
+            if (pass_wipe != DISK_WIPE_NONE)
+                print_wipe_rate(stats, num_workers, pass_wipe);
+        }
+
+        /* Random writes go on, pass after pass, until every device has settled. */
+        if (precondition && pass == num_passes && !are_devices_settled(devices, num_devices))
+            num_passes++;
+
+        pass++;
+    } while (pass <= num_passes && terminate == false && !are_devices_failed(devices, num_devices));
+
+    putchar('\n');
+
+    for (unsigned int i = 0; i < num_devices; i++)
+        close_undo(&devices[i]);
+
+    for (unsigned int i = 0; i < num_devices; i++)
+        print_badmap(&devices[i]);
+
+    for (unsigned int i = 0; i < num_devices && precondition; i++)
+        print_steady_state(&devices[i]);
+
+    if (zones_dir != NULL)
+        fprintf(stderr, "Zone profiles saved in %s\n", zones_dir);
+
+    if (num_devices > 1)
+        print_summary(devices, num_devices, stats_now_ns() - start_ns);
+
+    for (unsigned int i = 0; i < num_devices; i++) {
+        if (!devices[i].finished && !devices[i].journal_failed && !devices[i].ephemeral)
+            fprintf(stderr, "Checkpoint of %s saved to %s, continue with --resume.\n",
+                            devices[i].name, devices[i].journal_path);
+    }
+
+    exit_code = have_devices_failed(devices, num_devices) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    telemetry_close(telemetry);
+    cleanup_devices(devices, num_devices);
+    arena_destroy(arena);
+
+    return exit_code;
+}
+
+/*
+ * Autotune on the first device and give all devices what it found: the
+ * disks of one run are most often the same model. The settings are
+ * printed as options, so the next run of the model can skip the probes.
+ */
+static void tune_devices(device_t *devices, unsigned int num_devices, workers_config_t *config,
+                         unsigned int fixed, size_t memory_limit)
+{
+    device_t *device = &devices[0];
+    autotune_hints_t hints;
+    uint64_t rate;
+    char size[32];
+
+    config->device_name = device->name;
+    config->disk_size = device->disk_size;
+    config->sector_size = device->sector_size;
+
+    if (autotune_hints(device->name, &hints) == AUTOTUNE_CHECK_OK) {
+        format_size(size, sizeof(size), hints.max_io_size);
+        fprintf(stderr, "Queue limits of %s: %s, %u requests, largest I/O %s", device->name,
+                        hints.rotational ? "rotational" : "non-rotational", hints.nr_requests,
+                        size);
+
+        if (hints.optimal_io_size != 0) {
+            format_size(size, sizeof(size), hints.optimal_io_size);
+            fprintf(stderr, ", optimal I/O %s", size);
+        }
+
+        fprintf(stderr, "\n");
+    }
+
+    fprintf(stderr, "Autotuning on the first %ld MB of %s:\n",
+                    (long)((device->disk_size < AUTOTUNE_REGION) ? device->disk_size
+                                                                 : AUTOTUNE_REGION) / 1024 / 1024,
+                    device->name);
+
+    switch (autotune_run(config, &hints, fixed, memory_limit, &rate)) {
+        case AUTOTUNE_CHECK_OK:
+            break;
+
+        case AUTOTUNE_CHECK_ERR_STOPPED:
+            return;
+
+        case AUTOTUNE_CHECK_ERR_MEM_ALLOC:
+            fprintf(stderr, "%s\n", "No free memory to allocate.");
+            exit(EXIT_FAILURE);
+
+        case AUTOTUNE_CHECK_ERR_PTHREAD:
+            fprintf(stderr, "Error starting workers: %s\n", strerror(pthread_errno));
+            exit(EXIT_FAILURE);
+
+        case AUTOTUNE_CHECK_ERR_NO_CANDIDATE:
+            fprintf(stderr, "No block size suits the streaming window, the chunk size and the "
+                            "memory limit of the autotuning.\n");
+            exit(EXIT_FAILURE);
+
+        default:
+            fprintf(stderr, "Autotuning failed: %s can't be tested.\n", device->name);
+            exit(EXIT_FAILURE);
+    }
+
+    /*
+     * A fixed block size is set already, and verify-only disks keep the one
+     * they were written with.
+     */
+    for (unsigned int i = 0; i < num_devices && !(fixed & AUTOTUNE_FIXED_BLOCKSIZE); i++) {
+        if (config->blocksize % devices[i].sector_size == 0)
+            devices[i].blocksize = config->blocksize;
+    }
+
+    if (num_devices > 1)
+        fprintf(stderr, "The settings of %s are used for all %u devices.\n", device->name,
+                        num_devices);
+
+    format_size(size, sizeof(size), config->blocksize);
+    fprintf(stderr, "Autotuned: -b %s -w %u -q %u (%llu MB/s)\n", size, config->num_workers,
+                    config->queue_depth, (unsigned long long)(rate / 1024 / 1024));
+}
+
+/*
+ * Check that the device can be tested and find out its geometry. For a
+ * verify-only run the block size, run ID and pass come from the first block.
+ */
+static void probe_device(device_t *device, unsigned int blocksize, bool blocksize_set,
+                         bool verify_only)
+{
+    const char *device_name = device->name;
+    block_header_t header;
+    char *sector = NULL;
+    char pattern_name[16];
+
+    switch (disk_device_check(device_name)) {
+        case DISKDEV_CHECK_ERR_STAT:
+            fprintf(stderr, "Can't access device: %s: %s\n", device_name, strerror(errno));
+            exit(EXIT_FAILURE);
+
+        case DISKDEV_CHECK_ERR_NOT_DISK:
+            fprintf(stderr, "Error: %s is not a disk device or a regular file.\n", device_name);
+            exit(EXIT_FAILURE);
+
+        case DISKDEV_CHECK_ERR_SIZE:
+            fprintf(stderr, "Invalid size of the virtual disk: %s\n", device_name);
+            exit(EXIT_FAILURE);
+
+        default:
+            break;
+    }
+
+    /* The data of a virtual disk is gone with the run that wrote it. */
+    device->ephemeral = is_virtual_disk(device_name);
+
+    if (device->ephemeral && verify_only) {
+        fprintf(stderr, "%s keeps no data from an earlier run to verify.\n", device_name);
+        exit(EXIT_FAILURE);
+    }
+
+    switch (get_disk_sector_size(device_name, &device->sector_size)) {
+        case DISKDEV_CHECK_ERR_OPEN:
+            fprintf(stderr, "Can't open device: %s: %s\n", device_name,
+                            strerror(errno));
+            exit(EXIT_FAILURE);
+
+        case DISKDEV_CHECK_ERR_IOCTL:
+            fprintf(stderr, "Can't get sector size of the device: %s: %s\n", device_name,
+                            strerror(errno));
+            exit(EXIT_FAILURE);
+
+        default:
+            break;
+
+    }
+
+    /* The first block tells how the disk was written. */
+    if (verify_only) {
+        if ((sector = malloc(device->sector_size)) == NULL) {
+            fprintf(stderr, "%s\n", "No free memory to allocate.");
+            exit(EXIT_FAILURE);
+        }
+
+        switch (read_disk_sector(device_name, 0, sector, device->sector_size)) {
+            case DISKDEV_CHECK_OK:
+                break;
+
+            case DISKDEV_CHECK_ERR_MEM_ALLOC:
+                fprintf(stderr, "%s\n", "No free memory to allocate.");
+                exit(EXIT_FAILURE);
+
+            default:
+                fprintf(stderr, "Can't read the first sector of the device: %s: %s\n",
+                                device_name, strerror(errno));
+                exit(EXIT_FAILURE);
+        }
+
+        if (!pattern_parse_header(sector, &header) || header.offset != 0 ||
+            header.blocksize < device->sector_size || header.blocksize % device->sector_size != 0) {
+            fprintf(stderr, "No %s block header found at the start of %s.\n", PROGNAME,
+                            device_name);
+            exit(EXIT_FAILURE);
+        }
+
+        device->data_fill = pattern_detect_fill(sector, device->sector_size);
+        free(sector);
+
+        if (blocksize_set && blocksize != header.blocksize) {
+            fprintf(stderr, "%s was written with a block size of %u bytes.\n", device_name,
+                            header.blocksize);
+            exit(EXIT_FAILURE);
+        }
+
+        blocksize = header.blocksize;
+        device->run_id = header.seed;
+        device->data_pass = header.pass;
+        pattern_format_fill(device->data_fill, pattern_name, sizeof(pattern_name));
+
+        fprintf(stderr, "Verifying %s: run ID: %08x, pass: %u, block size: %u, pattern: %s\n",
+                        device_name, device->run_id, device->data_pass, blocksize, pattern_name);
+    }
+
+    if (blocksize < device->sector_size) {
+        fprintf(stderr, "The block size can't be less than the sector size of %s (%u).\n",
+                        device_name, device->sector_size);
+        exit(EXIT_FAILURE);
+    }
+
+    device->blocksize = blocksize;
+
+    switch (get_disk_size(device_name, &device->disk_size)) {
+        case DISKDEV_CHECK_ERR_OPEN:
+            fprintf(stderr, "Can't open device: %s: %s\n", device_name,
+                            strerror(errno));
+            exit(EXIT_FAILURE);
+
+        case DISKDEV_CHECK_ERR_LSEEK:
+            fprintf(stderr, "Can't get disk size from the device: %s: %s\n", device_name,
+                            strerror(errno));
+            exit(EXIT_FAILURE);
+
+        default:
+            break;
+    }
+}
+
+/*
+ * Pick up the journal of an interrupted run. A pass whose chunks were all
+ * finished before the interruption counts as done.
+ */
+static void resume_device(device_t *device, const char *journal_dir)
+{
+    journal_t *journal = &device->journal;
+
+    switch (journal_load(device->journal_path, journal)) {
+        case JOURNAL_CHECK_OK:
+            break;
+
+        case JOURNAL_CHECK_ERR_NOT_FOUND:
+            fprintf(stderr, "No checkpoint journal of %s found in %s.\n", device->name,
+                            journal_dir);
+            exit(EXIT_FAILURE);
+
+        case JOURNAL_CHECK_ERR_MEM_ALLOC:
+            fprintf(stderr, "%s\n", "No free memory to allocate.");
+            exit(EXIT_FAILURE);
+
+        case JOURNAL_CHECK_ERR_CORRUPT:
+            fprintf(stderr, "The checkpoint journal %s is damaged.\n", device->journal_path);
+            exit(EXIT_FAILURE);
+
+        default:
+            fprintf(stderr, "Can't read the checkpoint journal %s: %s\n", device->journal_path,
+                            strerror(errno));
+            exit(EXIT_FAILURE);
+    }
+
+    if (journal_done_bytes(journal) == journal->disk_size) {
+        journal_clear(journal);
+        journal->pass++;
+    }
+
+    if (journal->pass > journal->num_passes) {
+        fprintf(stderr, "The run recorded in %s is already complete.\n", device->journal_path);
+        exit(EXIT_FAILURE);
+    }
+
+    device->run_id = journal->run_id;
+    device->data_pass = journal->data_pass;
+
+    fprintf(stderr, "Resuming %s: run ID: %08x, pass: %u/%u, %ld MB already done\n",
+                    device->name, device->run_id, journal->pass, journal->num_passes,
+                    (long)(journal_done_bytes(journal) / 1024 / 1024));
+}
+
+/*
+ * Make sure the disk still holds the resumed run, e.g. that it was not
+ * renamed on reboot. Once its first chunk has been written, the first
+ * block must carry the run ID; before that there is nothing to go by.
+ */
+static void check_resumed_data(device_t *device)
+{
+    journal_t *journal = &device->journal;
+    block_header_t header;
+    char *sector;
+    off_t offset = 0;
+
+    if (journal->zero_fill || journal->verify_only || journal->scan || journal->non_destructive ||
+        journal->wipe != DISK_WIPE_NONE || (journal->pass == 1 && (journal->done[0] & 1) == 0))
+        return;
+
+    if ((sector = malloc(device->sector_size)) == NULL) {
+        fprintf(stderr, "%s\n", "No free memory to allocate.");
+        exit(EXIT_FAILURE);
+    }
+
+    /* A random pass starts somewhere else on the disk. */
+    if (journal->random)
+        offset = random_block_offset(journal->disk_size, journal->blocksize, journal->run_id,
+                                     journal->pass, 0);
+
+    if (read_disk_sector(device->name, offset, sector, device->sector_size) != DISKDEV_CHECK_OK) {
+        fprintf(stderr, "Can't read the first block of the pass on the device: %s: %s\n",
+                        device->name, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (!pattern_parse_header(sector, &header) || header.seed != journal->run_id) {
+        fprintf(stderr, "%s does not hold the data of run %08x recorded in %s.\n", device->name,
+                        journal->run_id, device->journal_path);
+        exit(EXIT_FAILURE);
+    }
+
+    free(sector);
+}
+
+/*
+ * An undo log left behind by a crashed non-destructive run still holds
+ * the original data of the batches that were being tested. It goes back
+ * onto the disk before anything else touches it.
+ */
+static void restore_device(device_t *device)
+{
+    unsigned int num_restored;
+
+    switch (undo_replay(device->undo_path, device->name, device->disk_size, &num_restored)) {
+        case UNDO_CHECK_OK:
+            if (num_restored > 0)
+                fprintf(stderr, "Restored the original data of %u batches of %s from %s.\n",
+                                num_restored, device->name, device->undo_path);
+            break;
+
+        case UNDO_CHECK_ERR_NOT_FOUND:
+            break;
+
+        case UNDO_CHECK_ERR_MEM_ALLOC:
+            fprintf(stderr, "%s\n", "No free memory to allocate.");
+            exit(EXIT_FAILURE);
+
+        case UNDO_CHECK_ERR_CORRUPT:
+            fprintf(stderr, "The undo log %s is damaged or doesn't belong to %s.\n",
+                            device->undo_path, device->name);
+            exit(EXIT_FAILURE);
+
+        default:
+            fprintf(stderr, "Can't restore %s from the undo log %s: %s\n", device->name,
+                            device->undo_path, strerror(errno));
+            exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * Workers clear their undo slot after every batch they put back, so a
+ * slot still in use belongs to a worker that failed halfway through a
+ * batch. Its original data is written back here, or kept in the log for
+ * the next run if the disk doesn't take it.
+ */
+static void close_undo(device_t *device)
+{
+    unsigned int num_restored;
+
+    if (device->undo == NULL)
+        return;
+
+    undo_close(device->undo);
+    device->undo = NULL;
+
+    if (undo_replay(device->undo_path, device->name, device->disk_size, &num_restored) !=
+        UNDO_CHECK_OK) {
+        fprintf(stderr, "Can't restore all original data of %s: it is kept in %s and put back "
+                        "when " PROGNAME " runs on the disk again.\n", device->name,
+                        device->undo_path);
+        return;
+    }
+
+    if (num_restored > 0)
+        fprintf(stderr, "Restored the original data of %u unfinished batches of %s.\n",
+                        num_restored, device->name);
+}
+
+/* Record the chunks finished so far in the given pass. */
+static void checkpoint_device(device_t *device, unsigned int pass)
+{
+    device->journal.pass = pass;
+    get_workers_done(device->workers, device->journal.done);
+    save_journal(device);
+}
+
+/* A journal that can't be saved doesn't stop the test; it is reported once. */
+static void save_journal(device_t *device)
+{
+    if (device->ephemeral)
+        return;
+
+    if (journal_save(device->journal_path, &device->journal) == JOURNAL_CHECK_OK ||
+        device->journal_failed)
+        return;
+
+    device->journal_failed = true;
+    fprintf(stderr, "\nCan't save the checkpoint journal %s: %s\n", device->journal_path,
+                    strerror(errno));
+}
+
+/* Like the journal, a map that can't be exported doesn't stop the test. */
+static void export_badmap(device_t *device, badmap_format_t format)
+{
+    if (device->badmap_path == NULL ||
+        badmap_export(&device->badmap, device->badmap_path, format, device->name,
+                      device->sector_size) == BADMAP_CHECK_OK ||
+        device->badmap_failed)
+        return;
+
+    device->badmap_failed = true;
+    fprintf(stderr, "\nCan't export the bad sectors to %s: %s\n", device->badmap_path,
+                    strerror(errno));
+}
+
+static void print_badmap(device_t *device)
+{
+    uint64_t bad_bytes;
+    size_t num_ranges;
+
+    badmap_get(&device->badmap, &bad_bytes, &num_ranges);
+
+    if (bad_bytes > 0)
+        fprintf(stderr, "%s: %llu bad sectors in %zu range%s\n", device->name,
+                        (unsigned long long)(bad_bytes / device->sector_size), num_ranges,
+                        (num_ranges == 1) ? "" : "s");
+
+    if (device->badmap_path != NULL && !device->badmap_failed)
+        fprintf(stderr, "Bad sectors of %s exported to %s\n", device->name, device->badmap_path);
+}
+
+/* One profile per pass, e.g. diskroaster-sdd.pass2.zones.csv, so passes can be compared. */
+static void export_zones(device_t *device, const char *dir, zones_format_t format,
+                         unsigned int pass, unsigned int num_workers)
+{
+    char suffix[64];
+    char *path;
+
+    snprintf(suffix, sizeof(suffix), ".pass%u%s", pass, zones_suffix(format));
+
+    if ((path = journal_path(dir, device->name, suffix)) == NULL) {
+        fprintf(stderr, "%s\n", "No free memory to allocate.");
+        return;
+    }
+
+    if (zones_export(get_workers_zones(device->workers), path, format, device->name, pass,
+                     num_workers) != ZONES_CHECK_OK)
+        fprintf(stderr, "\nCan't export the zone profile to %s: %s\n", path, strerror(errno));
+
+    free(path);
+}
+
+/*
+ * A limit, or a comma-separated list of limits for pass 1, 2 and so on.
+ * Rates are sizes per second with the usual suffixes, and 0 lifts the
+ * limit for a pass.
+ */
+static void parse_limits(const char *arg, bool sizes, uint64_t *limits, unsigned int *num_limits)
+{
+    char *list;
+    char *item;
+    char *save;
+    off_t size;
+    unsigned int count;
+    utils_check_t result;
+
+    if ((list = strdup(arg)) == NULL) {
+        fprintf(stderr, "%s\n", "No free memory to allocate.");
+        exit(EXIT_FAILURE);
+    }
+
+    *num_limits = 0;
+
+    for (item = strtok_r(list, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+        if (*num_limits == MAX_PASS_LIMITS) {
+            fprintf(stderr, "At most %d limits can be given, one per pass.\n", MAX_PASS_LIMITS);
+            exit(EXIT_FAILURE);
+        }
+
+        if (strcmp(item, "0") == 0) {
+            limits[(*num_limits)++] = 0;
+            continue;
+        }
+
+        if (sizes) {
+            result = get_large_size_in_bytes(item, &size);
+            limits[*num_limits] = (uint64_t)size;
+        } else {
+            result = str_to_uint(item, &count);
+            limits[*num_limits] = count;
+        }
+
+        if (result == UTILS_CHECK_ERR_UNKNOWN_UNIT) {
+            fprintf(stderr, "Unknown unit suffix set in rate limit: %s\n", item);
+            exit(EXIT_FAILURE);
+        } else if (result != UTILS_CHECK_OK) {
+            fprintf(stderr, "Invalid %s limit: %s\n", sizes ? "rate" : "IOPS", item);
+            exit(EXIT_FAILURE);
+        }
+
+        (*num_limits)++;
+    }
+
+    free(list);
+
+    if (*num_limits == 0) {
+        fprintf(stderr, "Invalid %s limit: %s\n", sizes ? "rate" : "IOPS", arg);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* The limit of a pass: its own entry of the list, or the last one. 0 without a list. */
+static uint64_t pass_limit(const uint64_t *limits, unsigned int num_limits, unsigned int pass)
+{
+    if (num_limits == 0)
+        return 0;
+
+    return limits[(pass <= num_limits) ? pass - 1 : num_limits - 1];
+}
+
+/*
+ * Hand the progress of every device to the telemetry sinks. The error
+ * totals of the run so far include the pass in progress.
+ */
+static void record_telemetry(telemetry_t *telemetry, const char *type, device_t *devices,
+                             unsigned int num_devices, unsigned int pass, unsigned int num_passes,
+                             unsigned int num_workers)
+{
+    telemetry_device_t *records;
+    telemetry_device_t *record;
+    device_t *device;
+    worker_stats_t *stats;
+    uint64_t bad_bytes;
+    size_t num_ranges;
+
+    if ((records = calloc(num_devices, sizeof(telemetry_device_t))) == NULL)
+        return;
+
+    for (unsigned int i = 0; i < num_devices; i++) {
+        device = &devices[i];
+        record = &records[i];
+        stats = get_workers_stats(device->workers);
+
+        record->name = device->name;
+        record->run_id = device->run_id;
+        record->pass = pass;
+        record->num_passes = num_passes;
+        record->total_bytes = device->total_bytes;
+        record->write_rate = device->write_rate;
+        record->read_rate = device->read_rate;
+        record->mismatched_blocks = device->mismatched_blocks;
+        record->read_errors = device->read_errors;
+        record->write_errors = device->write_errors;
+        record->failed = have_workers_failed(device->workers);
+        record->stats = stats;
+
+        /* The counters of a device that sits out the pass were folded in already. */
+        if (!device->sat_out)
+            get_workers_progress(device->workers, &record->written_bytes,
+                                 &record->verified_bytes);
+
+        for (unsigned int j = 0; j < num_workers && !device->sat_out; j++) {
+            record->mismatched_blocks += stats_get(&stats[j].mismatched_blocks);
+            record->read_errors += stats_get(&stats[j].read_errors);
+            record->write_errors += stats_get(&stats[j].write_errors);
+        }
+
+        badmap_get(&device->badmap, &bad_bytes, &num_ranges);
+        record->bad_sectors = bad_bytes / device->sector_size;
+    }
+
+    telemetry_record(telemetry, type, records, num_devices);
+    free(records);
+}
+
+/* Size of the buffer arena: a region with the slot and save buffers of every device's workers. */
+static size_t buffer_memory(device_t *devices, unsigned int num_devices, unsigned int num_workers,
+                            unsigned int queue_depth)
+{
+    size_t memory = 0;
+
+    for (unsigned int i = 0; i < num_devices; i++)
+        memory += workers_buffer_size(num_workers, queue_depth, devices[i].blocksize,
+                                      devices[i].batch_size);
+
+    return memory;
+}
+
+static bool are_devices_running(device_t *devices, unsigned int num_devices)
+{
+    for (unsigned int i = 0; i < num_devices; i++) {
+        if (are_workers_running(devices[i].workers))
+            return true;
+    }
+
+    return false;
+}
+
+static bool have_devices_failed(device_t *devices, unsigned int num_devices)
+{
+    for (unsigned int i = 0; i < num_devices; i++) {
+        if (have_workers_failed(devices[i].workers))
+            return true;
+    }
+
+    return false;
+}
+
+/* The run goes on for as long as one of the devices is still being tested. */
+static bool are_devices_failed(device_t *devices, unsigned int num_devices)
+{
+    for (unsigned int i = 0; i < num_devices; i++) {
+        if (!have_workers_failed(devices[i].workers))
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * A single device keeps the classic one-line progress. Several devices get
+ * one line each plus a total line, redrawn in place every second, so a
+ * throughput ceiling shared by all disks (the HBA or the PCIe link) shows
+ * up right away.
+ */
+static void print_progress(device_t *devices, unsigned int num_devices, unsigned int pass,
+                           unsigned int num_passes, off_t total_bytes, bool redraw)
+{
+    device_t *device;
+    char eta[9];
+    char write_rate[48];
+    char read_rate[48];
+    off_t written_bytes = 0;
+    off_t verified_bytes = 0;
+    off_t written_bytes_prev = 0;
+    off_t verified_bytes_prev = 0;
+    uint64_t write_ops;
+    uint64_t read_ops;
+    uint64_t write_ops_second = 0;
+    uint64_t read_ops_second = 0;
+    off_t rate;
+
+    if (redraw && num_devices > 1)
+        fprintf(stderr, "\033[%uA", num_devices + 1);
+
+    for (unsigned int i = 0; i < num_devices; i++) {
+        device = &devices[i];
+
+        /* A device that sits out the pass is left out of the total. */
+        if (device->sat_out) {
+            if (num_devices > 1)
+                fprintf(stderr, "\033[2K%-16s %s\n", device->name,
+                                have_workers_failed(device->workers) ? "FAILED" : "idle");
+            continue;
+        }
+
+        written_bytes_prev += device->written_bytes_prev;
+        verified_bytes_prev += device->verified_bytes_prev;
+
+        get_workers_progress(device->workers, &device->written_bytes, &device->verified_bytes);
+        get_workers_ops(device->workers, &write_ops, &read_ops);
+
+        rate = (device->written_bytes - device->written_bytes_prev) +
+               (device->verified_bytes - device->verified_bytes_prev);
+
+        if (rate > device->peak_rate)
+            device->peak_rate = rate;
+
+        device->write_rate = device->written_bytes - device->written_bytes_prev;
+        device->read_rate = device->verified_bytes - device->verified_bytes_prev;
+
+        format_rate(write_rate, sizeof(write_rate),
+                    device->written_bytes - device->written_bytes_prev,
+                    write_ops - device->write_ops_prev);
+        format_rate(read_rate, sizeof(read_rate),
+                    device->verified_bytes - device->verified_bytes_prev,
+                    read_ops - device->read_ops_prev);
+
+        if (num_devices > 1)
+            fprintf(stderr, "\033[2K%-16s written: %ld MB (%s), "
+                            "verified: %ld MB (%s), completed: %ld%%%s\n",
+                            device->name,
+                            (device->written_bytes / 1024 / 1024),
+                            write_rate,
+                            (device->verified_bytes / 1024 / 1024),
+                            read_rate,
+                            ((device->written_bytes + device->verified_bytes) * 100) /
+                            device->total_bytes,
+                            have_workers_failed(device->workers) ? ", FAILED" : "");
+
+        written_bytes += device->written_bytes;
+        verified_bytes += device->verified_bytes;
+        write_ops_second += write_ops - device->write_ops_prev;
+        read_ops_second += read_ops - device->read_ops_prev;
+        device->written_bytes_prev = device->written_bytes;
+        device->verified_bytes_prev = device->verified_bytes;
+        device->write_ops_prev = write_ops;
+        device->read_ops_prev = read_ops;
+    }
+
+    rate = (written_bytes - written_bytes_prev) + (verified_bytes - verified_bytes_prev);
+
+    if (rate > peak_rate)
+        peak_rate = rate;
+
+    /* A pass is done when every byte has been both written and verified. */
+    get_eta(eta, written_bytes + verified_bytes, total_bytes);
+
+    format_rate(write_rate, sizeof(write_rate), written_bytes - written_bytes_prev,
+                write_ops_second);
+    format_rate(read_rate, sizeof(read_rate), verified_bytes - verified_bytes_prev,
+                read_ops_second);
+
+    fprintf(stderr, "\033[2K\rpass: %d/%d, %swritten: %ld MB (%s), "
+                    "verified: %ld MB (%s), completed: %ld%%, ETA: %s%s",
+                    pass,
+                    num_passes,
+                    (num_devices > 1) ? "total " : "",
+                    (written_bytes / 1024 / 1024),
+                    write_rate,
+                    (verified_bytes / 1024 / 1024),
+                    read_rate,
+                    ((written_bytes + verified_bytes) * 100) / total_bytes,
+                    eta,
+                    (num_devices > 1) ? "\n" : "\r");
+}
+
+/* Throughput over the last second, with the operations in random mode. */
+static void format_rate(char *buffer, size_t size, off_t bytes, uint64_t ops)
+{
+    if (show_iops)
+        snprintf(buffer, size, "%ld MB/s, %llu IOPS", bytes / 1024 / 1024,
+                 (unsigned long long)ops);
+    else
+        snprintf(buffer, size, "%ld MB/s", bytes / 1024 / 1024);
+}
+
+/* Per-device totals over all passes, plus the aggregate throughput of the whole run. */
+static void print_summary(device_t *devices, unsigned int num_devices, uint64_t elapsed_ns)
+{
+    device_t *device;
+    off_t written_bytes = 0;
+    off_t verified_bytes = 0;
+    uint64_t mismatched_blocks = 0;
+    uint64_t io_errors = 0;
+    uint64_t bad_sectors = 0;
+    uint64_t device_bad_bytes;
+    size_t num_ranges;
+    double elapsed_secs = elapsed_ns / 1e9;
+
+    fprintf(stderr, "\nSummary:\n");
+    fprintf(stderr, "%-16s %12s %12s %14s %12s %12s %12s %8s\n", "device", "written, MB",
+                    "verified, MB", "peak, MB/s", "mismatches", "I/O errors", "bad sectors",
+                    "status");
+
+    for (unsigned int i = 0; i < num_devices; i++) {
+        device = &devices[i];
+        badmap_get(&device->badmap, &device_bad_bytes, &num_ranges);
+
+        fprintf(stderr, "%-16s %12ld %12ld %14ld %12llu %12llu %12llu %8s\n",
+                        device->name,
+                        device->run_written_bytes / 1024 / 1024,
+                        device->run_verified_bytes / 1024 / 1024,
+                        device->peak_rate / 1024 / 1024,
+                        (unsigned long long)device->mismatched_blocks,
+                        (unsigned long long)(device->read_errors + device->write_errors),
+                        (unsigned long long)(device_bad_bytes / device->sector_size),
+                        have_workers_failed(device->workers) ? "FAILED" :
+                        (device->mismatched_blocks > 0 || device->read_errors > 0 ||
+                         device->write_errors > 0) ? "BAD" : "OK");
+
+        written_bytes += device->run_written_bytes;
+        verified_bytes += device->run_verified_bytes;
+        mismatched_blocks += device->mismatched_blocks;
+        io_errors += device->read_errors + device->write_errors;
+        bad_sectors += device_bad_bytes / device->sector_size;
+    }
+
+    fprintf(stderr, "%-16s %12ld %12ld %14ld %12llu %12llu %12llu\n", "total",
+                    written_bytes / 1024 / 1024, verified_bytes / 1024 / 1024,
+                    peak_rate / 1024 / 1024, (unsigned long long)mismatched_blocks,
+                    (unsigned long long)io_errors, (unsigned long long)bad_sectors);
+
+    if (elapsed_secs > 0)
+        fprintf(stderr, "aggregate throughput: %.0f MB/s average, %ld MB/s peak\n",
+                        (written_bytes + verified_bytes) / 1024.0 / 1024.0 / elapsed_secs,
+                        peak_rate / 1024 / 1024);
+}
+
+/* What the wipe of a pass achieved, over the time of the slowest worker. */
+static void print_wipe_rate(worker_stats_t *stats, unsigned int num_workers, disk_wipe_t wipe)
+{
+    uint64_t bytes = 0;
+    uint64_t busy_ns = 0;
+
+    for (unsigned int i = 0; i < num_workers; i++) {
+        bytes += stats_get(&stats[i].written_bytes);
+
+        if (stats_get(&stats[i].busy_ns) > busy_ns)
+            busy_ns = stats_get(&stats[i].busy_ns);
+    }
+
+    if (busy_ns == 0)
+        return;
+
+    fprintf(stderr, "wipe (%s): %llu MB in %.2f s, %.0f MB/s\n", disk_wipe_name(wipe),
+                    (unsigned long long)(bytes / 1024 / 1024), busy_ns / 1e9,
+                    bytes / 1024.0 / 1024.0 / (busy_ns / 1e9));
+}
+
+/*
+ * Whether the device takes a discard or another wipe, tried on its first
+ * sector. A null disk has nothing to wipe and takes it all the same.
+ */
+static bool probe_wipe(device_t *device, disk_wipe_t wipe)
+{
+    bool result;
+    int errnum;
+    int fd;
+
+    if (open_disk(device->name, O_RDWR, &fd) != DISKDEV_CHECK_OK)
+        return false;
+
+    if (fd == -1)
+        return true;
+
+    result = disk_wipe_range(fd, wipe, 0, device->sector_size) == DISKDEV_CHECK_OK;
+    errnum = errno;
+    close(fd);
+    errno = errnum;
+
+    return result;
+}
+
+static const char *precondition_phase(unsigned int pass, unsigned int num_fills)
+{
+    if (pass == 1)
+        return "discard";
+
+    return (pass <= num_fills + 1) ? "sequential fill" : "random write";
+}
+
+/*
+ * Feed the write rate of the last second into the steady-state window of
+ * every device in its random-write phase. A device is halted as soon as
+ * its window is steady, or once it has used up its rounds.
+ */
+static void track_steady_state(device_t *devices, unsigned int num_devices)
+{
+    device_t *device;
+    steady_window_t window;
+
+    for (unsigned int i = 0; i < num_devices; i++) {
+        device = &devices[i];
+
+        /* Seconds after the last write of a pass are the workers winding down. */
+        if (device->sat_out || device->settled ||
+            device->written_bytes - device->write_rate >= device->total_bytes)
+            continue;
+
+        if (!steady_add(&device->steady, (double)device->write_rate))
+            continue;
+
+        if ((steady_measure(&device->steady, &window) && window.steady) ||
+            device->steady.num_rounds == STEADY_MAX_ROUNDS) {
+            device->settled = true;
+            halt_workers(device->workers);
+        }
+    }
+}
+
+/* A failed device won't settle; it sits out the passes still to come. */
+static bool are_devices_settled(device_t *devices, unsigned int num_devices)
+{
+    for (unsigned int i = 0; i < num_devices; i++) {
+        if (!devices[i].settled && !have_workers_failed(devices[i].workers))
+            return false;
+    }
+
+    return true;
+}
+
+static void print_steady_state(device_t *device)
+{
+    steady_window_t window;
+
+    if (!steady_measure(&device->steady, &window)) {
+        fprintf(stderr, "%s: %u of %d rounds of random writes, too few to judge steady state.\n",
+                        device->name, device->steady.num_rounds, STEADY_WINDOW);
+        return;
+    }
+
+    fprintf(stderr, "%s %s after %u rounds: %.0f MB/s, %.0f IOPS "
+                    "(range %.1f%%, slope %.1f%% of the average)\n",
+                    device->name, window.steady ? "reached steady state"
+                                                : "did not reach steady state",
+                    device->steady.num_rounds, window.average / 1024 / 1024,
+                    window.average / device->blocksize, window.range * 100,
+                    window.slope * 100);
+}
+
+static void cleanup_devices(device_t *devices, unsigned int num_devices)
+{
+    for (unsigned int i = 0; i < num_devices; i++) {
+        cleanup_workers(devices[i].workers);
+        journal_free(&devices[i].journal);
+        free(devices[i].journal_path);
+        undo_close(devices[i].undo);
+        free(devices[i].undo_path);
+        badmap_destroy(&devices[i].badmap);
+        free(devices[i].badmap_path);
+    }
+
+    free(devices);
+}
@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+#include "crc32c.h"
+#include "pattern.h"
+#include "verify.h"
+
+/*
+ * Internal functions' prototypes
+ */
+
+static inline bool check_sector_tag(const char*, uint64_t, uint32_t, uint32_t);
+static bool check_block_fast(const pattern_t*, const char*, size_t, uint64_t);
+static bool check_sector_data(const pattern_t*, verify_stream_t*, const char*, size_t, uint64_t*);
+static void add_bad_sector(block_check_t*, uint64_t, bool);
+static uint32_t block_crc(const char*, size_t);
+static void stamp_block_header(const pattern_t*, char*, size_t, off_t);
+static bool check_block_header(const pattern_t*, const char*, size_t, off_t, block_check_t*);
+
+void pattern_fill_block(const pattern_t *pattern, char *buffer, size_t len, off_t offset)
+{
+    verify_stream_t stream;
+
+    if (pattern->data == PATTERN_DATA_BYTE) {
+        memset(buffer, pattern->fill, len);
+    } else {
+        verify_stream_init(&stream, pattern->run_id);
+        verify_stream_fill(&stream, buffer, len);
+    }
+
+    pattern_stamp_block(pattern, buffer, len, offset);
+}
+
+void pattern_stamp_block(const pattern_t *pattern, char *buffer, size_t len, off_t offset)
+{
+    uint64_t lba = (uint64_t)offset / pattern->sector_size;
+    size_t sector_size = pattern->sector_size;
+
+    if (!pattern->tagged)
+        return;
+
+#if defined(__SSE2__)
+    /*
+     * A tag is exactly two SSE2 vectors. Both are built once and advanced
+     * by one LBA per sector, so stamping costs two stores per sector.
+     */
+    __m128i head = _mm_set_epi64x((long long)lba, (long long)SECTOR_TAG_MAGIC);
+    __m128i tail = _mm_set_epi64x((long long)~lba,
+                                  (long long)(((uint64_t)pattern->run_id << 32) | pattern->pass));
+    const __m128i lba_step = _mm_set_epi64x(1, 0);
+
+    for (size_t pos = 0; pos + SECTOR_TAG_SIZE <= len; pos += sector_size) {
+        _mm_storeu_si128((__m128i*)(buffer + pos), head);
+        _mm_storeu_si128((__m128i*)(buffer + pos + 16), tail);
+        head = _mm_add_epi64(head, lba_step);
+        tail = _mm_sub_epi64(tail, lba_step);
+    }
+#else
+    sector_tag_t tag;
+
+    tag.magic = SECTOR_TAG_MAGIC;
+    tag.pass = pattern->pass;
+    tag.run_id = pattern->run_id;
+
+    for (size_t pos = 0; pos + SECTOR_TAG_SIZE <= len; pos += sector_size, lba++) {
+        tag.lba = lba;
+        tag.lba_inv = ~lba;
+        memcpy(buffer + pos, &tag, SECTOR_TAG_SIZE);
+    }
+#endif
+
+    stamp_block_header(pattern, buffer, len, offset);
+}
+
+bool pattern_check_block(
+    const pattern_t *pattern,
+    const char *buffer,
+    size_t len,
+    off_t offset,
+    block_check_t *check
+) {
+    uint64_t lba = (uint64_t)offset / pattern->sector_size;
+    size_t sector_size = pattern->sector_size;
+    size_t skip;
+    verify_stream_t stream;
+    sector_tag_t found;
+    bool sector_ok;
+    bool prev_bad = false;
+
+    memset(check, 0, sizeof(block_check_t));
+
+    /*
+     * A good block is verified in a single pass of the compare kernel. Only
+     * a block that fails it is walked again sector by sector to find out
+     * which sectors are bad and how many bits flipped.
+     */
+    if (!check_block_fast(pattern, buffer, len, lba)) {
+        verify_stream_init(&stream, pattern->run_id);
+
+        for (size_t pos = 0; pos < len; pos += sector_size, lba++) {
+
+            /* The block header in the first sector is checked separately below. */
+            skip = !pattern->tagged ? 0 : (pos == 0) ? BLOCK_HEADER_OFFSET + BLOCK_HEADER_SIZE
+                                                     : SECTOR_TAG_SIZE;
+
+            sector_ok = check_sector_data(pattern, &stream, buffer + pos, skip,
+                                          &check->bit_flips) &&
+                        (!pattern->tagged ||
+                         check_sector_tag(buffer + pos, lba, pattern->pass, pattern->run_id));
+
+            if (sector_ok) {
+                prev_bad = false;
+                continue;
+            }
+
+            /* Remember what the first bad sector actually holds. */
+            if (check->bad_sectors == 0) {
+                check->expected_lba = lba;
+
+                if (pattern->tagged) {
+                    memcpy(&found, buffer + pos, sizeof(found));
+                    check->found_tag = (found.magic == SECTOR_TAG_MAGIC &&
+                                        found.lba_inv == ~found.lba);
+                    check->found = found;
+                }
+            }
+
+            add_bad_sector(check, lba, prev_bad);
+            prev_bad = true;
+        }
+    }
+
+    if (pattern->tagged)
+        check_block_header(pattern, buffer, len, offset, check);
+
+    return check->bad_sectors == 0 && !check->bad_header && !check->bad_crc;
+}
+
+void pattern_describe_mismatch(
+    const pattern_t *pattern,
+    const block_check_t *check,
+    char *message,
+    size_t size
+) {
+    const sector_tag_t *found = &check->found;
+
+    if (check->bad_sectors == 0) {
+        if (check->bad_header)
+            snprintf(message, size, "block header does not match its location");
+        else
+            snprintf(message, size, "checksum mismatch, block payload is corrupted");
+    } else if (!check->found_tag) {
+        snprintf(message, size, "data mismatch at LBA %" PRIu64 " (%u bad sectors)",
+                 check->expected_lba, check->bad_sectors);
+    } else if (found->lba != check->expected_lba) {
+        snprintf(message, size, "expected LBA %" PRIu64 ", found data for LBA %" PRIu64
+                 " (%u bad sectors)", check->expected_lba, found->lba, check->bad_sectors);
+    } else if (found->run_id != pattern->run_id) {
+        snprintf(message, size, "LBA %" PRIu64 " holds data of another run %08" PRIx32
+                 " (%u bad sectors)", check->expected_lba, found->run_id, check->bad_sectors);
+    } else if (found->pass != pattern->pass) {
+        snprintf(message, size, "LBA %" PRIu64 " holds stale data of pass %" PRIu32
+                 " (%u bad sectors)", check->expected_lba, found->pass, check->bad_sectors);
+    } else {
+        snprintf(message, size, "data mismatch at LBA %" PRIu64 " (%u bad sectors)",
+                 check->expected_lba, check->bad_sectors);
+    }
+
+    if (check->bad_sectors == 0)
+        return;
+
+    for (unsigned int i = 0; i < check->num_ranges; i++) {
+        const sector_range_t *range = &check->bad_ranges[i];
+        size_t used = strlen(message);
+
+        if (range->count == 1)
+            snprintf(message + used, size - used, "%s%" PRIu64, (i == 0) ? "; bad LBAs: " : ", ",
+                     range->lba);
+        else
+            snprintf(message + used, size - used, "%s%" PRIu64 "-%" PRIu64,
+                     (i == 0) ? "; bad LBAs: " : ", ", range->lba, range->lba + range->count - 1);
+    }
+
+    if (check->more_ranges > 0)
+        snprintf(message + strlen(message), size - strlen(message), " (+%u more ranges)",
+                 check->more_ranges);
+
+    snprintf(message + strlen(message), size - strlen(message), "; %" PRIu64 " bit flips",
+             check->bit_flips);
+}
+
+static inline bool check_sector_tag(const char *sector, uint64_t lba, uint32_t pass,
+                                    uint32_t run_id)
+{
+#if defined(__SSE2__)
+    __m128i head = _mm_set_epi64x((long long)lba, (long long)SECTOR_TAG_MAGIC);
+    __m128i tail = _mm_set_epi64x((long long)~lba, (long long)(((uint64_t)run_id << 32) | pass));
+    __m128i eq = _mm_and_si128(
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)sector), head),
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(sector + 16)), tail));
+
+    return _mm_movemask_epi8(eq) == 0xffff;
+#else
+    sector_tag_t tag;
+
+    memcpy(&tag, sector, sizeof(tag));
+
+    return tag.magic == SECTOR_TAG_MAGIC && tag.lba == lba && tag.pass == pass &&
+           tag.run_id == run_id && tag.lba_inv == ~lba;
+#endif
+}
+
+/* Data and tags of all sectors at once, without telling which sector is bad. */
+static bool check_block_fast(const pattern_t *pattern, const char *buffer, size_t len, uint64_t lba)
+{
+    size_t sector_size = pattern->sector_size;
+    size_t num_sectors = len / sector_size;
+    size_t first_skip = pattern->tagged ? BLOCK_HEADER_OFFSET + BLOCK_HEADER_SIZE : 0;
+    size_t skip = pattern->tagged ? SECTOR_TAG_SIZE : 0;
+    verify_stream_t stream;
+
+    if (pattern->tagged) {
+        for (size_t pos = 0; pos < len; pos += sector_size, lba++) {
+            if (!check_sector_tag(buffer + pos, lba, pattern->pass, pattern->run_id))
+                return false;
+        }
+    }
+
+    if (pattern->data == PATTERN_DATA_RANDOM) {
+        verify_stream_init(&stream, pattern->run_id);
+
+        return verify_stream_compare_sectors(&stream, buffer, sector_size, first_skip, 1) &&
+               verify_stream_compare_sectors(&stream, buffer + sector_size, sector_size, skip,
+                                             num_sectors - 1);
+    }
+
+    if (!pattern->tagged)
+        return verify_is_byte(buffer, len, pattern->fill);
+
+    for (size_t pos = 0; pos < len; pos += sector_size) {
+        if (!verify_is_byte(buffer + pos + (pos == 0 ? first_skip : skip),
+                            sector_size - (pos == 0 ? first_skip : skip), pattern->fill))
+            return false;
+    }
+
+    return true;
+}
+
+/* Check the data of one sector past its first skip bytes and count the flipped bits. */
+static bool check_sector_data(
+    const pattern_t *pattern,
+    verify_stream_t *stream,
+    const char *sector,
+    size_t skip,
+    uint64_t *bit_flips
+) {
+    size_t sector_size = pattern->sector_size;
+    verify_stream_t start = *stream;
+
+    if (pattern->data == PATTERN_DATA_BYTE) {
+        if (verify_is_byte(sector + skip, sector_size - skip, pattern->fill))
+            return true;
+
+        *bit_flips += verify_byte_flips(sector + skip, sector_size - skip, pattern->fill);
+        return false;
+    }
+
+    if (verify_stream_compare_sectors(stream, sector, sector_size, skip, 1))
+        return true;
+
+    verify_stream_skip(&start, skip);
+    *bit_flips += verify_stream_flips(&start, sector + skip, sector_size - skip);
+
+    return false;
+}
+
+/* Merge a bad sector into the range list; prev_bad says the previous sector was bad too. */
+static void add_bad_sector(block_check_t *check, uint64_t lba, bool prev_bad)
+{
+    check->bad_sectors++;
+
+    if (prev_bad) {
+        /* A range that did not fit is only counted. */
+        if (check->more_ranges == 0)
+            check->bad_ranges[check->num_ranges - 1].count++;
+    } else if (check->num_ranges < BLOCK_CHECK_MAX_RANGES) {
+        check->bad_ranges[check->num_ranges].lba = lba;
+        check->bad_ranges[check->num_ranges].count = 1;
+        check->num_ranges++;
+    } else {
+        check->more_ranges++;
+    }
+}
+
+bool pattern_parse_header(const char *sector, block_header_t *header)
+{
+    sector_tag_t tag;
+
+    memcpy(&tag, sector, sizeof(tag));
+    memcpy(header, sector + BLOCK_HEADER_OFFSET, sizeof(block_header_t));
+
+    return tag.magic == SECTOR_TAG_MAGIC && tag.lba_inv == ~tag.lba &&
+           header->magic == BLOCK_HEADER_MAGIC;
+}
+
+/* A comma-separated list of bytes such as 0xaa or 170, and random. */
+pattern_check_t pattern_parse_schedule(const char *arg, pattern_schedule_t *schedule)
+{
+    const char *item = arg;
+    char *end;
+    unsigned long byte;
+
+    schedule->length = 0;
+
+    for (;;) {
+        if (schedule->length == PATTERN_SCHEDULE_MAX)
+            return PATTERN_CHECK_ERR_TOO_MANY;
+
+        if (strncmp(item, "random", 6) == 0 && (item[6] == ',' || item[6] == '\0')) {
+            schedule->fills[schedule->length++] = PATTERN_FILL_RANDOM;
+            end = (char*)item + 6;
+        } else {
+            if (*item < '0' || *item > '9')
+                return PATTERN_CHECK_ERR_INVALID;
+
+            errno = 0;
+            byte = strtoul(item, &end, 0);
+
+            if (errno != 0 || byte > UINT8_MAX || (*end != ',' && *end != '\0'))
+                return PATTERN_CHECK_ERR_INVALID;
+
+            schedule->fills[schedule->length++] = (int)byte;
+        }
+
+        if (*end == '\0')
+            return PATTERN_CHECK_OK;
+
+        item = end + 1;
+    }
+}
+
+int pattern_schedule_fill(const pattern_schedule_t *schedule, unsigned int pass)
+{
+    if (schedule->length == 0)
+        return PATTERN_FILL_RANDOM;
+
+    return schedule->fills[(pass - 1) % schedule->length];
+}
+
+void pattern_set_fill(pattern_t *pattern, int fill)
+{
+    pattern->data = (fill == PATTERN_FILL_RANDOM) ? PATTERN_DATA_RANDOM : PATTERN_DATA_BYTE;
+    pattern->fill = (fill == PATTERN_FILL_RANDOM) ? 0 : (uint8_t)fill;
+}
+
+/*
+ * The base data of a tagged block from its first sector: the data after
+ * the block header is a single repeated byte, or the data stream. A
+ * sector of the stream never repeats a byte over its whole length.
+ */
+int pattern_detect_fill(const char *sector, size_t sector_size)
+{
+    size_t start = BLOCK_HEADER_OFFSET + BLOCK_HEADER_SIZE;
+    uint8_t fill = (uint8_t)sector[start];
+
+    if (verify_is_byte(sector + start, sector_size - start, fill))
+        return fill;
+
+    return PATTERN_FILL_RANDOM;
+}
+
+void pattern_format_fill(int fill, char *buffer, size_t size)
+{
+    if (fill == PATTERN_FILL_RANDOM)
+        snprintf(buffer, size, "random");
+    else
+        snprintf(buffer, size, "0x%02x", (unsigned int)fill);
+}
+
+static uint32_t block_crc(const char *buffer, size_t len)
+{
+    size_t crc_pos = BLOCK_HEADER_OFFSET + offsetof(block_header_t, crc);
+    uint32_t crc;
+
+    /* Everything but the CRC field itself. */
+    crc = crc32c(0, buffer, crc_pos);
+
+    return crc32c(crc, buffer + crc_pos + sizeof(uint32_t), len - crc_pos - sizeof(uint32_t));
+}
+
+static void stamp_block_header(const pattern_t *pattern, char *buffer, size_t len, off_t offset)
+{
+    block_header_t header;
+    uint32_t crc;
+
+    header.magic = BLOCK_HEADER_MAGIC;
+    header.offset = (uint64_t)offset;
+    header.blocksize = pattern->blocksize;
+    header.pass = pattern->pass;
+    header.seed = pattern->run_id;
+    header.crc = 0;
+    memcpy(buffer + BLOCK_HEADER_OFFSET, &header, sizeof(header));
+
+    crc = block_crc(buffer, len);
+    memcpy(buffer + BLOCK_HEADER_OFFSET + offsetof(block_header_t, crc), &crc, sizeof(crc));
+}
+
+static bool check_block_header(
+    const pattern_t *pattern,
+    const char *buffer,
+    size_t len,
+    off_t offset,
+    block_check_t *check
+) {
+    block_header_t header;
+
+    memcpy(&header, buffer + BLOCK_HEADER_OFFSET, sizeof(header));
+
+    check->bad_header = header.magic != BLOCK_HEADER_MAGIC ||
+                        header.offset != (uint64_t)offset ||
+                        header.blocksize != pattern->blocksize ||
+                        header.pass != pattern->pass ||
+                        header.seed != pattern->run_id;
+
+    /* A block with a foreign header can't have a matching checksum either. */
+    if (!check->bad_header)
+        check->bad_crc = (header.crc != block_crc(buffer, len));
+
+    return !check->bad_header && !check->bad_crc;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Every sector of a tagged block starts with a sector tag that names the
+ * LBA it was written to, the pass and the run that wrote it. The rest of
+ * the sector holds the base data pattern. A drive that writes to the wrong
+ * LBA, or aliases high addresses onto low ones, then fails verification
+ * even though the base data itself is intact.
+ */
+
+#define SECTOR_TAG_MAGIC 0x4b5453414f524b44ULL    /* "DKROASTK" */
+#define SECTOR_TAG_SIZE 32
+
+/*
+ * The first sector of a tagged block also carries a block header right
+ * after its tag. The header's CRC32C covers the whole block except the CRC
+ * field itself, so a block can be checked later without knowing the data
+ * that was written (see --verify-only).
+ */
+
+#define BLOCK_HEADER_MAGIC 0x4b4c424b53494444ULL  /* "DDISKBLK" */
+#define BLOCK_HEADER_SIZE 32
+#define BLOCK_HEADER_OFFSET SECTOR_TAG_SIZE
+
+typedef struct sector_tag_t {
+    uint64_t magic;
+    uint64_t lba;
+    uint32_t pass;
+    uint32_t run_id;
+    uint64_t lba_inv;       /* ~lba, guards against torn or shifted tags. */
+} sector_tag_t;
+
+typedef struct block_header_t {
+    uint64_t magic;
+    uint64_t offset;
+    uint32_t blocksize;
+    uint32_t pass;
+    uint32_t seed;          /* Run ID, also the seed of the base data. */
+    uint32_t crc;
+} block_header_t;
+
+/* Base data under the tags, regenerated for every block (see verify.h). */
+typedef enum pattern_data_t {
+    PATTERN_DATA_RANDOM,    /* Data stream seeded by the run ID. */
+    PATTERN_DATA_BYTE       /* Every byte is the fill byte, e.g. 0x00 or 0xaa. */
+} pattern_data_t;
+
+typedef struct pattern_t {
+    pattern_data_t data;
+    uint8_t fill;
+    unsigned int blocksize;
+    unsigned int sector_size;
+    bool tagged;
+    uint32_t pass;
+    uint32_t run_id;
+} pattern_t;
+
+/*
+ * Base data of the passes in turn, e.g. 0x00,0xff,0xaa,0x55,random: pass
+ * n writes entry (n - 1) % length, so a stuck bit that happens to match
+ * one pattern is caught by another. An entry is a fill byte or
+ * PATTERN_FILL_RANDOM; an empty schedule is the data stream alone.
+ */
+
+#define PATTERN_SCHEDULE_MAX 16
+#define PATTERN_FILL_RANDOM -1
+
+typedef struct pattern_schedule_t {
+    int fills[PATTERN_SCHEDULE_MAX];
+    unsigned int length;
+} pattern_schedule_t;
+
+typedef enum {
+    PATTERN_CHECK_OK = 0,
+    PATTERN_CHECK_ERR_INVALID,
+    PATTERN_CHECK_ERR_TOO_MANY
+} pattern_check_t;
+
+#define BLOCK_CHECK_MAX_RANGES 8
+
+/* A run of consecutive bad sectors. */
+typedef struct sector_range_t {
+    uint64_t lba;
+    uint64_t count;
+} sector_range_t;
+
+/* Outcome of verifying one block against the pattern. */
+typedef struct block_check_t {
+    unsigned int bad_sectors;
+    uint64_t expected_lba;      /* First mismatching sector. */
+    bool found_tag;             /* The sector carried a valid tag... */
+    sector_tag_t found;         /* ...with these contents. */
+    sector_range_t bad_ranges[BLOCK_CHECK_MAX_RANGES];
+    unsigned int num_ranges;
+    unsigned int more_ranges;   /* Ranges that did not fit into bad_ranges. */
+    uint64_t bit_flips;         /* In the data of bad sectors, tags excluded. */
+    bool bad_header;
+    bool bad_crc;
+} block_check_t;
+
+void pattern_fill_block(const pattern_t*, char*, size_t, off_t);
+void pattern_stamp_block(const pattern_t*, char*, size_t, off_t);
+bool pattern_check_block(const pattern_t*, const char*, size_t, off_t, block_check_t*);
+void pattern_describe_mismatch(const pattern_t*, const block_check_t*, char*, size_t);
+bool pattern_parse_header(const char*, block_header_t*);
+pattern_check_t pattern_parse_schedule(const char*, pattern_schedule_t*);
+int pattern_schedule_fill(const pattern_schedule_t*, unsigned int);
+void pattern_set_fill(pattern_t*, int);
+int pattern_detect_fill(const char*, size_t);
+void pattern_format_fill(int, char*, size_t);
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+
+#include "permute.h"
+
+/*
+ * Internal functions' prototypes
+ */
+
+static inline uint64_t mix64(uint64_t);
+static inline uint64_t feistel(const permute_t*, uint64_t);
+
+/* The same n and seed always give the same order, so a resumed pass picks up where it left. */
+void permute_init(permute_t *permute, uint64_t n, uint64_t seed)
+{
+    unsigned int bits = 1;
+
+    while (bits < 64 && (n - 1) >> bits != 0)
+        bits++;
+
+    permute->n = n;
+    permute->half_bits = (bits + 1) / 2;
+    permute->half_mask = (1ULL << permute->half_bits) - 1;
+
+    /* SplitMix64 turns the seed into independent round keys. */
+    for (unsigned int i = 0; i < PERMUTE_ROUNDS; i++) {
+        seed += 0x9e3779b97f4a7c15ULL;
+        permute->keys[i] = mix64(seed);
+    }
+}
+
+uint64_t permute_index(const permute_t *permute, uint64_t index)
+{
+    if (permute->n <= 1)
+        return index;
+
+    do {
+        index = feistel(permute, index);
+    } while (index >= permute->n);
+
+    return index;
+}
+
+/* The SplitMix64 finalizer: every input bit affects every output bit. */
+static inline uint64_t mix64(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+    return x ^ (x >> 31);
+}
+
+static inline uint64_t feistel(const permute_t *permute, uint64_t index)
+{
+    uint64_t left = index >> permute->half_bits;
+    uint64_t right = index & permute->half_mask;
+    uint64_t next;
+
+    for (unsigned int i = 0; i < PERMUTE_ROUNDS; i++) {
+        next = left ^ (mix64(right ^ permute->keys[i]) & permute->half_mask);
+        left = right;
+        right = next;
+    }
+
+    return (left << permute->half_bits) | right;
+}
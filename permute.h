@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef PERMUTE_H
+#define PERMUTE_H
+
+#include <stdint.h>
+
+/*
+ * Pseudo-random permutation of the indexes [0, n). A balanced Feistel
+ * network over the smallest even number of bits that covers n is a
+ * bijection, and results that fall outside [0, n) are fed through it
+ * again ("cycle walking") until they land inside. Every index maps to a
+ * distinct index, so walking through 0..n-1 visits everything exactly
+ * once in random order with O(1) memory and no shuffle table.
+ *
+ * The bit space is less than four times n, so fewer than four rounds of
+ * cycle walking are needed on average.
+ */
+
+#define PERMUTE_ROUNDS 4
+
+typedef struct permute_t {
+    uint64_t n;
+    unsigned int half_bits;
+    uint64_t half_mask;
+    uint64_t keys[PERMUTE_ROUNDS];
+} permute_t;
+
+void permute_init(permute_t*, uint64_t, uint64_t);
+uint64_t permute_index(const permute_t*, uint64_t);
+
+#endif
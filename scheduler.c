@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+
+#include "scheduler.h"
+
+#define RANGE_HEAD(range) ((uint32_t)((range) >> 32))
+#define RANGE_TAIL(range) ((uint32_t)(range))
+#define RANGE(head, tail) (((uint64_t)(head) << 32) | (uint32_t)(tail))
+
+/*
+ * Internal functions' prototypes
+ */
+
+static bool take_chunk(sched_queue_t*, uint64_t*);
+static bool steal_chunks(scheduler_t*, unsigned int, uint64_t*);
+static void chunk_bounds(scheduler_t*, uint64_t, off_t*, off_t*);
+
+bool sched_init(scheduler_t *sched, unsigned int num_queues, off_t disk_size, off_t chunk_size)
+{
+    sched->num_queues = num_queues;
+    sched->disk_size = disk_size;
+    sched->chunk_size = chunk_size;
+    sched->num_chunks = (disk_size + chunk_size - 1) / chunk_size;
+
+    if (sched->num_chunks > SCHED_MAX_CHUNKS)
+        return false;
+
+    if (posix_memalign((void**)&sched->queues, STATS_CACHE_LINE,
+                       num_queues * sizeof(sched_queue_t)) != 0)
+        return false;
+
+    if ((sched->done = calloc(SCHED_DONE_WORDS(sched->num_chunks), sizeof(uint64_t))) == NULL)
+        return false;
+
+    sched_reset(sched, NULL);
+
+    return true;
+}
+
+/* Start a pass. Chunks set in done, if given, were finished before and are skipped. */
+void sched_reset(scheduler_t *sched, const uint64_t *done)
+{
+    uint64_t head;
+    uint64_t tail;
+
+    for (uint64_t i = 0; i < SCHED_DONE_WORDS(sched->num_chunks); i++)
+        atomic_store_explicit(&sched->done[i], done ? done[i] : 0, memory_order_relaxed);
+
+    /* Hand out the same contiguous slices that static segmentation would. */
+    for (unsigned int i = 0; i < sched->num_queues; i++) {
+        head = sched->num_chunks * i / sched->num_queues;
+        tail = sched->num_chunks * (i + 1) / sched->num_queues;
+        atomic_store(&sched->queues[i].range, RANGE(head, tail));
+    }
+}
+
+bool sched_next_chunk(scheduler_t *sched, unsigned int queue, off_t *start, off_t *end)
+{
+    uint64_t chunk;
+
+    do {
+        if (!take_chunk(&sched->queues[queue], &chunk) && !steal_chunks(sched, queue, &chunk))
+            return false;
+    } while (atomic_load_explicit(&sched->done[chunk / 64], memory_order_relaxed) &
+             (1ULL << (chunk % 64)));
+
+    chunk_bounds(sched, chunk, start, end);
+
+    return true;
+}
+
+uint64_t sched_chunks_left(scheduler_t *sched, unsigned int queue)
+{
+    uint64_t range = atomic_load_explicit(&sched->queues[queue].range, memory_order_relaxed);
+
+    return (RANGE_HEAD(range) < RANGE_TAIL(range)) ? RANGE_TAIL(range) - RANGE_HEAD(range) : 0;
+}
+
+/* Called once every block of the chunk that starts at offset has been verified. */
+void sched_chunk_done(scheduler_t *sched, off_t offset)
+{
+    uint64_t chunk = (uint64_t)(offset / sched->chunk_size);
+
+    atomic_fetch_or_explicit(&sched->done[chunk / 64], 1ULL << (chunk % 64),
+                             memory_order_relaxed);
+}
+
+/* Snapshot of the finished chunks, SCHED_DONE_WORDS(num_chunks) words long. */
+void sched_get_done(scheduler_t *sched, uint64_t *done)
+{
+    for (uint64_t i = 0; i < SCHED_DONE_WORDS(sched->num_chunks); i++)
+        done[i] = atomic_load_explicit(&sched->done[i], memory_order_relaxed);
+}
+
+void sched_destroy(scheduler_t *sched)
+{
+    free(sched->queues);
+    free((void*)sched->done);
+    sched->queues = NULL;
+    sched->done = NULL;
+}
+
+static bool take_chunk(sched_queue_t *queue, uint64_t *chunk)
+{
+    uint64_t range = atomic_load(&queue->range);
+
+    do {
+        if (RANGE_HEAD(range) >= RANGE_TAIL(range))
+            return false;
+    } while (!atomic_compare_exchange_weak(&queue->range, &range,
+                                           RANGE(RANGE_HEAD(range) + 1, RANGE_TAIL(range))));
+
+    *chunk = RANGE_HEAD(range);
+
+    return true;
+}
+
+static bool steal_chunks(scheduler_t *sched, unsigned int thief, uint64_t *chunk)
+{
+    unsigned int victim;
+    uint64_t left;
+    uint64_t most_left;
+    uint64_t range;
+    uint64_t steal;
+    uint64_t tail;
+
+    for (;;) {
+        most_left = 0;
+        victim = thief;
+
+        for (unsigned int i = 0; i < sched->num_queues; i++) {
+            if (i != thief && (left = sched_chunks_left(sched, i)) > most_left) {
+                most_left = left;
+                victim = i;
+            }
+        }
+
+        if (most_left == 0)
+            return false;
+
+        /* Take the back half, the victim keeps streaming through the front. */
+        range = atomic_load(&sched->queues[victim].range);
+
+        if (RANGE_HEAD(range) >= RANGE_TAIL(range))
+            continue;
+
+        left = RANGE_TAIL(range) - RANGE_HEAD(range);
+        steal = (left + 1) / 2;
+        tail = RANGE_TAIL(range);
+
+        if (!atomic_compare_exchange_strong(&sched->queues[victim].range, &range,
+                                            RANGE(RANGE_HEAD(range), tail - steal)))
+            continue;
+
+        /* The thief's own run is empty, so nobody else can change it meanwhile. */
+        atomic_store(&sched->queues[thief].range, RANGE(tail - steal + 1, tail));
+        *chunk = tail - steal;
+
+        return true;
+    }
+}
+
+static void chunk_bounds(scheduler_t *sched, uint64_t chunk, off_t *start, off_t *end)
+{
+    *start = (off_t)chunk * sched->chunk_size;
+    *end = *start + sched->chunk_size;
+
+    if (*end > sched->disk_size)
+        *end = sched->disk_size;
+}
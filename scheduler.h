@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "stats.h"
+
+/*
+ * The disk is cut into chunks. Every worker starts with a contiguous run of
+ * chunks, the same slice it would get with static segments, and takes them
+ * from the front in order, so the access pattern stays sequential. A worker
+ * that runs out steals the back half of the largest remaining run of
+ * another worker. All threads stay busy until the last chunk is taken.
+ *
+ * A run is kept as head and tail chunk indexes packed into one 64-bit word,
+ * so both taking and stealing are a single compare-and-swap.
+ *
+ * Chunks that have been written and verified are marked in a bitmap, which
+ * is what the checkpoint journal saves. Marked chunks are skipped, so a
+ * resumed pass only does the chunks that were not finished. The chunk
+ * count is capped to keep the bitmap at 2 MiB.
+ */
+
+#define SCHED_MAX_CHUNKS (1U << 24)
+#define SCHED_DONE_WORDS(num_chunks) (((num_chunks) + 63) / 64)
+
+typedef struct sched_queue_t {
+    _Alignas(STATS_CACHE_LINE) _Atomic uint64_t range;
+} sched_queue_t;
+
+typedef struct scheduler_t {
+    sched_queue_t *queues;
+    _Atomic uint64_t *done;     /* One bit per finished chunk. */
+    unsigned int num_queues;
+    off_t chunk_size;
+    off_t disk_size;
+    uint64_t num_chunks;
+} scheduler_t;
+
+bool sched_init(scheduler_t*, unsigned int, off_t, off_t);
+void sched_reset(scheduler_t*, const uint64_t*);
+bool sched_next_chunk(scheduler_t*, unsigned int, off_t*, off_t*);
+uint64_t sched_chunks_left(scheduler_t*, unsigned int);
+void sched_chunk_done(scheduler_t*, off_t);
+void sched_get_done(scheduler_t*, uint64_t*);
+void sched_destroy(scheduler_t*);
+
+#endif
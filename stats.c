@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+
+/*
+ * Internal functions' prototypes
+ */
+
+static inline unsigned int hist_bucket(uint64_t);
+static uint64_t hist_bucket_high(unsigned int);
+static void print_latency_line(FILE*, const char*, const char*, latency_hist_t*, uint64_t);
+static void print_slow_regions(FILE*, worker_stats_t*, unsigned int);
+
+uint64_t stats_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void hist_record(latency_hist_t *hist, uint64_t value)
+{
+    stats_add(&hist->buckets[hist_bucket(value)], 1);
+    stats_add(&hist->count, 1);
+
+    if (value > stats_get(&hist->max))
+        atomic_store_explicit(&hist->max, value, memory_order_relaxed);
+}
+
+void hist_merge(latency_hist_t *dst, latency_hist_t *src)
+{
+    for (unsigned int i = 0; i < HIST_NUM_BUCKETS; i++)
+        stats_add(&dst->buckets[i], stats_get(&src->buckets[i]));
+
+    stats_add(&dst->count, stats_get(&src->count));
+
+    if (stats_get(&src->max) > stats_get(&dst->max))
+        atomic_store_explicit(&dst->max, stats_get(&src->max), memory_order_relaxed);
+}
+
+uint64_t hist_percentile(latency_hist_t *hist, double percentile)
+{
+    uint64_t count = stats_get(&hist->count);
+    uint64_t target;
+    uint64_t seen = 0;
+    uint64_t high;
+
+    if (count == 0)
+        return 0;
+
+    /* The smallest recorded value that at least the given share of values don't exceed. */
+    target = (uint64_t)(count * percentile / 100.0 + 0.5);
+
+    if (target == 0)
+        target = 1;
+
+    for (unsigned int i = 0; i < HIST_NUM_BUCKETS; i++) {
+        seen += stats_get(&hist->buckets[i]);
+
+        if (seen >= target) {
+            high = hist_bucket_high(i);
+            return (high < stats_get(&hist->max)) ? high : stats_get(&hist->max);
+        }
+    }
+
+    return stats_get(&hist->max);
+}
+
+void stats_print_latency_report(FILE *stream, worker_stats_t *stats, unsigned int num_workers)
+{
+    latency_hist_t total_write;
+    latency_hist_t total_read;
+    latency_hist_t total_flush;
+    uint64_t mismatched_blocks = 0;
+    uint64_t mismatched_sectors = 0;
+    uint64_t bit_flips = 0;
+    uint64_t read_errors = 0;
+    uint64_t write_errors = 0;
+    uint64_t recovered_errors = 0;
+    uint64_t bad_sectors = 0;
+    uint64_t busy_ns = 0;
+    uint64_t throttled_ns = 0;
+    char name[32];
+
+    memset(&total_write, 0, sizeof(latency_hist_t));
+    memset(&total_read, 0, sizeof(latency_hist_t));
+    memset(&total_flush, 0, sizeof(latency_hist_t));
+
+    fprintf(stream, "%-12s %-6s %10s %10s %10s %10s %10s\n", "latency, ms", "", "p50", "p99",
+                    "p99.9", "max", "IOPS");
+
+    for (unsigned int i = 0; i < num_workers; i++) {
+        snprintf(name, sizeof(name), "worker %u", i);
+        print_latency_line(stream, name, "write", &stats[i].write_latency,
+                           stats_get(&stats[i].busy_ns));
+        print_latency_line(stream, name, "read", &stats[i].read_latency,
+                           stats_get(&stats[i].busy_ns));
+        print_latency_line(stream, name, "flush", &stats[i].flush_latency,
+                           stats_get(&stats[i].busy_ns));
+
+        /* The workers run side by side, so the device took as long as the slowest one. */
+        if (stats_get(&stats[i].busy_ns) > busy_ns)
+            busy_ns = stats_get(&stats[i].busy_ns);
+
+        throttled_ns += stats_get(&stats[i].throttled_ns);
+
+        hist_merge(&total_write, &stats[i].write_latency);
+        hist_merge(&total_read, &stats[i].read_latency);
+        hist_merge(&total_flush, &stats[i].flush_latency);
+        mismatched_blocks += stats_get(&stats[i].mismatched_blocks);
+        mismatched_sectors += stats_get(&stats[i].mismatched_sectors);
+        bit_flips += stats_get(&stats[i].bit_flips);
+        read_errors += stats_get(&stats[i].read_errors);
+        write_errors += stats_get(&stats[i].write_errors);
+        recovered_errors += stats_get(&stats[i].recovered_errors);
+        bad_sectors += stats_get(&stats[i].bad_sectors);
+    }
+
+    print_latency_line(stream, "device", "write", &total_write, busy_ns);
+    print_latency_line(stream, "device", "read", &total_read, busy_ns);
+    print_latency_line(stream, "device", "flush", &total_flush, busy_ns);
+    print_slow_regions(stream, stats, num_workers);
+
+    fprintf(stream, "mismatched blocks: %llu, mismatched sectors: %llu, bit flips: %llu\n",
+                    (unsigned long long)mismatched_blocks,
+                    (unsigned long long)mismatched_sectors,
+                    (unsigned long long)bit_flips);
+    fprintf(stream, "read errors: %llu, write errors: %llu, recovered on retry: %llu, "
+                    "bad sectors: %llu\n",
+                    (unsigned long long)read_errors,
+                    (unsigned long long)write_errors,
+                    (unsigned long long)recovered_errors,
+                    (unsigned long long)bad_sectors);
+
+    /* Workers wait side by side, so their mean wait is what the limit cost the pass. */
+    if (throttled_ns > 0 && busy_ns > 0)
+        fprintf(stream, "throttled: %.1f s per worker, %.0f%% of the pass\n",
+                        throttled_ns / 1e9 / num_workers,
+                        throttled_ns * 100.0 / num_workers / busy_ns);
+}
+
+/* Keep region in a list of STATS_SLOW_REGIONS, slowest first, if it is slow enough. */
+void stats_add_region(region_latency_t *regions, const region_latency_t *region)
+{
+    unsigned int pos = STATS_SLOW_REGIONS;
+
+    while (pos > 0 && region->max_ns > regions[pos - 1].max_ns)
+        pos--;
+
+    if (pos == STATS_SLOW_REGIONS)
+        return;
+
+    memmove(&regions[pos + 1], &regions[pos],
+            (STATS_SLOW_REGIONS - pos - 1) * sizeof(region_latency_t));
+    regions[pos] = *region;
+}
+
+static inline unsigned int hist_bucket(uint64_t value)
+{
+    unsigned int shift;
+
+    if (value < HIST_SUB_BUCKETS)
+        return (unsigned int)value;
+
+    /* Position of the highest set bit selects the power of two, the next bits the sub-bucket. */
+    shift = 63 - __builtin_clzll(value) - HIST_SUB_BUCKET_BITS;
+
+    return (shift + 1) * HIST_SUB_BUCKETS +
+           (unsigned int)((value >> shift) & (HIST_SUB_BUCKETS - 1));
+}
+
+static uint64_t hist_bucket_high(unsigned int bucket)
+{
+    unsigned int shift;
+    uint64_t sub;
+
+    if (bucket < HIST_SUB_BUCKETS)
+        return bucket;
+
+    shift = bucket / HIST_SUB_BUCKETS - 1;
+    sub = bucket % HIST_SUB_BUCKETS;
+
+    return ((HIST_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+static void print_slow_regions(FILE *stream, worker_stats_t *stats, unsigned int num_workers)
+{
+    region_latency_t slowest[STATS_SLOW_REGIONS];
+    region_latency_t *region;
+
+    memset(slowest, 0, sizeof(slowest));
+
+    for (unsigned int i = 0; i < num_workers; i++) {
+        for (unsigned int j = 0; j < STATS_SLOW_REGIONS && stats[i].slow_regions[j].num_reads; j++)
+            stats_add_region(slowest, &stats[i].slow_regions[j]);
+    }
+
+    if (slowest[0].num_reads == 0)
+        return;
+
+    fprintf(stream, "%-19s %10s %10s %10s %10s\n", "slowest regions", "offset, MB", "size, MB",
+                    "mean", "max");
+
+    for (unsigned int i = 0; i < STATS_SLOW_REGIONS && slowest[i].num_reads; i++) {
+        region = &slowest[i];
+        fprintf(stream, "%-19s %10llu %10llu %10.3f %10.3f\n", "",
+                        (unsigned long long)(region->offset / 1024 / 1024),
+                        (unsigned long long)(region->len / 1024 / 1024),
+                        region->total_ns / 1e6 / region->num_reads,
+                        region->max_ns / 1e6);
+    }
+}
+
+static void print_latency_line(FILE *stream, const char *name, const char *op, latency_hist_t *hist,
+                               uint64_t busy_ns)
+{
+    if (stats_get(&hist->count) == 0)
+        return;
+
+    fprintf(stream, "%-12s %-6s %10.3f %10.3f %10.3f %10.3f %10.0f\n", name, op,
+                    hist_percentile(hist, 50.0) / 1e6,
+                    hist_percentile(hist, 99.0) / 1e6,
+                    hist_percentile(hist, 99.9) / 1e6,
+                    stats_get(&hist->max) / 1e6,
+                    (busy_ns > 0) ? stats_get(&hist->count) * 1e9 / busy_ns : 0.0);
+}
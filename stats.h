@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define STATS_CACHE_LINE 64
+
+/*
+ * Log-linear latency histogram in nanoseconds, in the spirit of HDR
+ * histograms: every power of two is split into 16 linear sub-buckets, so
+ * any recorded value is off by at most 1/16 (6.25%) while the whole 64-bit
+ * range fits in under a thousand buckets.
+ */
+
+#define HIST_SUB_BUCKET_BITS 4
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BUCKET_BITS)
+#define HIST_NUM_BUCKETS ((64 - HIST_SUB_BUCKET_BITS + 1) * HIST_SUB_BUCKETS)
+
+typedef struct latency_hist_t {
+    _Atomic uint64_t count;
+    _Atomic uint64_t max;
+    _Atomic uint64_t buckets[HIST_NUM_BUCKETS];
+} latency_hist_t;
+
+/*
+ * Read latency over one region of the disk, a chunk. Every worker keeps
+ * the regions with the slowest reads it saw, so weak areas of the surface
+ * stand out even when the histograms look healthy.
+ */
+
+#define STATS_SLOW_REGIONS 5
+
+typedef struct region_latency_t {
+    uint64_t offset;
+    uint64_t len;
+    uint64_t max_ns;
+    uint64_t total_ns;
+    uint64_t num_reads;
+} region_latency_t;
+
+/*
+ * Statistics of one worker. Only the owning worker thread updates them, so
+ * plain relaxed loads and stores are enough and no lock is taken. Each
+ * block starts on its own cache line so workers don't slow each other
+ * down through false sharing.
+ */
+typedef struct worker_stats_t {
+    _Alignas(STATS_CACHE_LINE) _Atomic uint64_t written_bytes;
+    _Atomic uint64_t verified_bytes;
+    _Atomic uint64_t mismatched_blocks;
+    _Atomic uint64_t mismatched_sectors;
+    _Atomic uint64_t bit_flips;
+    _Atomic uint64_t read_errors;     /* Blocks with sectors that stayed unreadable. */
+    _Atomic uint64_t write_errors;
+    _Atomic uint64_t recovered_errors;  /* Failed I/O that went through on a retry. */
+    _Atomic uint64_t bad_sectors;
+    _Atomic uint64_t busy_ns;    /* Time the worker took for the pass, for IOPS. */
+    _Atomic uint64_t throttled_ns;  /* Time it waited for the rate limit. */
+    latency_hist_t write_latency;
+    latency_hist_t read_latency;
+    latency_hist_t flush_latency;   /* Cache flushes the worker waited for, apart from writes. */
+    region_latency_t slow_regions[STATS_SLOW_REGIONS];    /* Slowest first, read after the pass. */
+} worker_stats_t;
+
+static inline void stats_add(_Atomic uint64_t *counter, uint64_t value)
+{
+    atomic_store_explicit(counter,
+                          atomic_load_explicit(counter, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+}
+
+static inline uint64_t stats_get(_Atomic uint64_t *counter)
+{
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+uint64_t stats_now_ns(void);
+void hist_record(latency_hist_t*, uint64_t);
+void hist_merge(latency_hist_t*, latency_hist_t*);
+uint64_t hist_percentile(latency_hist_t*, double);
+void stats_add_region(region_latency_t*, const region_latency_t*);
+void stats_print_latency_report(FILE*, worker_stats_t*, unsigned int);
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "steady.h"
+
+/* Rounds of round_seconds samples each; a round of 0 seconds is one sample. */
+void steady_init(steady_t *steady, unsigned int round_seconds)
+{
+    memset(steady, 0, sizeof(steady_t));
+    steady->round_seconds = (round_seconds > 0) ? round_seconds : 1;
+}
+
+/*
+ * Add the rate of one second. Returns true when it finished a round, after
+ * which the window may have changed. Samples past the last round are dropped.
+ */
+bool steady_add(steady_t *steady, double rate)
+{
+    if (steady->num_rounds == STEADY_MAX_ROUNDS)
+        return false;
+
+    steady->round_sum += rate;
+
+    if (++steady->round_samples < steady->round_seconds)
+        return false;
+
+    steady->rounds[steady->num_rounds++] = steady->round_sum / steady->round_samples;
+    steady->round_sum = 0;
+    steady->round_samples = 0;
+
+    return true;
+}
+
+/*
+ * Measure the window of the last STEADY_WINDOW rounds. Returns false while
+ * there are fewer rounds than that. The slope is the rise of a least-squares
+ * line over the rounds of the window, from the first to the last.
+ */
+bool steady_measure(const steady_t *steady, steady_window_t *window)
+{
+    const double *rounds = steady->rounds + steady->num_rounds - STEADY_WINDOW;
+    double mid = (STEADY_WINDOW - 1) / 2.0;
+    double sum = 0;
+    double min;
+    double max;
+    double covariance = 0;
+    double variance = 0;
+    double rise;
+
+    if (steady->num_rounds < STEADY_WINDOW)
+        return false;
+
+    min = max = rounds[0];
+
+    for (unsigned int i = 0; i < STEADY_WINDOW; i++) {
+        sum += rounds[i];
+
+        if (rounds[i] < min)
+            min = rounds[i];
+        if (rounds[i] > max)
+            max = rounds[i];
+    }
+
+    window->average = sum / STEADY_WINDOW;
+
+    for (unsigned int i = 0; i < STEADY_WINDOW; i++) {
+        covariance += (i - mid) * (rounds[i] - window->average);
+        variance += (i - mid) * (i - mid);
+    }
+
+    rise = covariance / variance * (STEADY_WINDOW - 1);
+
+    if (rise < 0)
+        rise = -rise;
+
+    /* A drive that stopped taking writes altogether is not steady. */
+    if (window->average <= 0) {
+        window->range = 0;
+        window->slope = 0;
+        window->steady = false;
+        return true;
+    }
+
+    window->range = (max - min) / window->average;
+    window->slope = rise / window->average;
+    window->steady = window->range <= STEADY_MAX_RANGE && window->slope <= STEADY_MAX_SLOPE;
+
+    return true;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef STEADY_H
+#define STEADY_H
+
+#include <stdbool.h>
+
+/*
+ * Steady-state detection of a preconditioned SSD, after the SNIA Solid
+ * State Storage Performance Test Specification. The write rate of every
+ * second goes into rounds of a fixed length, and the last STEADY_WINDOW
+ * rounds form the measurement window. The drive is steady once the
+ * rounds of the window lie within STEADY_MAX_RANGE of their average and
+ * the best linear fit through them rises or falls by no more than
+ * STEADY_MAX_SLOPE of the average over the window. A drive that doesn't
+ * settle within STEADY_MAX_ROUNDS rounds never will in a useful time.
+ */
+
+#define STEADY_WINDOW 5
+#define STEADY_MAX_ROUNDS 25
+#define STEADY_MAX_RANGE 0.20
+#define STEADY_MAX_SLOPE 0.10
+
+typedef struct steady_t {
+    unsigned int round_seconds;
+    double round_sum;           /* Rate samples of the round being measured. */
+    unsigned int round_samples;
+    double rounds[STEADY_MAX_ROUNDS];   /* Average rate of every finished round. */
+    unsigned int num_rounds;
+} steady_t;
+
+/* The measurement window, its range and slope as fractions of the average. */
+typedef struct steady_window_t {
+    double average;
+    double range;
+    double slope;
+    bool steady;
+} steady_window_t;
+
+void steady_init(steady_t*, unsigned int);
+bool steady_add(steady_t*, double);
+bool steady_measure(const steady_t*, steady_window_t*);
+
+#endif
@@ -0,0 +1,457 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "telemetry.h"
+#include "utils.h"
+
+#define TELEMETRY_FD_PREFIX "fd:"
+#define TELEMETRY_UNIX_PREFIX "unix:"
+
+struct telemetry_t {
+    int fd;                     /* JSON-lines sink, -1 without one. */
+    bool close_fd;              /* The sink was opened here, not inherited. */
+    char *prom_path;            /* node_exporter textfile, NULL without one. */
+    char *prom_tmp_path;
+    unsigned int num_workers;
+    uint64_t *prev_written;     /* Bytes of every worker at the last record, for its rate. */
+    uint64_t *prev_verified;
+    uint64_t prev_ns;
+};
+
+/* Percentiles reported for every latency histogram, in JSON and Prometheus. */
+static const double percentiles[] = {50.0, 99.0, 99.9};
+static const char *const percentile_names[] = {"p50", "p99", "p99.9"};
+static const char *const quantile_names[] = {"0.5", "0.99", "0.999"};
+
+#define NUM_PERCENTILES (sizeof(percentiles) / sizeof(percentiles[0]))
+
+/*
+ * Internal functions' prototypes
+ */
+
+static int open_sink(const char*, bool*);
+static void write_json(telemetry_t*, FILE*, const char*, const telemetry_device_t*, unsigned int,
+                       uint64_t);
+static void write_json_latency(FILE*, const char*, latency_hist_t*);
+static void write_prometheus(telemetry_t*, FILE*, const telemetry_device_t*, unsigned int,
+                             uint64_t);
+static void write_prom_latency(FILE*, const char*, const char*, unsigned int, latency_hist_t*);
+static void write_prom_sample(FILE*, const char*, const char*);
+static double rate(uint64_t, uint64_t, uint64_t);
+
+/* Either sink may be NULL. */
+telemetry_check_t telemetry_open(telemetry_t **telemetry_ptr, const char *json_target,
+                                 const char *prom_path, unsigned int num_devices,
+                                 unsigned int num_workers)
+{
+    telemetry_t *telemetry;
+
+    if ((*telemetry_ptr = telemetry = calloc(1, sizeof(telemetry_t))) == NULL)
+        return TELEMETRY_CHECK_ERR_MEM_ALLOC;
+
+    telemetry->fd = -1;
+    telemetry->num_workers = num_workers;
+    telemetry->prev_ns = stats_now_ns();
+
+    if ((telemetry->prev_written = calloc(num_devices * num_workers, sizeof(uint64_t))) == NULL ||
+        (telemetry->prev_verified = calloc(num_devices * num_workers, sizeof(uint64_t))) == NULL)
+        return TELEMETRY_CHECK_ERR_MEM_ALLOC;
+
+    if (prom_path != NULL) {
+        if ((telemetry->prom_path = strdup(prom_path)) == NULL ||
+            (telemetry->prom_tmp_path = malloc(strlen(prom_path) + sizeof(".tmp"))) == NULL)
+            return TELEMETRY_CHECK_ERR_MEM_ALLOC;
+
+        sprintf(telemetry->prom_tmp_path, "%s.tmp", prom_path);
+    }
+
+    if (json_target != NULL && (telemetry->fd = open_sink(json_target, &telemetry->close_fd)) == -1)
+        return TELEMETRY_CHECK_ERR_OPEN;
+
+    return TELEMETRY_CHECK_OK;
+}
+
+/*
+ * Report every device, type tells what the record is: "progress" every
+ * second or "pass" at the end of a pass.
+ */
+void telemetry_record(telemetry_t *telemetry, const char *type, const telemetry_device_t *devices,
+                      unsigned int num_devices)
+{
+    uint64_t now_ns = stats_now_ns();
+    uint64_t elapsed_ns = now_ns - telemetry->prev_ns;
+    const telemetry_device_t *device;
+    char *buffer = NULL;
+    size_t size = 0;
+    FILE *stream;
+    uint64_t written;
+    uint64_t verified;
+    bool written_prom;
+
+    if (telemetry->fd != -1 && (stream = open_memstream(&buffer, &size)) != NULL) {
+        write_json(telemetry, stream, type, devices, num_devices, elapsed_ns);
+
+        if (fclose(stream) != 0 || !write_all(telemetry->fd, buffer, size, -1)) {
+            fprintf(stderr, "\nCan't write telemetry records: %s\n", strerror(errno));
+
+            if (telemetry->close_fd)
+                close(telemetry->fd);
+
+            telemetry->fd = -1;
+        }
+
+        free(buffer);
+    }
+
+    if (telemetry->prom_path != NULL) {
+        written_prom = (stream = fopen(telemetry->prom_tmp_path, "w")) != NULL;
+
+        if (written_prom) {
+            write_prometheus(telemetry, stream, devices, num_devices, elapsed_ns);
+            written_prom = (fclose(stream) == 0);
+        }
+
+        if (!written_prom || rename(telemetry->prom_tmp_path, telemetry->prom_path) == -1) {
+            fprintf(stderr, "\nCan't update the textfile %s: %s\n", telemetry->prom_path,
+                            strerror(errno));
+            unlink(telemetry->prom_tmp_path);
+            free(telemetry->prom_path);
+            telemetry->prom_path = NULL;
+        }
+    }
+
+    /* Rates start over with the next pass, whose counters start from zero. */
+    for (unsigned int i = 0; i < num_devices; i++) {
+        device = &devices[i];
+
+        for (unsigned int j = 0; j < telemetry->num_workers; j++) {
+            written = stats_get(&device->stats[j].written_bytes);
+            verified = stats_get(&device->stats[j].verified_bytes);
+            telemetry->prev_written[i * telemetry->num_workers + j] = written;
+            telemetry->prev_verified[i * telemetry->num_workers + j] = verified;
+        }
+    }
+
+    telemetry->prev_ns = now_ns;
+}
+
+void telemetry_close(telemetry_t *telemetry)
+{
+    if (telemetry == NULL)
+        return;
+
+    if (telemetry->fd != -1 && telemetry->close_fd)
+        close(telemetry->fd);
+
+    free(telemetry->prom_path);
+    free(telemetry->prom_tmp_path);
+    free(telemetry->prev_written);
+    free(telemetry->prev_verified);
+    free(telemetry);
+}
+
+static int open_sink(const char *target, bool *close_fd)
+{
+    struct sockaddr_un address;
+    char *end;
+    long fd;
+
+    *close_fd = true;
+
+    if (strncmp(target, TELEMETRY_FD_PREFIX, strlen(TELEMETRY_FD_PREFIX)) == 0) {
+        *close_fd = false;
+        errno = 0;
+        fd = strtol(target + strlen(TELEMETRY_FD_PREFIX), &end, 10);
+
+        if (errno != 0 || *end != '\0' || end == target + strlen(TELEMETRY_FD_PREFIX) ||
+            fd < 0 || fd > INT32_MAX || fcntl((int)fd, F_GETFD) == -1) {
+            errno = EBADF;
+            return -1;
+        }
+
+        return (int)fd;
+    }
+
+    if (strncmp(target, TELEMETRY_UNIX_PREFIX, strlen(TELEMETRY_UNIX_PREFIX)) == 0) {
+        target += strlen(TELEMETRY_UNIX_PREFIX);
+
+        if (strlen(target) >= sizeof(address.sun_path)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, target);
+
+        if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+            return -1;
+
+        if (connect((int)fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+            close((int)fd);
+            return -1;
+        }
+
+        return (int)fd;
+    }
+
+    return open(target, O_WRONLY|O_CREAT|O_APPEND, 0644);
+}
+
+static void write_json(telemetry_t *telemetry, FILE *stream, const char *type,
+                       const telemetry_device_t *devices, unsigned int num_devices,
+                       uint64_t elapsed_ns)
+{
+    const telemetry_device_t *device;
+    worker_stats_t *stats;
+    struct timespec now;
+    uint64_t written;
+    uint64_t verified;
+    uint64_t prev_written;
+    uint64_t prev_verified;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    for (unsigned int i = 0; i < num_devices; i++) {
+        device = &devices[i];
+
+        fprintf(stream, "{\"type\":\"%s\",\"time\":%lld.%03ld,\"device\":", type,
+                        (long long)now.tv_sec, now.tv_nsec / 1000000);
+        write_json_string(stream, device->name);
+        fprintf(stream, ",\"run_id\":\"%08x\",\"pass\":%u,\"passes\":%u,\"completed\":%.4f,"
+                        "\"written_bytes\":%lld,\"verified_bytes\":%lld,"
+                        "\"write_mb_s\":%.1f,\"read_mb_s\":%.1f,"
+                        "\"mismatched_blocks\":%llu,\"read_errors\":%llu,\"write_errors\":%llu,"
+                        "\"bad_sectors\":%llu,\"failed\":%s,\"workers\":[",
+                        device->run_id, device->pass, device->num_passes,
+                        (device->total_bytes > 0) ? (double)(device->written_bytes +
+                                                             device->verified_bytes) /
+                                                    device->total_bytes : 0.0,
+                        (long long)device->written_bytes, (long long)device->verified_bytes,
+                        device->write_rate / 1024.0 / 1024.0, device->read_rate / 1024.0 / 1024.0,
+                        (unsigned long long)device->mismatched_blocks,
+                        (unsigned long long)device->read_errors,
+                        (unsigned long long)device->write_errors,
+                        (unsigned long long)device->bad_sectors,
+                        device->failed ? "true" : "false");
+
+        for (unsigned int j = 0; j < telemetry->num_workers; j++) {
+            stats = &device->stats[j];
+            written = stats_get(&stats->written_bytes);
+            verified = stats_get(&stats->verified_bytes);
+            prev_written = telemetry->prev_written[i * telemetry->num_workers + j];
+            prev_verified = telemetry->prev_verified[i * telemetry->num_workers + j];
+
+            fprintf(stream, "%s{\"id\":%u,\"written_bytes\":%llu,\"verified_bytes\":%llu,"
+                            "\"write_mb_s\":%.1f,\"read_mb_s\":%.1f,",
+                            (j > 0) ? "," : "", j, (unsigned long long)written,
+                            (unsigned long long)verified,
+                            rate(written, prev_written, elapsed_ns),
+                            rate(verified, prev_verified, elapsed_ns));
+            write_json_latency(stream, "write_ms", &stats->write_latency);
+            write_json_latency(stream, "read_ms", &stats->read_latency);
+            write_json_latency(stream, "flush_ms", &stats->flush_latency);
+            fprintf(stream, "\"mismatched_blocks\":%llu,\"read_errors\":%llu,"
+                            "\"write_errors\":%llu,\"throttled_s\":%.3f}",
+                            (unsigned long long)stats_get(&stats->mismatched_blocks),
+                            (unsigned long long)stats_get(&stats->read_errors),
+                            (unsigned long long)stats_get(&stats->write_errors),
+                            stats_get(&stats->throttled_ns) / 1e9);
+        }
+
+        fprintf(stream, "]}\n");
+    }
+}
+
+static void write_json_latency(FILE *stream, const char *name, latency_hist_t *hist)
+{
+    fprintf(stream, "\"%s\":{", name);
+
+    for (unsigned int i = 0; i < NUM_PERCENTILES; i++)
+        fprintf(stream, "\"%s\":%.3f,", percentile_names[i],
+                        hist_percentile(hist, percentiles[i]) / 1e6);
+
+    fprintf(stream, "\"max\":%.3f},", stats_get(&hist->max) / 1e6);
+}
+
+/*
+ * Everything is a gauge, since the counters of a pass start over with
+ * the next one, except the error totals of the run.
+ */
+static void write_prometheus(telemetry_t *telemetry, FILE *stream,
+                             const telemetry_device_t *devices, unsigned int num_devices,
+                             uint64_t elapsed_ns)
+{
+    static const struct {
+        const char *name;
+        const char *type;
+        const char *help;
+    } metrics[] = {
+        {"diskroaster_pass", "gauge", "Pass in progress."},
+        {"diskroaster_passes", "gauge", "Number of passes of the run."},
+        {"diskroaster_completed_ratio", "gauge", "Share of the pass that is done."},
+        {"diskroaster_written_bytes", "gauge", "Bytes written in the pass."},
+        {"diskroaster_verified_bytes", "gauge", "Bytes verified in the pass."},
+        {"diskroaster_write_bytes_per_second", "gauge", "Write throughput over the last interval."},
+        {"diskroaster_read_bytes_per_second", "gauge", "Read throughput over the last interval."},
+        {"diskroaster_mismatched_blocks_total", "counter", "Blocks that failed verification."},
+        {"diskroaster_read_errors_total", "counter", "Blocks with unreadable sectors."},
+        {"diskroaster_write_errors_total", "counter", "Blocks with unwritable sectors."},
+        {"diskroaster_bad_sectors", "gauge", "Sectors in the bad-block map."},
+        {"diskroaster_failed", "gauge", "1 if the test of the device stopped on a fatal error."}
+    };
+    const telemetry_device_t *device;
+    worker_stats_t *stats;
+    double values[sizeof(metrics) / sizeof(metrics[0])];
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    fprintf(stream, "# HELP diskroaster_info Run of a device.\n# TYPE diskroaster_info gauge\n");
+
+    for (unsigned int i = 0; i < num_devices; i++) {
+        write_prom_sample(stream, "diskroaster_info", devices[i].name);
+        fprintf(stream, ",run_id=\"%08x\"} 1\n", devices[i].run_id);
+    }
+
+    for (unsigned int m = 0; m < sizeof(metrics) / sizeof(metrics[0]); m++) {
+        fprintf(stream, "# HELP %s %s\n# TYPE %s %s\n", metrics[m].name, metrics[m].help,
+                        metrics[m].name, metrics[m].type);
+
+        for (unsigned int i = 0; i < num_devices; i++) {
+            device = &devices[i];
+            values[0] = device->pass;
+            values[1] = device->num_passes;
+            values[2] = (device->total_bytes > 0) ? (double)(device->written_bytes +
+                                                             device->verified_bytes) /
+                                                    device->total_bytes : 0.0;
+            values[3] = device->written_bytes;
+            values[4] = device->verified_bytes;
+            values[5] = device->write_rate;
+            values[6] = device->read_rate;
+            values[7] = device->mismatched_blocks;
+            values[8] = device->read_errors;
+            values[9] = device->write_errors;
+            values[10] = device->bad_sectors;
+            values[11] = device->failed;
+
+            write_prom_sample(stream, metrics[m].name, device->name);
+            fprintf(stream, "} %.17g\n", values[m]);
+        }
+    }
+
+    fprintf(stream, "# HELP diskroaster_worker_write_bytes_per_second Write throughput of a "
+                    "worker over the last interval.\n"
+                    "# TYPE diskroaster_worker_write_bytes_per_second gauge\n");
+
+    for (unsigned int i = 0; i < num_devices; i++) {
+        for (unsigned int j = 0; j < telemetry->num_workers; j++) {
+            write_prom_sample(stream, "diskroaster_worker_write_bytes_per_second", devices[i].name);
+            fprintf(stream, ",worker=\"%u\"} %.17g\n", j,
+                            rate(stats_get(&devices[i].stats[j].written_bytes),
+                                 telemetry->prev_written[i * telemetry->num_workers + j],
+                                 elapsed_ns) * 1024 * 1024);
+        }
+    }
+
+    fprintf(stream, "# HELP diskroaster_worker_read_bytes_per_second Read throughput of a "
+                    "worker over the last interval.\n"
+                    "# TYPE diskroaster_worker_read_bytes_per_second gauge\n");
+
+    for (unsigned int i = 0; i < num_devices; i++) {
+        for (unsigned int j = 0; j < telemetry->num_workers; j++) {
+            write_prom_sample(stream, "diskroaster_worker_read_bytes_per_second", devices[i].name);
+            fprintf(stream, ",worker=\"%u\"} %.17g\n", j,
+                            rate(stats_get(&devices[i].stats[j].verified_bytes),
+                                 telemetry->prev_verified[i * telemetry->num_workers + j],
+                                 elapsed_ns) * 1024 * 1024);
+        }
+    }
+
+    fprintf(stream, "# HELP diskroaster_worker_latency_seconds Latency of a worker's writes, "
+                    "read-backs and cache flushes in the pass.\n"
+                    "# TYPE diskroaster_worker_latency_seconds gauge\n");
+
+    for (unsigned int i = 0; i < num_devices; i++) {
+        for (unsigned int j = 0; j < telemetry->num_workers; j++) {
+            stats = &devices[i].stats[j];
+            write_prom_latency(stream, devices[i].name, "write", j, &stats->write_latency);
+            write_prom_latency(stream, devices[i].name, "read", j, &stats->read_latency);
+            write_prom_latency(stream, devices[i].name, "flush", j, &stats->flush_latency);
+        }
+    }
+
+    fprintf(stream, "# HELP diskroaster_last_update_timestamp_seconds When the file was written.\n"
+                    "# TYPE diskroaster_last_update_timestamp_seconds gauge\n"
+                    "diskroaster_last_update_timestamp_seconds %lld\n", (long long)now.tv_sec);
+}
+
+static void write_prom_latency(FILE *stream, const char *device_name, const char *op,
+                               unsigned int worker, latency_hist_t *hist)
+{
+    for (unsigned int i = 0; i < NUM_PERCENTILES; i++) {
+        write_prom_sample(stream, "diskroaster_worker_latency_seconds", device_name);
+        fprintf(stream, ",worker=\"%u\",op=\"%s\",quantile=\"%s\"} %.9f\n", worker, op,
+                        quantile_names[i], hist_percentile(hist, percentiles[i]) / 1e9);
+    }
+
+    write_prom_sample(stream, "diskroaster_worker_latency_seconds", device_name);
+    fprintf(stream, ",worker=\"%u\",op=\"%s\",quantile=\"1\"} %.9f\n", worker, op,
+                    stats_get(&hist->max) / 1e9);
+}
+
+/* The start of a sample up to its device label. The caller adds the other labels and the value. */
+static void write_prom_sample(FILE *stream, const char *metric, const char *device_name)
+{
+    fprintf(stream, "%s{device=", metric);
+    write_prom_label(stream, device_name);
+}
+
+/* MB/s since the last record. Counters below the last value belong to a new pass. */
+static double rate(uint64_t bytes, uint64_t prev_bytes, uint64_t elapsed_ns)
+{
+    if (elapsed_ns == 0)
+        return 0.0;
+
+    if (bytes < prev_bytes)
+        prev_bytes = 0;
+
+    return (bytes - prev_bytes) / 1024.0 / 1024.0 / (elapsed_ns / 1e9);
+}
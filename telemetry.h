@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "stats.h"
+
+/*
+ * Machine-readable progress for orchestration and dashboards. Every
+ * second, and once more at the end of every pass, each device gets a
+ * JSON record on a line of its own with its progress, throughput and
+ * errors and the bytes, throughput and latency percentiles of each of its
+ * workers. The records go to a file, an inherited file descriptor or a
+ * Unix stream socket:
+ *
+ *     /path/to/file   appended to, created if needed
+ *     fd:N            file descriptor N, e.g. fd:1 for stdout
+ *     unix:/path      a Unix stream socket that is listening there
+ *
+ * A node_exporter textfile can be kept up to date at the same time. It
+ * is rewritten through a temporary file and a rename, so the exporter
+ * never scrapes a half-written one.
+ *
+ * Telemetry never stops a test: a sink that fails is reported once and
+ * dropped.
+ */
+
+/* A device as it is reported: its progress in the current pass and its totals for the run. */
+typedef struct telemetry_device_t {
+    const char *name;
+    uint32_t run_id;
+    unsigned int pass;
+    unsigned int num_passes;
+    off_t total_bytes;          /* Bytes to write and verify in the pass. */
+    off_t written_bytes;
+    off_t verified_bytes;
+    off_t write_rate;           /* Bytes per second over the last interval. */
+    off_t read_rate;
+    uint64_t mismatched_blocks;
+    uint64_t read_errors;
+    uint64_t write_errors;
+    uint64_t bad_sectors;
+    bool failed;
+    worker_stats_t *stats;      /* Of the current pass. */
+} telemetry_device_t;
+
+typedef struct telemetry_t telemetry_t;
+
+typedef enum {
+    TELEMETRY_CHECK_OK = 0,
+    TELEMETRY_CHECK_ERR_MEM_ALLOC,
+    TELEMETRY_CHECK_ERR_OPEN
+} telemetry_check_t;
+
+telemetry_check_t telemetry_open(telemetry_t**, const char*, const char*, unsigned int,
+                                 unsigned int);
+void telemetry_record(telemetry_t*, const char*, const telemetry_device_t*, unsigned int);
+void telemetry_close(telemetry_t*);
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include "stats.h"
+#include "throttle.h"
+
+/*
+ * Internal functions' prototypes
+ */
+
+static uint64_t bucket_take(throttle_bucket_t*, uint64_t, uint64_t);
+
+/* Limits in bytes and operations per second, 0 for none. Only set while no worker runs. */
+void throttle_set(throttle_t *throttle, uint64_t bytes_per_sec, uint64_t ops_per_sec)
+{
+    uint64_t now_ns = stats_now_ns();
+
+    throttle->bytes.limit = bytes_per_sec;
+    throttle->ops.limit = ops_per_sec;
+    atomic_store_explicit(&throttle->bytes.tat, now_ns, memory_order_relaxed);
+    atomic_store_explicit(&throttle->ops.tat, now_ns, memory_order_relaxed);
+}
+
+/* Take the tokens for a block of len bytes. Returns how long to wait before it may be issued. */
+uint64_t throttle_take(throttle_t *throttle, uint64_t len)
+{
+    uint64_t now_ns;
+    uint64_t wait_ns;
+    uint64_t ops_wait_ns;
+
+    if (throttle->bytes.limit == 0 && throttle->ops.limit == 0)
+        return 0;
+
+    now_ns = stats_now_ns();
+    wait_ns = bucket_take(&throttle->bytes, len, now_ns);
+    ops_wait_ns = bucket_take(&throttle->ops, 1, now_ns);
+
+    return (ops_wait_ns > wait_ns) ? ops_wait_ns : wait_ns;
+}
+
+static uint64_t bucket_take(throttle_bucket_t *bucket, uint64_t units, uint64_t now_ns)
+{
+    uint64_t tat;
+    uint64_t start;
+    uint64_t cost_ns;
+
+    if (bucket->limit == 0)
+        return 0;
+
+    cost_ns = units * 1000000000ULL / bucket->limit;
+    tat = atomic_load_explicit(&bucket->tat, memory_order_relaxed);
+
+    do {
+        start = (tat + THROTTLE_BURST_NS > now_ns) ? tat : now_ns - THROTTLE_BURST_NS;
+    } while (!atomic_compare_exchange_weak_explicit(&bucket->tat, &tat, start + cost_ns,
+                                                    memory_order_relaxed, memory_order_relaxed));
+
+    return (start > now_ns) ? start - now_ns : 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/*
+ * Bandwidth and IOPS limit shared by the workers of a device, so a
+ * burn-in doesn't starve other disks behind the same controller. Both
+ * limits are token buckets kept as a theoretical arrival time (GCRA):
+ * every block moves the time at which the bucket is empty again forward
+ * by what it costs, and its worker waits until that point has come.
+ * Taking tokens is a single compare-and-swap per limit, with no lock.
+ * Unused time of up to THROTTLE_BURST_NS is credited, so short gaps
+ * between blocks don't lower the rate.
+ */
+
+#define THROTTLE_BURST_NS (50 * 1000000ULL)
+
+typedef struct throttle_bucket_t {
+    _Atomic uint64_t tat;       /* When the bucket is empty again, in stats_now_ns() time. */
+    uint64_t limit;             /* Units per second, 0 for no limit. */
+} throttle_bucket_t;
+
+typedef struct throttle_t {
+    throttle_bucket_t bytes;
+    throttle_bucket_t ops;
+} throttle_t;
+
+void throttle_set(throttle_t*, uint64_t, uint64_t);
+uint64_t throttle_take(throttle_t*, uint64_t);
+
+#endif
@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#if defined(__linux__)
+    #define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+    #include <ctype.h>
+    #include <dirent.h>
+    #include <limits.h>
+    #include <pthread.h>
+    #include <sched.h>
+    #include <sys/syscall.h>
+    #include <sys/sysmacros.h>
+    #include <linux/mempolicy.h>
+#endif
+
+#include "topology.h"
+
+#if defined(__linux__)
+
+/* Highest NUMA node number a buffer can be bound to. */
+#define TOPOLOGY_MAX_NODES 1024
+#define BITS_PER_LONG (8 * sizeof(unsigned long))
+
+struct topology_t {
+    int numa_node;              /* -1 if the device has no known node. */
+    unsigned int num_cpu_sets;
+    cpu_set_t *cpu_sets;        /* CPUs of each local hardware queue. */
+};
+
+/*
+ * Internal functions' prototypes
+ */
+
+static bool read_sysfs_line(const char*, char*, size_t);
+static bool parse_cpu_list(const char*, cpu_set_t*);
+static int find_numa_node(const char*);
+static topology_check_t add_cpu_set(topology_t*, cpu_set_t*);
+
+topology_check_t topology_probe(const char *device_name, topology_t **topology_ptr)
+{
+    topology_t *topology;
+    struct stat st;
+    char block_path[PATH_MAX];
+    char path[PATH_MAX + NAME_MAX + 32];
+    char line[4096];
+    char *slash;
+    cpu_set_t node_cpus;
+    cpu_set_t queue_cpus;
+    bool have_node_cpus = false;
+    DIR *dir;
+    struct dirent *entry;
+
+    *topology_ptr = NULL;
+
+    if (stat(device_name, &st) == -1)
+        return TOPOLOGY_CHECK_ERR_STAT;
+
+    if ((topology = calloc(1, sizeof(topology_t))) == NULL)
+        return TOPOLOGY_CHECK_ERR_MEM_ALLOC;
+
+    *topology_ptr = topology;
+    topology->numa_node = -1;
+
+    /* Without a sysfs entry the workers simply stay unpinned. */
+    snprintf(path, sizeof(path), "/sys/dev/block/%u:%u", major(st.st_rdev), minor(st.st_rdev));
+
+    if (realpath(path, block_path) == NULL)
+        return TOPOLOGY_CHECK_OK;
+
+    /* A partition uses the queues of its whole disk. */
+    snprintf(path, sizeof(path), "%s/partition", block_path);
+
+    if (access(path, F_OK) == 0 && (slash = strrchr(block_path, '/')) != NULL)
+        *slash = '\0';
+
+    topology->numa_node = find_numa_node(block_path);
+
+    if (topology->numa_node >= 0) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+                 topology->numa_node);
+        have_node_cpus = read_sysfs_line(path, line, sizeof(line)) &&
+                         parse_cpu_list(line, &node_cpus) && CPU_COUNT(&node_cpus) > 0;
+    }
+
+    /*
+     * Every hardware queue is served by a group of CPUs. Keep the groups
+     * on the device's node, so each worker can be given one of them and
+     * submit through its own queue without leaving the node.
+     */
+    snprintf(path, sizeof(path), "%s/mq", block_path);
+
+    if ((dir = opendir(path)) != NULL) {
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.')
+                continue;
+
+            snprintf(path, sizeof(path), "%s/mq/%s/cpu_list", block_path, entry->d_name);
+
+            if (!read_sysfs_line(path, line, sizeof(line)) || !parse_cpu_list(line, &queue_cpus))
+                continue;
+
+            if (have_node_cpus)
+                CPU_AND(&queue_cpus, &queue_cpus, &node_cpus);
+
+            if (CPU_COUNT(&queue_cpus) == 0)
+                continue;
+
+            if (add_cpu_set(topology, &queue_cpus) != TOPOLOGY_CHECK_OK) {
+                closedir(dir);
+                return TOPOLOGY_CHECK_ERR_MEM_ALLOC;
+            }
+        }
+
+        closedir(dir);
+    }
+
+    /* No hardware queue information: any CPU of the node will do. */
+    if (topology->num_cpu_sets == 0 && have_node_cpus)
+        return add_cpu_set(topology, &node_cpus);
+
+    return TOPOLOGY_CHECK_OK;
+}
+
+int topology_numa_node(topology_t *topology)
+{
+    return (topology != NULL) ? topology->numa_node : -1;
+}
+
+unsigned int topology_num_cpu_sets(topology_t *topology)
+{
+    return (topology != NULL) ? topology->num_cpu_sets : 0;
+}
+
+/* Pin the calling worker thread to the CPUs of one of the local hardware queues. */
+bool topology_bind_worker(topology_t *topology, unsigned int worker)
+{
+    if (topology == NULL || topology->num_cpu_sets == 0)
+        return false;
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                                  &topology->cpu_sets[worker % topology->num_cpu_sets]) == 0;
+}
+
+/*
+ * Ask for the pages of a not yet touched, page-aligned buffer to come from
+ * the device's node. It is only a hint, so a failure is not an error.
+ */
+void topology_bind_memory(topology_t *topology, void *addr, size_t len)
+{
+    unsigned long nodemask[TOPOLOGY_MAX_NODES / BITS_PER_LONG] = {0};
+    int node = topology_numa_node(topology);
+
+    if (node < 0 || node >= TOPOLOGY_MAX_NODES)
+        return;
+
+    nodemask[node / BITS_PER_LONG] |= 1UL << (node % BITS_PER_LONG);
+
+    syscall(SYS_mbind, addr, len, MPOL_PREFERRED, nodemask, TOPOLOGY_MAX_NODES + 1, 0);
+}
+
+void topology_destroy(topology_t *topology)
+{
+    if (topology == NULL)
+        return;
+
+    free(topology->cpu_sets);
+    free(topology);
+}
+
+static bool read_sysfs_line(const char *path, char *line, size_t size)
+{
+    FILE *file;
+    bool result;
+
+    if ((file = fopen(path, "r")) == NULL)
+        return false;
+
+    result = fgets(line, size, file) != NULL;
+    fclose(file);
+
+    return result;
+}
+
+/* Parse both "0-3,8-11" node lists and "0, 1, 2" hardware queue lists. */
+static bool parse_cpu_list(const char *list, cpu_set_t *set)
+{
+    const char *pos = list;
+    char *end;
+    unsigned long first;
+    unsigned long last;
+
+    CPU_ZERO(set);
+
+    for (;;) {
+        while (*pos == ',' || isspace((unsigned char)*pos))
+            pos++;
+
+        if (*pos == '\0')
+            return true;
+
+        first = strtoul(pos, &end, 10);
+
+        if (end == pos)
+            return false;
+
+        last = first;
+        pos = end;
+
+        if (*pos == '-') {
+            last = strtoul(pos + 1, &end, 10);
+
+            if (end == pos + 1 || last < first)
+                return false;
+
+            pos = end;
+        }
+
+        for (unsigned long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, set);
+    }
+}
+
+/*
+ * The node is a property of the controller, so walk up from the block
+ * device through its parents (e.g. SCSI target, HBA, PCI function) until
+ * one of them reports a node.
+ */
+static int find_numa_node(const char *block_path)
+{
+    char dev_path[PATH_MAX];
+    char path[PATH_MAX + 16];
+    char line[32];
+    char *slash;
+    int node;
+
+    snprintf(path, sizeof(path), "%s/device", block_path);
+
+    if (realpath(path, dev_path) == NULL)
+        return -1;
+
+    while (strcmp(dev_path, "/sys/devices") != 0) {
+        snprintf(path, sizeof(path), "%s/numa_node", dev_path);
+
+        if (read_sysfs_line(path, line, sizeof(line)) && (node = atoi(line)) >= 0)
+            return node;
+
+        if ((slash = strrchr(dev_path, '/')) == NULL || slash == dev_path)
+            break;
+
+        *slash = '\0';
+    }
+
+    return -1;
+}
+
+static topology_check_t add_cpu_set(topology_t *topology, cpu_set_t *set)
+{
+    cpu_set_t *cpu_sets;
+
+    /* Queues that share the same CPUs need no separate entry. */
+    for (unsigned int i = 0; i < topology->num_cpu_sets; i++) {
+        if (CPU_EQUAL(&topology->cpu_sets[i], set))
+            return TOPOLOGY_CHECK_OK;
+    }
+
+    cpu_sets = realloc(topology->cpu_sets, (topology->num_cpu_sets + 1) * sizeof(cpu_set_t));
+
+    if (cpu_sets == NULL)
+        return TOPOLOGY_CHECK_ERR_MEM_ALLOC;
+
+    cpu_sets[topology->num_cpu_sets++] = *set;
+    topology->cpu_sets = cpu_sets;
+
+    return TOPOLOGY_CHECK_OK;
+}
+
+#else
+
+topology_check_t topology_probe(const char *device_name, topology_t **topology_ptr)
+{
+    (void)device_name;
+
+    *topology_ptr = NULL;
+
+    return TOPOLOGY_CHECK_ERR_UNSUPPORTED;
+}
+
+int topology_numa_node(topology_t *topology)
+{
+    (void)topology;
+
+    return -1;
+}
+
+unsigned int topology_num_cpu_sets(topology_t *topology)
+{
+    (void)topology;
+
+    return 0;
+}
+
+bool topology_bind_worker(topology_t *topology, unsigned int worker)
+{
+    (void)topology;
+    (void)worker;
+
+    return false;
+}
+
+void topology_bind_memory(topology_t *topology, void *addr, size_t len)
+{
+    (void)topology;
+    (void)addr;
+    (void)len;
+}
+
+void topology_destroy(topology_t *topology)
+{
+    (void)topology;
+}
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Where a disk device sits in the machine: the NUMA node of its controller
+ * and the CPUs that submit to its blk-mq hardware queues, as found in
+ * sysfs. Workers are pinned to those CPUs and their I/O buffers are placed
+ * on that node, so on multi-socket hosts no I/O crosses the interconnect.
+ * Only Linux exposes this information; elsewhere topology_probe() fails
+ * with TOPOLOGY_CHECK_ERR_UNSUPPORTED and workers run unpinned.
+ */
+
+typedef struct topology_t topology_t;
+
+typedef enum {
+    TOPOLOGY_CHECK_OK = 0,
+    TOPOLOGY_CHECK_ERR_UNSUPPORTED,
+    TOPOLOGY_CHECK_ERR_STAT,
+    TOPOLOGY_CHECK_ERR_MEM_ALLOC
+} topology_check_t;
+
+topology_check_t topology_probe(const char*, topology_t**);
+int topology_numa_node(topology_t*);
+unsigned int topology_num_cpu_sets(topology_t*);
+bool topology_bind_worker(topology_t*, unsigned int);
+void topology_bind_memory(topology_t*, void*, size_t);
+void topology_destroy(topology_t*);
+
+#endif
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "crc32c.h"
+#include "journal.h"
+#include "undo.h"
+#include "utils.h"
+
+/* Headers take a whole page, so the saved data stays page aligned in the file. */
+#define UNDO_HEADER_SIZE 4096
+
+#define SLOT_POSITION(slot_size, slot) \
+    (UNDO_HEADER_SIZE + (off_t)(slot) * (UNDO_HEADER_SIZE + (off_t)(slot_size)))
+
+/* Start of the file: which disk the log belongs to and how its slots are laid out. */
+typedef struct undo_file_header_t {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t crc;           /* Of this header with this field zeroed. */
+    uint64_t disk_size;
+    uint64_t slot_size;
+    uint32_t num_slots;
+    uint32_t reserved;
+} undo_file_header_t;
+
+/* Start of a slot, followed by the saved data. A cleared slot is all zeros. */
+typedef struct undo_record_t {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t crc;           /* Of this header with this field zeroed, then of the data. */
+    uint64_t offset;
+    uint64_t len;
+} undo_record_t;
+
+struct undo_t {
+    int fd;
+    unsigned int num_slots;
+    size_t slot_size;       /* Largest batch a slot holds. */
+};
+
+/*
+ * Internal functions' prototypes
+ */
+
+static uint32_t record_crc(const undo_record_t*, const char*);
+static bool pread_all(int, void*, size_t, off_t);
+
+/*
+ * The log holds copies of user data, so only root may read it. It is
+ * sized once, so saving a batch never has to extend the file.
+ */
+undo_check_t undo_create(undo_t **undo_ptr, const char *path, off_t disk_size,
+                         unsigned int num_slots, size_t slot_size)
+{
+    undo_file_header_t header;
+    undo_t *undo;
+
+    if ((*undo_ptr = undo = malloc(sizeof(undo_t))) == NULL)
+        return UNDO_CHECK_ERR_MEM_ALLOC;
+
+    undo->num_slots = num_slots;
+    undo->slot_size = slot_size;
+
+    if ((undo->fd = open(path, O_RDWR|O_CREAT|O_TRUNC, 0600)) == -1) {
+        free(undo);
+        *undo_ptr = NULL;
+        return UNDO_CHECK_ERR_IO;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = UNDO_MAGIC;
+    header.version = UNDO_VERSION;
+    header.disk_size = (uint64_t)disk_size;
+    header.slot_size = (uint64_t)slot_size;
+    header.num_slots = num_slots;
+    header.crc = crc32c(0, &header, sizeof(header));
+
+    if (ftruncate(undo->fd, SLOT_POSITION(slot_size, num_slots)) == -1 ||
+        !write_all(undo->fd, &header, sizeof(header), 0) || fsync(undo->fd) == -1) {
+        close(undo->fd);
+        unlink(path);
+        free(undo);
+        *undo_ptr = NULL;
+        return UNDO_CHECK_ERR_IO;
+    }
+
+    journal_sync_dir(path);
+
+    return UNDO_CHECK_OK;
+}
+
+/*
+ * Save the original data of a batch in the slot. It is on stable storage
+ * when this returns, so the batch may be overwritten from then on.
+ */
+undo_check_t undo_save(undo_t *undo, unsigned int slot, off_t offset, const char *data,
+                       size_t len)
+{
+    undo_record_t record;
+    off_t position = SLOT_POSITION(undo->slot_size, slot);
+
+    memset(&record, 0, sizeof(record));
+    record.magic = UNDO_MAGIC;
+    record.version = UNDO_VERSION;
+    record.offset = (uint64_t)offset;
+    record.len = (uint64_t)len;
+    record.crc = record_crc(&record, data);
+
+    if (!write_all(undo->fd, data, len, position + UNDO_HEADER_SIZE) ||
+        !write_all(undo->fd, &record, sizeof(record), position) || fdatasync(undo->fd) == -1)
+        return UNDO_CHECK_ERR_IO;
+
+    return UNDO_CHECK_OK;
+}
+
+/*
+ * The batch of the slot has its original data back. The clear is not
+ * synced: replaying the record after a crash writes the same data again.
+ */
+void undo_clear(undo_t *undo, unsigned int slot)
+{
+    undo_record_t record;
+
+    memset(&record, 0, sizeof(record));
+    write_all(undo->fd, &record, sizeof(record), SLOT_POSITION(undo->slot_size, slot));
+}
+
+/* The file stays; undo_replay() puts back what is left in it and removes it. */
+void undo_close(undo_t *undo)
+{
+    if (undo == NULL)
+        return;
+
+    close(undo->fd);
+    free(undo);
+}
+
+/*
+ * Write every valid record of the log at path back to the device, flush
+ * the device and remove the log. The log is kept if anything fails, so
+ * the data can still be restored later.
+ */
+undo_check_t undo_replay(const char *path, const char *device_name, off_t disk_size,
+                         unsigned int *num_restored)
+{
+    undo_file_header_t header;
+    undo_record_t record;
+    uint32_t crc;
+    char *buffer;
+    off_t position;
+    int fd;
+    int device_fd = -1;
+    undo_check_t result = UNDO_CHECK_OK;
+
+    *num_restored = 0;
+
+    if ((fd = open(path, O_RDONLY)) == -1)
+        return (errno == ENOENT) ? UNDO_CHECK_ERR_NOT_FOUND : UNDO_CHECK_ERR_IO;
+
+    if (!pread_all(fd, &header, sizeof(header), 0)) {
+        close(fd);
+        return UNDO_CHECK_ERR_CORRUPT;
+    }
+
+    crc = header.crc;
+    header.crc = 0;
+
+    if (header.magic != UNDO_MAGIC || header.version != UNDO_VERSION ||
+        crc32c(0, &header, sizeof(header)) != crc || header.disk_size != (uint64_t)disk_size) {
+        close(fd);
+        return UNDO_CHECK_ERR_CORRUPT;
+    }
+
+    if ((buffer = malloc(header.slot_size)) == NULL) {
+        close(fd);
+        return UNDO_CHECK_ERR_MEM_ALLOC;
+    }
+
+    for (unsigned int slot = 0; slot < header.num_slots; slot++) {
+        position = SLOT_POSITION(header.slot_size, slot);
+
+        if (!pread_all(fd, &record, sizeof(record), position)) {
+            result = UNDO_CHECK_ERR_IO;
+            break;
+        }
+
+        if (record.magic != UNDO_MAGIC || record.len == 0 || record.len > header.slot_size ||
+            record.offset > header.disk_size || record.len > header.disk_size - record.offset)
+            continue;
+
+        if (!pread_all(fd, buffer, record.len, position + UNDO_HEADER_SIZE)) {
+            result = UNDO_CHECK_ERR_IO;
+            break;
+        }
+
+        /* A record torn while it was saved belongs to a batch that was never overwritten. */
+        if (record_crc(&record, buffer) != record.crc)
+            continue;
+
+        if (device_fd == -1 && (device_fd = open(device_name, O_WRONLY)) == -1) {
+            result = UNDO_CHECK_ERR_IO;
+            break;
+        }
+
+        if (!write_all(device_fd, buffer, record.len, (off_t)record.offset)) {
+            result = UNDO_CHECK_ERR_IO;
+            break;
+        }
+
+        (*num_restored)++;
+    }
+
+    if (result == UNDO_CHECK_OK && device_fd != -1 && fsync(device_fd) == -1)
+        result = UNDO_CHECK_ERR_IO;
+
+    if (device_fd != -1)
+        close(device_fd);
+
+    close(fd);
+    free(buffer);
+
+    if (result == UNDO_CHECK_OK)
+        journal_remove(path);
+
+    return result;
+}
+
+static uint32_t record_crc(const undo_record_t *record, const char *data)
+{
+    undo_record_t header = *record;
+
+    header.crc = 0;
+
+    return crc32c(crc32c(0, &header, sizeof(header)), data, record->len);
+}
+
+/* Reading past the end of the file counts as a failure. */
+static bool pread_all(int fd, void *buffer, size_t size, off_t offset)
+{
+    char *data = buffer;
+    ssize_t bytes;
+
+    while (size > 0) {
+        if ((bytes = pread(fd, data, size, offset)) == -1) {
+            if (errno == EINTR)
+                continue;
+
+            return false;
+        }
+
+        if (bytes == 0)
+            return false;
+
+        data += bytes;
+        size -= bytes;
+        offset += bytes;
+    }
+
+    return true;
+}
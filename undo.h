@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef UNDO_H
+#define UNDO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Undo log of a non-destructive run. Every worker owns one slot of it.
+ * Before a worker overwrites a batch of the disk with test data, it saves
+ * the original data of the batch in its slot and syncs the log; once the
+ * original data has been written back and flushed to the disk, the slot
+ * is cleared again. A batch is only overwritten while its original data
+ * is safe in the log, so after a crash or power loss undo_replay() puts
+ * back everything that was on the disk.
+ *
+ * A record is only valid when its CRC32C over the header and the data
+ * matches, so a record torn by a crash while it was being saved is
+ * ignored: its batch had not been touched yet.
+ */
+
+#define UNDO_MAGIC 0x4f444e554b534944ULL    /* "DISKUNDO" */
+#define UNDO_VERSION 1
+#define UNDO_SUFFIX ".undo"
+
+typedef struct undo_t undo_t;
+
+typedef enum {
+    UNDO_CHECK_OK = 0,
+    UNDO_CHECK_ERR_MEM_ALLOC,
+    UNDO_CHECK_ERR_NOT_FOUND,
+    UNDO_CHECK_ERR_IO,
+    UNDO_CHECK_ERR_CORRUPT
+} undo_check_t;
+
+undo_check_t undo_create(undo_t**, const char*, off_t, unsigned int, size_t);
+undo_check_t undo_save(undo_t*, unsigned int, off_t, const char*, size_t);
+void undo_clear(undo_t*, unsigned int);
+void undo_close(undo_t*);
+undo_check_t undo_replay(const char*, const char*, off_t, unsigned int*);
+
+#endif
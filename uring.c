@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "uring.h"
+
+#if defined(HAVE_IO_URING)
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* Older C libraries lack the syscall numbers; they are the same on all modern ABIs. */
+#ifndef __NR_io_uring_setup
+    #define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+    #define __NR_io_uring_enter 426
+#endif
+#ifndef __NR_io_uring_register
+    #define __NR_io_uring_register 427
+#endif
+
+struct uring_t {
+    int ring_fd;
+    int fixed_fd;
+    unsigned int entries;
+
+    /* Submission queue ring, shared with the kernel. */
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_mask;
+    unsigned int *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned int sqe_tail;
+    unsigned int to_submit;
+
+    /* Completion queue ring, shared with the kernel. */
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ptr;
+    void *cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    size_t sqes_size;
+};
+
+static inline int sys_io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int sys_io_uring_enter(int fd, unsigned int to_submit,
+                                     unsigned int min_complete, unsigned int flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static inline int sys_io_uring_register(int fd, unsigned int opcode,
+                                        const void *arg, unsigned int nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+int uring_init(uring_t **ring_ptr, unsigned int entries)
+{
+    struct io_uring_params params;
+    uring_t *ring;
+    int local_errno;
+
+    if ((ring = calloc(1, sizeof(uring_t))) == NULL)
+        return -ENOMEM;
+
+    memset(&params, 0, sizeof(params));
+
+    if ((ring->ring_fd = sys_io_uring_setup(entries, &params)) == -1) {
+        local_errno = errno;
+        free(ring);
+        return -local_errno;
+    }
+
+    ring->fixed_fd = -1;
+    ring->entries = params.sq_entries;
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    /* Since 5.4 both rings live in one mapping. */
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_size > ring->sq_size)
+            ring->sq_size = ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+                        ring->ring_fd, IORING_OFF_SQ_RING);
+
+    if (ring->sq_ptr == MAP_FAILED)
+        goto err_mmap;
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+                            ring->ring_fd, IORING_OFF_CQ_RING);
+
+        if (ring->cq_ptr == MAP_FAILED) {
+            ring->cq_ptr = NULL;
+            goto err_mmap;
+        }
+    }
+
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+                      ring->ring_fd, IORING_OFF_SQES);
+
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        goto err_mmap;
+    }
+
+    ring->sq_head = (unsigned int*)((char*)ring->sq_ptr + params.sq_off.head);
+    ring->sq_tail = (unsigned int*)((char*)ring->sq_ptr + params.sq_off.tail);
+    ring->sq_mask = (unsigned int*)((char*)ring->sq_ptr + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned int*)((char*)ring->sq_ptr + params.sq_off.array);
+    ring->sqe_tail = *ring->sq_tail;
+
+    ring->cq_head = (unsigned int*)((char*)ring->cq_ptr + params.cq_off.head);
+    ring->cq_tail = (unsigned int*)((char*)ring->cq_ptr + params.cq_off.tail);
+    ring->cq_mask = (unsigned int*)((char*)ring->cq_ptr + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)((char*)ring->cq_ptr + params.cq_off.cqes);
+
+    *ring_ptr = ring;
+
+    return 0;
+
+err_mmap:
+    local_errno = errno;
+
+    if (ring->sq_ptr == MAP_FAILED)
+        ring->sq_ptr = NULL;
+
+    uring_destroy(ring);
+
+    return -local_errno;
+}
+
+int uring_register_buffers(uring_t *ring, const struct iovec *iov, unsigned int nr_iov)
+{
+    if (sys_io_uring_register(ring->ring_fd, IORING_REGISTER_BUFFERS, iov, nr_iov) == -1)
+        return -errno;
+
+    return 0;
+}
+
+int uring_register_file(uring_t *ring, int fd)
+{
+    if (sys_io_uring_register(ring->ring_fd, IORING_REGISTER_FILES, &fd, 1) == -1)
+        return -errno;
+
+    ring->fixed_fd = fd;
+
+    return 0;
+}
+
+int uring_prep_rw(
+    uring_t *ring,
+    bool write,
+    int fd,
+    int buf_index,
+    void *buf,
+    size_t len,
+    off_t offset,
+    int rw_flags,
+    unsigned long long user_data
+) {
+    struct io_uring_sqe *sqe;
+    unsigned int head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned int index;
+
+    if (ring->sqe_tail - head >= ring->entries)
+        return -EBUSY;
+
+    index = ring->sqe_tail & *ring->sq_mask;
+    sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+
+    if (buf_index >= 0) {
+        sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = buf_index;
+    } else {
+        sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+
+    /* A registered file is addressed by its index in the file table. */
+    if (fd == ring->fixed_fd) {
+        sqe->fd = 0;
+        sqe->flags |= IOSQE_FIXED_FILE;
+    } else {
+        sqe->fd = fd;
+    }
+
+    sqe->addr = (unsigned long long)(uintptr_t)buf;
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->rw_flags = rw_flags;
+    sqe->user_data = user_data;
+
+    ring->sq_array[index] = index;
+    ring->sqe_tail++;
+    ring->to_submit++;
+
+    return 0;
+}
+
+int uring_submit(uring_t *ring, unsigned int wait_nr)
+{
+    unsigned int flags = (wait_nr > 0) ? IORING_ENTER_GETEVENTS : 0;
+    int submitted;
+
+    if (ring->to_submit == 0 && wait_nr == 0)
+        return 0;
+
+    /* Publish the new SQEs before the kernel looks at the tail. */
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+
+    do {
+        submitted = sys_io_uring_enter(ring->ring_fd, ring->to_submit, wait_nr, flags);
+    } while (submitted == -1 && errno == EINTR);
+
+    if (submitted == -1)
+        return -errno;
+
+    ring->to_submit -= (unsigned int)submitted;
+
+    return submitted;
+}
+
+bool uring_peek_cqe(uring_t *ring, uring_cqe_t *cqe)
+{
+    unsigned int head = *ring->cq_head;
+    struct io_uring_cqe *kcqe;
+
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+        return false;
+
+    kcqe = &ring->cqes[head & *ring->cq_mask];
+    cqe->user_data = kcqe->user_data;
+    cqe->res = kcqe->res;
+
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+void uring_destroy(uring_t *ring)
+{
+    if (ring == NULL)
+        return;
+
+    if (ring->sqes != NULL)
+        munmap(ring->sqes, ring->sqes_size);
+
+    if (ring->cq_ptr != NULL && ring->cq_ptr != ring->sq_ptr)
+        munmap(ring->cq_ptr, ring->cq_size);
+
+    if (ring->sq_ptr != NULL)
+        munmap(ring->sq_ptr, ring->sq_size);
+
+    close(ring->ring_fd);
+    free(ring);
+}
+
+#else
+
+/* io_uring is Linux-only; every entry point reports it as unsupported. */
+
+int uring_init(uring_t **ring_ptr, unsigned int entries)
+{
+    (void)ring_ptr;
+    (void)entries;
+
+    return -ENOSYS;
+}
+
+int uring_register_buffers(uring_t *ring, const struct iovec *iov, unsigned int nr_iov)
+{
+    (void)ring;
+    (void)iov;
+    (void)nr_iov;
+
+    return -ENOSYS;
+}
+
+int uring_register_file(uring_t *ring, int fd)
+{
+    (void)ring;
+    (void)fd;
+
+    return -ENOSYS;
+}
+
+int uring_prep_rw(
+    uring_t *ring,
+    bool write,
+    int fd,
+    int buf_index,
+    void *buf,
+    size_t len,
+    off_t offset,
+    int rw_flags,
+    unsigned long long user_data
+) {
+    (void)ring;
+    (void)write;
+    (void)fd;
+    (void)buf_index;
+    (void)buf;
+    (void)len;
+    (void)offset;
+    (void)rw_flags;
+    (void)user_data;
+
+    return -ENOSYS;
+}
+
+int uring_submit(uring_t *ring, unsigned int wait_nr)
+{
+    (void)ring;
+    (void)wait_nr;
+
+    return -ENOSYS;
+}
+
+bool uring_peek_cqe(uring_t *ring, uring_cqe_t *cqe)
+{
+    (void)ring;
+    (void)cqe;
+
+    return false;
+}
+
+void uring_destroy(uring_t *ring)
+{
+    (void)ring;
+}
+
+#endif
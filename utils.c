@@ -28,6 +28,7 @@
  * OF SUCH DAMAGE.
  */
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
@@ -107,6 +108,39 @@ utils_check_t get_size_in_bytes(const char *str_size, unsigned int *value)
     return UTILS_CHECK_OK;
 }
 
+/* Same as get_size_in_bytes() for sizes beyond 4 GB, with a g suffix as well. */
+utils_check_t get_large_size_in_bytes(const char *str_size, off_t *value)
+{
+    char *unit_suffix = NULL;
+
+    *value = strtoll(str_size, &unit_suffix, 10);
+
+    if (*value > 0 && *unit_suffix == '\0') {
+        return UTILS_CHECK_OK;
+    } else if (*value <= 0 || *(unit_suffix + 1) != '\0') {
+        return UTILS_CHECK_ERR_NAN;
+    } else {
+        switch (*unit_suffix) {
+            case 'k':
+            case 'K':
+                *value *= 1024;
+                break;
+            case 'm':
+            case 'M':
+                *value *= 1048576;
+                break;
+            case 'g':
+            case 'G':
+                *value *= 1073741824;
+                break;
+            default:
+                return UTILS_CHECK_ERR_UNKNOWN_UNIT;
+        }
+    }
+
+    return UTILS_CHECK_OK;
+}
+
 utils_check_t str_to_uint(const char *str_value, unsigned int *value)
 {
     char *strtol_endptr = NULL;
@@ -116,6 +150,17 @@ utils_check_t str_to_uint(const char *str_value, unsigned int *value)
     return (*value <= 0 || *strtol_endptr != '\0') ? UTILS_CHECK_ERR_NAN : UTILS_CHECK_OK;
 }
 
+/* A size the way -b takes it: 4m, 256k or plain bytes. */
+void format_size(char *buffer, size_t size, unsigned int bytes)
+{
+    if (bytes % (1024 * 1024) == 0)
+        snprintf(buffer, size, "%um", bytes / 1024 / 1024);
+    else if (bytes % 1024 == 0)
+        snprintf(buffer, size, "%uk", bytes / 1024);
+    else
+        snprintf(buffer, size, "%u", bytes);
+}
+
 void get_eta(char *eta, off_t verified_bytes, off_t disk_size)
 {
     static off_t verified_bytes_prev = 0;
@@ -158,14 +203,75 @@ void get_eta(char *eta, off_t verified_bytes, off_t disk_size)
     return;
 }
 
-void fill_random_data(char *ptr_data, unsigned int data_size)
+uint32_t generate_run_id(void)
 {
+    struct timespec ts;
+
+    /* Two runs started within the same second still get different IDs. */
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (uint32_t)ts.tv_sec ^ ((uint32_t)ts.tv_nsec << 2) ^ ((uint32_t)getpid() << 16);
+}
+
+/*
+ * Write all of the buffer, at the offset or at the current position of
+ * the file if it is negative. A write may be cut short by a signal.
+ */
+bool write_all(int fd, const void *buffer, size_t size, off_t offset)
+{
+    const char *data = buffer;
+    ssize_t written;
+
+    while (size > 0) {
+        written = (offset < 0) ? write(fd, data, size) : pwrite(fd, data, size, offset);
+
+        if (written == -1) {
+            if (errno == EINTR)
+                continue;
+
+            return false;
+        }
 
-    srand(time(NULL));
+        data += written;
+        size -= written;
 
-    for (unsigned int i = 0; i < data_size; i++) {
-        /* Generate random ASCII character. */
-        *(ptr_data + i) = rand() % 128;
+        if (offset >= 0)
+            offset += written;
     }
+
+    return true;
 }
 
+/* A quoted JSON string, e.g. a device name that may hold quotes or backslashes. */
+void write_json_string(FILE *stream, const char *string)
+{
+    fputc('"', stream);
+
+    for (; *string != '\0'; string++) {
+        if (*string == '"' || *string == '\\')
+            fprintf(stream, "\\%c", *string);
+        else if ((unsigned char)*string < 0x20)
+            fprintf(stream, "\\u%04x", (unsigned char)*string);
+        else
+            fputc(*string, stream);
+    }
+
+    fputc('"', stream);
+}
+
+/* A quoted label value of the Prometheus text format, which escapes only these three. */
+void write_prom_label(FILE *stream, const char *string)
+{
+    fputc('"', stream);
+
+    for (; *string != '\0'; string++) {
+        if (*string == '"' || *string == '\\')
+            fprintf(stream, "\\%c", *string);
+        else if (*string == '\n')
+            fputs("\\n", stream);
+        else
+            fputc(*string, stream);
+    }
+
+    fputc('"', stream);
+}
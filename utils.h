@@ -31,6 +31,11 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
 typedef enum {
     UTILS_CHECK_OK = 0,
     UTILS_CHECK_ERR_UNKNOWN_UNIT,
@@ -40,9 +45,14 @@ typedef enum {
 
 bool display_prompt(void);
 utils_check_t get_size_in_bytes(const char*, unsigned int*);
+utils_check_t get_large_size_in_bytes(const char*, off_t*);
 utils_check_t str_to_uint(const char*, unsigned int*);
+void format_size(char*, size_t, unsigned int);
 void get_eta(char*, off_t, off_t);
-void fill_random_data(char*, unsigned int);
+uint32_t generate_run_id(void);
+bool write_all(int, const void*, size_t, off_t);
+void write_json_string(FILE*, const char*);
+void write_prom_label(FILE*, const char*);
 
 #endif
 
@@ -0,0 +1,512 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #include <immintrin.h>
+    #define HAVE_VERIFY_X86 1
+#endif
+
+#include "verify.h"
+
+typedef void (*fill_fn_t)(uint64_t*, char*, size_t);
+typedef bool (*compare_fn_t)(uint64_t*, const char*, size_t, size_t, size_t);
+typedef bool (*is_byte_fn_t)(const char*, size_t, uint8_t);
+
+static pthread_once_t verify_once = PTHREAD_ONCE_INIT;
+static fill_fn_t fill_fn;
+static compare_fn_t compare_fn;
+static is_byte_fn_t is_byte_fn;
+static const char *verify_name;
+
+/*
+ * Internal functions' prototypes
+ */
+
+static void verify_init(void);
+static inline uint64_t xorshift64(uint64_t);
+static void fill_c(uint64_t*, char*, size_t);
+static bool compare_c(uint64_t*, const char*, size_t, size_t, size_t);
+static bool is_byte_c(const char*, size_t, uint8_t);
+
+void verify_stream_init(verify_stream_t *stream, uint32_t seed)
+{
+    uint64_t state = seed;
+    uint64_t z;
+
+    /* SplitMix64 spreads the 32-bit seed over four non-zero generator states. */
+    for (int i = 0; i < 4; i++) {
+        z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z ^= z >> 31;
+        stream->lanes[i] = (z != 0) ? z : 0x2545f4914f6cdd1dULL;
+    }
+}
+
+/* Any length: a partial last step is cut short. */
+void verify_stream_fill(verify_stream_t *stream, char *buffer, size_t len)
+{
+    char tail[VERIFY_STEP_SIZE];
+
+    pthread_once(&verify_once, verify_init);
+
+    fill_fn(stream->lanes, buffer, len / VERIFY_STEP_SIZE);
+
+    if (len % VERIFY_STEP_SIZE != 0) {
+        fill_c(stream->lanes, tail, 1);
+        memcpy(buffer + len - len % VERIFY_STEP_SIZE, tail, len % VERIFY_STEP_SIZE);
+    }
+}
+
+/* Lengths passed to the functions below are multiples of VERIFY_STEP_SIZE. */
+
+void verify_stream_skip(verify_stream_t *stream, size_t len)
+{
+    for (size_t step = 0; step < len / VERIFY_STEP_SIZE; step++) {
+        for (int i = 0; i < 4; i++)
+            stream->lanes[i] = xorshift64(stream->lanes[i]);
+    }
+}
+
+bool verify_stream_compare(verify_stream_t *stream, const char *buffer, size_t len)
+{
+    return verify_stream_compare_sectors(stream, buffer, len, 0, 1);
+}
+
+/*
+ * Compare num_sectors consecutive sectors in one go. The first skip bytes
+ * of every sector (its tag) are not compared, though the stream still
+ * advances over them.
+ */
+bool verify_stream_compare_sectors(
+    verify_stream_t *stream,
+    const char *buffer,
+    size_t sector_size,
+    size_t skip,
+    size_t num_sectors
+) {
+    pthread_once(&verify_once, verify_init);
+
+    return compare_fn(stream->lanes, buffer, sector_size / VERIFY_STEP_SIZE,
+                      skip / VERIFY_STEP_SIZE, num_sectors);
+}
+
+/* The slow path behind a failed compare: how many bits differ. */
+uint64_t verify_stream_flips(verify_stream_t *stream, const char *buffer, size_t len)
+{
+    uint64_t word;
+    uint64_t flips = 0;
+
+    for (size_t pos = 0; pos < len; pos += VERIFY_STEP_SIZE) {
+        for (int i = 0; i < 4; i++) {
+            stream->lanes[i] = xorshift64(stream->lanes[i]);
+            memcpy(&word, buffer + pos + i * sizeof(uint64_t), sizeof(word));
+            flips += __builtin_popcountll(word ^ stream->lanes[i]);
+        }
+    }
+
+    return flips;
+}
+
+/* Whether every byte is byte, the check of the fixed data patterns. */
+bool verify_is_byte(const char *buffer, size_t len, uint8_t byte)
+{
+    pthread_once(&verify_once, verify_init);
+
+    return is_byte_fn(buffer, len, byte);
+}
+
+uint64_t verify_byte_flips(const char *buffer, size_t len, uint8_t byte)
+{
+    uint64_t flips = 0;
+
+    for (size_t pos = 0; pos < len; pos++)
+        flips += __builtin_popcount((unsigned char)buffer[pos] ^ byte);
+
+    return flips;
+}
+
+const char *verify_impl_name(void)
+{
+    pthread_once(&verify_once, verify_init);
+
+    return verify_name;
+}
+
+static inline uint64_t xorshift64(uint64_t x)
+{
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+
+    return x;
+}
+
+static void fill_c(uint64_t *lanes, char *buffer, size_t steps)
+{
+    for (size_t step = 0; step < steps; step++, buffer += VERIFY_STEP_SIZE) {
+        for (int i = 0; i < 4; i++)
+            lanes[i] = xorshift64(lanes[i]);
+
+        memcpy(buffer, lanes, VERIFY_STEP_SIZE);
+    }
+}
+
+static bool compare_c(
+    uint64_t *lanes,
+    const char *buffer,
+    size_t sector_steps,
+    size_t skip_steps,
+    size_t num_sectors
+) {
+    uint64_t word;
+    uint64_t diff = 0;
+
+    for (size_t sector = 0; sector < num_sectors; sector++) {
+        for (size_t step = 0; step < sector_steps; step++, buffer += VERIFY_STEP_SIZE) {
+            for (int i = 0; i < 4; i++) {
+                lanes[i] = xorshift64(lanes[i]);
+
+                if (step >= skip_steps) {
+                    memcpy(&word, buffer + i * sizeof(uint64_t), sizeof(word));
+                    diff |= word ^ lanes[i];
+                }
+            }
+        }
+    }
+
+    return diff == 0;
+}
+
+/* The fixed-byte kernels OR together the XOR of every word with the byte repeated. */
+static bool is_byte_c(const char *buffer, size_t len, uint8_t byte)
+{
+    uint64_t word;
+    uint64_t fill = 0x0101010101010101ULL * byte;
+    uint64_t bits = 0;
+    size_t pos = 0;
+
+    for (; pos + sizeof(word) <= len; pos += sizeof(word)) {
+        memcpy(&word, buffer + pos, sizeof(word));
+        bits |= word ^ fill;
+    }
+
+    for (; pos < len; pos++)
+        bits |= (unsigned char)buffer[pos] ^ byte;
+
+    return bits == 0;
+}
+
+#if defined(HAVE_VERIFY_X86)
+
+/*
+ * A generator step on vectors of 64-bit lanes. Every kernel keeps the
+ * stream in registers and writes the lanes back when it is done, since
+ * the state of a generator is its last output.
+ */
+
+#define XORSHIFT_SSE2(x) do {                           \
+        x = _mm_xor_si128(x, _mm_slli_epi64(x, 13));    \
+        x = _mm_xor_si128(x, _mm_srli_epi64(x, 7));     \
+        x = _mm_xor_si128(x, _mm_slli_epi64(x, 17));    \
+    } while (0)
+
+#define XORSHIFT_AVX2(x) do {                                   \
+        x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 13));      \
+        x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 7));       \
+        x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 17));      \
+    } while (0)
+
+#define XORSHIFT_AVX512(x) do {                                 \
+        x = _mm512_xor_si512(x, _mm512_slli_epi64(x, 13));      \
+        x = _mm512_xor_si512(x, _mm512_srli_epi64(x, 7));       \
+        x = _mm512_xor_si512(x, _mm512_slli_epi64(x, 17));      \
+    } while (0)
+
+static void fill_sse2(uint64_t *lanes, char *buffer, size_t steps)
+{
+    __m128i lo = _mm_loadu_si128((const __m128i*)lanes);
+    __m128i hi = _mm_loadu_si128((const __m128i*)(lanes + 2));
+
+    for (size_t step = 0; step < steps; step++, buffer += VERIFY_STEP_SIZE) {
+        XORSHIFT_SSE2(lo);
+        XORSHIFT_SSE2(hi);
+        _mm_storeu_si128((__m128i*)buffer, lo);
+        _mm_storeu_si128((__m128i*)(buffer + 16), hi);
+    }
+
+    _mm_storeu_si128((__m128i*)lanes, lo);
+    _mm_storeu_si128((__m128i*)(lanes + 2), hi);
+}
+
+static bool compare_sse2(
+    uint64_t *lanes,
+    const char *buffer,
+    size_t sector_steps,
+    size_t skip_steps,
+    size_t num_sectors
+) {
+    __m128i lo = _mm_loadu_si128((const __m128i*)lanes);
+    __m128i hi = _mm_loadu_si128((const __m128i*)(lanes + 2));
+    __m128i diff = _mm_setzero_si128();
+    __m128i data;
+    size_t step;
+
+    for (size_t sector = 0; sector < num_sectors; sector++) {
+        for (step = 0; step < skip_steps; step++, buffer += VERIFY_STEP_SIZE) {
+            XORSHIFT_SSE2(lo);
+            XORSHIFT_SSE2(hi);
+        }
+
+        for (; step < sector_steps; step++, buffer += VERIFY_STEP_SIZE) {
+            XORSHIFT_SSE2(lo);
+            XORSHIFT_SSE2(hi);
+            data = _mm_loadu_si128((const __m128i*)buffer);
+            diff = _mm_or_si128(diff, _mm_xor_si128(lo, data));
+            data = _mm_loadu_si128((const __m128i*)(buffer + 16));
+            diff = _mm_or_si128(diff, _mm_xor_si128(hi, data));
+        }
+    }
+
+    _mm_storeu_si128((__m128i*)lanes, lo);
+    _mm_storeu_si128((__m128i*)(lanes + 2), hi);
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) == 0xffff;
+}
+
+static bool is_byte_sse2(const char *buffer, size_t len, uint8_t byte)
+{
+    __m128i fill = _mm_set1_epi8((char)byte);
+    __m128i bits = _mm_setzero_si128();
+    __m128i data;
+    size_t pos = 0;
+
+    for (; pos + 16 <= len; pos += 16) {
+        data = _mm_loadu_si128((const __m128i*)(buffer + pos));
+        bits = _mm_or_si128(bits, _mm_xor_si128(fill, data));
+    }
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(bits, _mm_setzero_si128())) == 0xffff &&
+           is_byte_c(buffer + pos, len - pos, byte);
+}
+
+__attribute__((target("avx2")))
+static void fill_avx2(uint64_t *lanes, char *buffer, size_t steps)
+{
+    __m256i x = _mm256_loadu_si256((const __m256i*)lanes);
+
+    for (size_t step = 0; step < steps; step++, buffer += VERIFY_STEP_SIZE) {
+        XORSHIFT_AVX2(x);
+        _mm256_storeu_si256((__m256i*)buffer, x);
+    }
+
+    _mm256_storeu_si256((__m256i*)lanes, x);
+}
+
+__attribute__((target("avx2")))
+static bool compare_avx2(
+    uint64_t *lanes,
+    const char *buffer,
+    size_t sector_steps,
+    size_t skip_steps,
+    size_t num_sectors
+) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)lanes);
+    __m256i diff = _mm256_setzero_si256();
+    __m256i data;
+    size_t step;
+
+    for (size_t sector = 0; sector < num_sectors; sector++) {
+        for (step = 0; step < skip_steps; step++, buffer += VERIFY_STEP_SIZE)
+            XORSHIFT_AVX2(x);
+
+        for (; step < sector_steps; step++, buffer += VERIFY_STEP_SIZE) {
+            XORSHIFT_AVX2(x);
+            data = _mm256_loadu_si256((const __m256i*)buffer);
+            diff = _mm256_or_si256(diff, _mm256_xor_si256(x, data));
+        }
+    }
+
+    _mm256_storeu_si256((__m256i*)lanes, x);
+
+    return _mm256_testz_si256(diff, diff);
+}
+
+__attribute__((target("avx2")))
+static bool is_byte_avx2(const char *buffer, size_t len, uint8_t byte)
+{
+    __m256i fill = _mm256_set1_epi8((char)byte);
+    __m256i bits = _mm256_setzero_si256();
+    __m256i data;
+    size_t pos = 0;
+
+    for (; pos + 32 <= len; pos += 32) {
+        data = _mm256_loadu_si256((const __m256i*)(buffer + pos));
+        bits = _mm256_or_si256(bits, _mm256_xor_si256(fill, data));
+    }
+
+    return _mm256_testz_si256(bits, bits) && is_byte_c(buffer + pos, len - pos, byte);
+}
+
+/*
+ * One 512-bit vector holds the lanes of two consecutive steps, so it is
+ * advanced by two generator steps at a time. An odd last step is taken
+ * from the lower half of the pair that was not used any more.
+ */
+
+__attribute__((target("avx512f")))
+static void fill_avx512(uint64_t *lanes, char *buffer, size_t steps)
+{
+    __m256i state = _mm256_loadu_si256((const __m256i*)lanes);
+    __m256i first = state;
+    __m256i second;
+    __m512i x;
+
+    XORSHIFT_AVX2(first);
+    second = first;
+    XORSHIFT_AVX2(second);
+    x = _mm512_inserti64x4(_mm512_castsi256_si512(first), second, 1);
+
+    for (; steps >= 2; steps -= 2, buffer += 2 * VERIFY_STEP_SIZE) {
+        _mm512_storeu_si512((void*)buffer, x);
+        state = _mm512_extracti64x4_epi64(x, 1);
+        XORSHIFT_AVX512(x);
+        XORSHIFT_AVX512(x);
+    }
+
+    if (steps == 1) {
+        state = _mm512_castsi512_si256(x);
+        _mm256_storeu_si256((__m256i*)buffer, state);
+    }
+
+    _mm256_storeu_si256((__m256i*)lanes, state);
+}
+
+__attribute__((target("avx512f")))
+static bool compare_avx512(
+    uint64_t *lanes,
+    const char *buffer,
+    size_t sector_steps,
+    size_t skip_steps,
+    size_t num_sectors
+) {
+    __m256i state = _mm256_loadu_si256((const __m256i*)lanes);
+    __m256i second;
+    __m256i tail_diff = _mm256_setzero_si256();
+    __m512i diff = _mm512_setzero_si512();
+    __m512i data;
+    __m512i x;
+    size_t steps;
+
+    for (size_t sector = 0; sector < num_sectors; sector++) {
+        for (steps = 0; steps < skip_steps; steps++, buffer += VERIFY_STEP_SIZE)
+            XORSHIFT_AVX2(state);
+
+        if (sector_steps == skip_steps)
+            continue;
+
+        XORSHIFT_AVX2(state);
+        second = state;
+        XORSHIFT_AVX2(second);
+        x = _mm512_inserti64x4(_mm512_castsi256_si512(state), second, 1);
+
+        for (steps = sector_steps - skip_steps; steps >= 2; steps -= 2,
+             buffer += 2 * VERIFY_STEP_SIZE) {
+            data = _mm512_loadu_si512((const void*)buffer);
+            diff = _mm512_or_si512(diff, _mm512_xor_si512(x, data));
+            state = _mm512_extracti64x4_epi64(x, 1);
+            XORSHIFT_AVX512(x);
+            XORSHIFT_AVX512(x);
+        }
+
+        if (steps == 1) {
+            state = _mm512_castsi512_si256(x);
+            tail_diff = _mm256_or_si256(tail_diff,
+                    _mm256_xor_si256(state, _mm256_loadu_si256((const __m256i*)buffer)));
+            buffer += VERIFY_STEP_SIZE;
+        }
+    }
+
+    _mm256_storeu_si256((__m256i*)lanes, state);
+
+    return _mm512_test_epi64_mask(diff, diff) == 0 && _mm256_testz_si256(tail_diff, tail_diff);
+}
+
+__attribute__((target("avx512f")))
+static bool is_byte_avx512(const char *buffer, size_t len, uint8_t byte)
+{
+    __m512i fill = _mm512_set1_epi32((int)(0x01010101U * byte));
+    __m512i bits = _mm512_setzero_si512();
+    __m512i data;
+    size_t pos = 0;
+
+    for (; pos + 64 <= len; pos += 64) {
+        data = _mm512_loadu_si512((const void*)(buffer + pos));
+        bits = _mm512_or_si512(bits, _mm512_xor_si512(fill, data));
+    }
+
+    return _mm512_test_epi64_mask(bits, bits) == 0 && is_byte_c(buffer + pos, len - pos, byte);
+}
+
+#endif
+
+static void verify_init(void)
+{
+    fill_fn = fill_c;
+    compare_fn = compare_c;
+    is_byte_fn = is_byte_c;
+    verify_name = "generic";
+
+#if defined(HAVE_VERIFY_X86)
+    /* SSE2 is part of x86-64 itself. */
+    fill_fn = fill_sse2;
+    compare_fn = compare_sse2;
+    is_byte_fn = is_byte_sse2;
+    verify_name = "sse2";
+
+    if (__builtin_cpu_supports("avx2")) {
+        fill_fn = fill_avx2;
+        compare_fn = compare_avx2;
+        is_byte_fn = is_byte_avx2;
+        verify_name = "avx2";
+    }
+
+    if (__builtin_cpu_supports("avx512f")) {
+        fill_fn = fill_avx512;
+        compare_fn = compare_avx512;
+        is_byte_fn = is_byte_avx512;
+        verify_name = "avx512";
+    }
+#endif
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Data stream of a block and the kernels that write and check it.
+ *
+ * The data is four interleaved xorshift64 generators seeded from the run
+ * ID, so it can be regenerated at any time from the seed alone: blocks are
+ * filled straight from the generator, and verification regenerates the
+ * expected data and compares it in the same pass, without ever keeping a
+ * copy of the expected data in memory. Every step yields 32 bytes.
+ *
+ * The fill and compare kernels use AVX-512, AVX2 or SSE2, whichever is the
+ * best the CPU supports, and portable C elsewhere. All of them produce the
+ * same data. The check of the fixed-byte patterns is vectorized the same
+ * way; filling with a fixed byte is left to memset.
+ */
+
+#define VERIFY_STEP_SIZE 32
+
+typedef struct verify_stream_t {
+    uint64_t lanes[4];
+} verify_stream_t;
+
+void verify_stream_init(verify_stream_t*, uint32_t);
+void verify_stream_fill(verify_stream_t*, char*, size_t);
+void verify_stream_skip(verify_stream_t*, size_t);
+bool verify_stream_compare(verify_stream_t*, const char*, size_t);
+bool verify_stream_compare_sectors(verify_stream_t*, const char*, size_t, size_t, size_t);
+uint64_t verify_stream_flips(verify_stream_t*, const char*, size_t);
+bool verify_is_byte(const char*, size_t, uint8_t);
+uint64_t verify_byte_flips(const char*, size_t, uint8_t);
+const char *verify_impl_name(void);
+
+#endif
@@ -29,7 +29,7 @@
  */
 
 
-/* Linux open() syscall's O_DIRECT flag requires to define _GNU_SOURCE. */
+/* On Linux, _GNU_SOURCE brings the GNU strerror_r() that worker_strerror() expects. */
 #if defined(__linux__)
     #define _GNU_SOURCE
 #endif
@@ -38,139 +38,435 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "arena.h"
+#include "badmap.h"
 #include "disk.h"
+#include "ioengine.h"
+#include "pattern.h"
+#include "permute.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "throttle.h"
+#include "topology.h"
+#include "undo.h"
 #include "utils.h"
 #include "workers.h"
+#include "zones.h"
 
 typedef struct common_worker_params_t {
     const char *device_name;
-    const char *wr_data;
-    off_t num_blocks;
     off_t disk_size;
     unsigned int blocksize;
     unsigned int sector_size;
+    ioengine_type_t engine;
+    unsigned int queue_depth;
+    bool stream;
+    off_t stream_window;
+    pattern_schedule_t patterns;
+    bool tag_sectors;
+    bool verify_only;
+    bool scan;
+    disk_wipe_t wipe;
+    undo_t *undo;
+    bool random;
+    bool write_only;
+    off_t verify_lag;
+    bool verify_flush;
+    bool dsync;
+    off_t flush_interval;
+    badmap_t *badmap;
+    unsigned int retries;
+    bool probe;
+    uint32_t run_id;
+    unsigned int pass;
 } common_worker_params_t;
 
 typedef struct worker_params_t {
-    volatile off_t offset;
+    unsigned int id;
+    worker_stats_t *stats;
     common_worker_params_t *common_worker_params;
+    workers_t *workers;
 } worker_params_t;
 
+struct workers_t {
+    common_worker_params_t common_worker_params;
+    worker_params_t *worker_params;
+    pthread_t *workers_id;
+    pthread_attr_t tattr;
+    pthread_mutex_t mutex_workers_run;
+    unsigned int num_workers;
+    unsigned int workers_run;
+    worker_stats_t *stats;
+    scheduler_t scheduler;
+    permute_t permute;      /* Order of the blocks in random mode. */
+    zones_t zones;          /* Throughput profile of the pass. */
+    throttle_t throttle;    /* Bandwidth and IOPS limit of the pass. */
+    topology_t *topology;   /* NULL when workers are not pinned. */
+    char *buffers;          /* Slot and save buffers of all workers, one after another. */
+    size_t worker_buffer_size;
+    size_t slot_buffer_size;    /* The save buffer of a worker follows its slot buffers. */
+    bool stop;      /* A fatal error stops the other workers of the device. */
+    bool failed;
+    bool wipe_fallback;     /* The zero-out wasn't offloaded, which was reported once. */
+};
+
+/*
+ * One in-flight block: it is written from buffer and then read back into
+ * it. Chunks and windows are positions in the order of the pass, which
+ * is the block's place on the disk unless the order is random.
+ */
+typedef struct io_slot_t {
+    off_t offset;
+    size_t len;
+    off_t seq_offset;
+    size_t seq_len;
+    io_op_t op;
+    off_t pos;      /* Where an in-flight write lies in the write stream, -1 once done. */
+    bool dirty;     /* The buffer no longer holds the base pattern. */
+    uint64_t submit_ns;
+    char *buffer;
+} io_slot_t;
+
+/* A chunk taken from the scheduler that still has blocks to be verified. */
+typedef struct held_chunk_t {
+    off_t start;
+    off_t end;
+    off_t verified;
+    uint64_t max_ns;        /* Read latency over the chunk. */
+    uint64_t total_ns;
+    uint64_t num_reads;
+} held_chunk_t;
+
+/*
+ * Part of the write stream waiting to be read back with a verify lag: the
+ * window from start to end, read back up to next, and the position of its
+ * start in the stream.
+ */
+typedef struct lag_range_t {
+    off_t start;
+    off_t end;
+    off_t next;
+    off_t pos;
+} lag_range_t;
+
+/*
+ * What a worker does with its current window. Streaming windows go
+ * through these in order, and a non-destructive run saves the original
+ * data of the window first and puts it back at the end.
+ */
+typedef enum {
+    PHASE_SAVE = 0,
+    PHASE_WRITE,
+    PHASE_VERIFY,
+    PHASE_RESTORE
+} phase_t;
+
+/* Per-thread state of a running worker. */
+typedef struct worker_ctx_t {
+    workers_t *workers;
+    const char *device_name;
+    pattern_t pattern;
+    unsigned int blocksize;
+    unsigned int queue_depth;
+    int fd;
+    ioengine_t *engine;
+    char *buffer;
+    char *save;             /* Original data of the window in a non-destructive run. */
+    undo_t *undo;
+    const permute_t *permute;   /* NULL unless the order is random. */
+    off_t disk_size;
+    badmap_t *badmap;
+    unsigned int retries;
+    io_slot_t *slots;
+    unsigned int *free_slots;
+    unsigned int num_free;
+    io_completion_t *completions;
+    worker_stats_t *stats;
+    unsigned int id;
+    off_t window;
+    off_t chunk_end;
+    uint64_t last_ns;       /* Last reap, the time since goes to the zones of the next one. */
+    held_chunk_t *held;     /* Each in-flight block holds a chunk, plus the one being issued. */
+    unsigned int num_held;
+    unsigned int max_held;
+    off_t write_pos;        /* Bytes queued for writing by this worker so far. */
+    off_t lag;              /* Bytes written after a block before it is read back, 0 for none. */
+    bool lag_flush;
+    off_t flushed_pos;      /* Writes up to here were flushed from the drive's cache. */
+    lag_range_t *lag_ranges;    /* Ring of the windows still to be read back. */
+    unsigned int lag_head;
+    unsigned int num_lag;
+    unsigned int max_lag;
+    off_t flush_interval;   /* Bytes written between cache flushes, 0 for none. */
+    off_t unflushed;        /* Bytes written since the last flush. */
+    char *retry_buffer;     /* A failed block's expected data, or its parts read back. */
+    unsigned int retry_ios; /* I/Os the failed block may still take. */
+    uint64_t retry_deadline_ns;
+    bool retry_mismatch;    /* A part written on retry didn't read back. */
+} worker_ctx_t;
+
+/* Indexes of the slot and save buffers registered with the I/O engine. */
+#define SLOT_BUF_INDEX 0
+#define SAVE_BUF_INDEX 1
+#define DEFAULT_CHUNK_SIZE (64 * 1024 * 1024)
+#define THROTTLE_NAP_NS (100 * 1000000ULL)
+
+/* Retries of a failed block, past which the rest of it is taken as bad. */
+#define RETRY_MAX_IOS 256
+#define RETRY_MAX_NS (30 * 1000000000ULL)
+
 int pthread_errno;
 
 static bool workers_stop = false;
-static pthread_mutex_t mutex_verified_bytes = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t mutex_workers_run = PTHREAD_MUTEX_INITIALIZER;
-
-static pthread_t *workers_id;
-static pthread_attr_t tattr;
-static worker_params_t *worker_params;
-static common_worker_params_t *common_worker_params;
-static unsigned int num_workers;
-static unsigned int workers_run;
-static off_t verified_bytes;
 
 /*
  * Internal functions' prototypes
  */
 
+static void random_order(permute_t*, off_t, unsigned int, uint32_t, unsigned int);
 static void *worker(void*);
+static void read_pattern(void*, char*, size_t, off_t);
+static size_t queue_block(worker_ctx_t*, io_op_t, off_t, off_t);
+static size_t queue_save_block(worker_ctx_t*, io_op_t, off_t, off_t, off_t);
+static void throttle_block(worker_ctx_t*, size_t);
+static void window_restored(worker_ctx_t*);
+static void wipe_chunks(worker_ctx_t*, disk_wipe_t);
+static void write_zeros(worker_ctx_t*, off_t, off_t);
+static ssize_t finish_write(worker_ctx_t*, io_slot_t*, size_t);
+static void start_retries(worker_ctx_t*);
+static uint64_t recover_block(worker_ctx_t*, io_slot_t*, int, bool);
+static uint64_t bisect_range(worker_ctx_t*, io_op_t, char*, char*, size_t, off_t, unsigned int);
+static uint64_t retry_part(worker_ctx_t*, io_op_t, char*, char*, size_t, off_t);
+static uint64_t mark_bad(worker_ctx_t*, io_op_t, char*, char*, size_t, off_t);
+static bool next_window(worker_ctx_t*, off_t*, off_t*);
+static void lag_push(worker_ctx_t*, off_t, off_t);
+static lag_range_t *lag_next_read(worker_ctx_t*, bool);
+static void flush_writes(worker_ctx_t*);
+static void chunk_verified(worker_ctx_t*, off_t, size_t, uint64_t);
+static void clamp_chunks(worker_ctx_t*, off_t);
+static void finish_chunk(worker_ctx_t*, held_chunk_t*);
+static void release_worker(worker_ctx_t*);
+static void exit_worker(workers_t*);
+static void worker_fatal(worker_ctx_t*, const char*, int);
+static const char *worker_strerror(int, char*, size_t);
+static inline uint64_t good_bytes(size_t, uint64_t, unsigned int);
+static inline bool are_workers_stopping(workers_t*);
 static inline void lock_mutex(pthread_mutex_t*);
 static inline void unlock_mutex(pthread_mutex_t*);
 
-workers_check_t init_workers(
-    unsigned int n_workers,
-    const char *device_name,
-    off_t disk_size,
-    unsigned int blocksize,
-    unsigned int sector_size,
-    const char* wr_data
-) {
-    num_workers = n_workers;
+/* Bytes of the arena that the workers of one device take, save buffers included. */
+size_t workers_buffer_size(unsigned int num_workers, unsigned int queue_depth,
+                           unsigned int blocksize, size_t save_size)
+{
+    return arena_round(num_workers * (arena_round((size_t)blocksize * queue_depth,
+                                                  ARENA_BUFFER_ALIGN) +
+                                      arena_round(save_size, ARENA_BUFFER_ALIGN)),
+                       ARENA_REGION_ALIGN);
+}
+
+/* Where the block at position in the order of a random pass lies on the disk. */
+off_t random_block_offset(off_t disk_size, unsigned int blocksize, uint32_t run_id,
+                          unsigned int pass, off_t position)
+{
+    permute_t permute;
+
+    random_order(&permute, disk_size, blocksize, run_id, pass);
+
+    return (off_t)permute_index(&permute, (uint64_t)position / blocksize) * blocksize;
+}
+
+/* Every pass visits the blocks in another order, and a resumed pass in the same one. */
+static void random_order(permute_t *permute, off_t disk_size, unsigned int blocksize,
+                         uint32_t run_id, unsigned int pass)
+{
+    permute_init(permute, (uint64_t)(disk_size + blocksize - 1) / blocksize,
+                 ((uint64_t)run_id << 32) | pass);
+}
 
-    workers_id = malloc(num_workers * sizeof(pthread_t));
+workers_check_t init_workers(workers_t **workers_ptr, const workers_config_t *config)
+{
+    workers_t *workers;
+    common_worker_params_t *common_worker_params;
+    unsigned int num_workers = config->num_workers;
+    off_t chunk_size = config->chunk_size ? config->chunk_size : DEFAULT_CHUNK_SIZE;
+    size_t save_size;
 
-    if (workers_id == NULL)
+    /* Zeroed, so a half-initialized device can still be cleaned up. */
+    if ((*workers_ptr = workers = calloc(1, sizeof(workers_t))) == NULL)
         return WORKERS_CHECK_ERR_MEM_ALLOC;
 
-    common_worker_params = malloc(sizeof(common_worker_params_t));
+    workers->num_workers = num_workers;
+
+    workers->workers_id = malloc(num_workers * sizeof(pthread_t));
 
-    if (common_worker_params == NULL)
+    if (workers->workers_id == NULL)
         return WORKERS_CHECK_ERR_MEM_ALLOC;
 
-    worker_params = malloc(num_workers * sizeof(worker_params_t));
+    workers->worker_params = malloc(num_workers * sizeof(worker_params_t));
 
-    if (worker_params == NULL)
+    if (workers->worker_params == NULL)
         return WORKERS_CHECK_ERR_MEM_ALLOC;
 
+    if (posix_memalign((void**)&workers->stats, STATS_CACHE_LINE,
+                       num_workers * sizeof(worker_stats_t)) != 0)
+        return WORKERS_CHECK_ERR_MEM_ALLOC;
+
+    /* A device that sits out a pass reads no progress from before its first one. */
+    memset(workers->stats, 0, num_workers * sizeof(worker_stats_t));
+
+    if ((pthread_errno = pthread_mutex_init(&workers->mutex_workers_run, NULL)) != 0)
+        return WORKERS_CHECK_ERR_PTHREAD;
+
     /* Set all threads as detached threads. */
-    if ((pthread_errno = pthread_attr_init(&tattr)) != 0)
+    if ((pthread_errno = pthread_attr_init(&workers->tattr)) != 0)
         return WORKERS_CHECK_ERR_PTHREAD;
 
-    if ((pthread_errno = pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED)) != 0)
+    if ((pthread_errno = pthread_attr_setdetachstate(&workers->tattr,
+                                                     PTHREAD_CREATE_DETACHED)) != 0)
         return WORKERS_CHECK_ERR_PTHREAD;
 
     /* Set common parametes for workers. */
-    common_worker_params->device_name = device_name;
-    common_worker_params->disk_size = disk_size;
-    common_worker_params->blocksize = blocksize;
-    common_worker_params->sector_size = sector_size;
-    common_worker_params->wr_data = wr_data;
-    common_worker_params->num_blocks = get_disk_segment_size(
-            disk_size,
-            blocksize,
-            num_workers
-    ) / blocksize;
+    common_worker_params = &workers->common_worker_params;
+    common_worker_params->device_name = config->device_name;
+    common_worker_params->patterns = config->patterns;
+    common_worker_params->disk_size = config->disk_size;
+    common_worker_params->blocksize = config->blocksize;
+    common_worker_params->sector_size = config->sector_size;
+    common_worker_params->engine = (get_disk_type(config->device_name) == DISK_TYPE_NULL)
+                                   ? IOENGINE_NULL : config->engine;
+    common_worker_params->queue_depth = config->queue_depth;
+    common_worker_params->stream = config->stream;
+    common_worker_params->stream_window = config->stream_window;
+    common_worker_params->tag_sectors = config->tag_sectors;
+    common_worker_params->verify_only = config->verify_only;
+    common_worker_params->scan = config->scan;
+    common_worker_params->wipe = config->wipe;
+    common_worker_params->undo = config->undo;
+    common_worker_params->random = config->random;
+    common_worker_params->write_only = config->write_only;
+    common_worker_params->verify_lag = config->verify_lag;
+    common_worker_params->verify_flush = config->verify_flush;
+    common_worker_params->dsync = config->dsync;
+    common_worker_params->flush_interval = config->flush_interval;
+    common_worker_params->badmap = config->badmap;
+    common_worker_params->retries = config->retries;
+    common_worker_params->probe = config->probe;
+    common_worker_params->run_id = config->run_id;
+
+    /*
+     * A streaming window never spans chunks, and chunks always hold whole
+     * blocks. Very large disks get larger chunks so they can be counted.
+     */
+    if (chunk_size < config->stream_window)
+        chunk_size = config->stream_window;
+
+    if (chunk_size < (off_t)config->blocksize)
+        chunk_size = config->blocksize;
+
+    while (config->disk_size / chunk_size >= SCHED_MAX_CHUNKS)
+        chunk_size *= 2;
+
+    chunk_size += (config->blocksize - chunk_size % config->blocksize) % config->blocksize;
+
+    if (!sched_init(&workers->scheduler, num_workers, config->disk_size, chunk_size))
+        return WORKERS_CHECK_ERR_MEM_ALLOC;
+
+    if (zones_init(&workers->zones, config->disk_size, config->zone_size) != ZONES_CHECK_OK)
+        return WORKERS_CHECK_ERR_MEM_ALLOC;
+
+    /* Placement is an optimization: a device without topology information still gets tested. */
+    if (config->numa &&
+        topology_probe(config->device_name, &workers->topology) == TOPOLOGY_CHECK_ERR_MEM_ALLOC)
+        return WORKERS_CHECK_ERR_MEM_ALLOC;
+
+    /*
+     * Each worker gets a page-aligned share of the device's region. The
+     * region is bound to the device's node before anything touches it.
+     * A non-destructive worker saves one streaming window at a time.
+     */
+    save_size = (config->undo != NULL) ? (size_t)config->stream_window : 0;
+    workers->slot_buffer_size = arena_round((size_t)config->blocksize * config->queue_depth,
+                                            ARENA_BUFFER_ALIGN);
+    workers->worker_buffer_size = workers->slot_buffer_size +
+                                  arena_round(save_size, ARENA_BUFFER_ALIGN);
+    workers->buffers = arena_alloc(config->arena,
+                                   workers_buffer_size(num_workers, config->queue_depth,
+                                                       config->blocksize, save_size),
+                                   ARENA_REGION_ALIGN);
+
+    if (workers->buffers == NULL)
+        return WORKERS_CHECK_ERR_MEM_ALLOC;
+
+    topology_bind_memory(workers->topology, workers->buffers,
+                         workers_buffer_size(num_workers, config->queue_depth, config->blocksize,
+                                             save_size));
 
     return WORKERS_CHECK_OK;
 }
 
-workers_check_t start_workers(void)
+/* Chunks set in done, if given, were finished by an earlier run and are skipped. */
+workers_check_t start_workers(workers_t *workers, unsigned int pass, const uint64_t *done)
 {
+    unsigned int num_workers = workers->num_workers;
+    worker_params_t *worker_params = workers->worker_params;
 
-    off_t offset = 0;
-    off_t disk_segment_size;
+    /* A device that hit a fatal error is out of the test. */
+    if (workers->failed)
+        return WORKERS_CHECK_OK;
 
     /* Each worker decreases workers_run by one when its job is done. */
-    workers_run = num_workers;
+    workers->workers_run = num_workers;
 
-    verified_bytes = 0;
+    memset(workers->stats, 0, num_workers * sizeof(worker_stats_t));
+    zones_reset(&workers->zones);
 
-    disk_segment_size = get_disk_segment_size(
-            common_worker_params->disk_size,
-            common_worker_params->blocksize,
-            num_workers
-    );
+    workers->common_worker_params.pass = pass;
+
+    if (workers->common_worker_params.random)
+        random_order(&workers->permute, workers->common_worker_params.disk_size,
+                     workers->common_worker_params.blocksize,
+                     workers->common_worker_params.run_id, pass);
+
+    sched_reset(&workers->scheduler, done);
 
     bzero(worker_params, num_workers * sizeof(worker_params_t));
-    bzero(workers_id, num_workers * sizeof(pthread_t));
+    bzero(workers->workers_id, num_workers * sizeof(pthread_t));
 
     /* Create threads for workers. */
     for (unsigned int worker_counter = 0; worker_counter < num_workers; worker_counter++) {
 
-        worker_params[worker_counter].common_worker_params = common_worker_params;
-        worker_params[worker_counter].offset = offset;
+        worker_params[worker_counter].common_worker_params = &workers->common_worker_params;
+        worker_params[worker_counter].workers = workers;
+        worker_params[worker_counter].id = worker_counter;
+        worker_params[worker_counter].stats = &workers->stats[worker_counter];
 
-        pthread_errno = pthread_create(&workers_id[worker_counter],
-                &tattr,
+        pthread_errno = pthread_create(&workers->workers_id[worker_counter],
+                &workers->tattr,
                 worker,
                 &worker_params[worker_counter]
         );
 
         if (pthread_errno != 0)
             return WORKERS_CHECK_ERR_PTHREAD;
-
-        offset += disk_segment_size;
     }
 
     return WORKERS_CHECK_OK;
 }
 
+/* Ends the pass of one device early; blocks in flight are still drained. */
+void halt_workers(workers_t *workers)
+{
+    workers->stop = true;
+}
+
 void stop_workers(void)
 {
     workers_stop = true;
@@ -178,133 +474,1089 @@ void stop_workers(void)
     return;
 }
 
+/* Whether stop_workers() was called, after which no pass gets anywhere. */
+bool are_workers_stopped(void)
+{
+    return workers_stop;
+}
+
 static void *worker(void *worker_params)
 {
     struct worker_params_t *params = (struct worker_params_t*) worker_params;
-    int fd;
+    worker_ctx_t ctx;
     unsigned int blocksize = params->common_worker_params->blocksize;
     unsigned int sector_size = params->common_worker_params->sector_size;
-    off_t num_blocks = params->common_worker_params->num_blocks;
-    off_t disk_size = params->common_worker_params->disk_size;
+    unsigned int queue_depth = params->common_worker_params->queue_depth;
+    bool scan = params->common_worker_params->scan;
+    bool verify_only = params->common_worker_params->verify_only || scan;
+    undo_t *undo = params->common_worker_params->undo;
+    bool write_only = params->common_worker_params->write_only;
+    /* A write-only pass has nothing to read back, so it never streams. */
+    bool stream = (params->common_worker_params->stream || verify_only || undo != NULL) &&
+                  !write_only;
+    /* Only interleaved blocks are read back right away, the others lag behind already. */
+    off_t lag = (stream || write_only) ? 0 : params->common_worker_params->verify_lag;
+    off_t window = params->common_worker_params->stream_window;
     const char *device_name = params->common_worker_params->device_name;
-    const char *wr_data = params->common_worker_params->wr_data;
-    off_t offset = params->offset;
-    off_t current_offset;
-    ssize_t written_bytes;
-    char *buffer = NULL;
-    char error_buffer[256] = {0};
-    int local_errno;
-
-    if ((fd = open(device_name, O_RDWR|O_DIRECT)) == -1) {
-        local_errno = errno;
-        strerror_r(local_errno, error_buffer, sizeof(error_buffer));
-        fprintf(stderr, "Can't open device: %s: %s\n", device_name,
-                        error_buffer);
-        cleanup_workers();
-        exit(EXIT_FAILURE);
-    }
+    off_t window_start = 0;
+    off_t window_end = 0;
+    off_t write_offset;
+    off_t read_offset;
+    off_t save_offset;
+    phase_t first_phase = verify_only ? PHASE_VERIFY : (undo != NULL) ? PHASE_SAVE : PHASE_WRITE;
+    phase_t phase = first_phase;
+    bool done;
+    lag_range_t *range;
+    io_slot_t *slot;
+    unsigned int tag;
+    ssize_t result;
+    unsigned int num_completed;
+    ioengine_check_t engine_result;
+    block_check_t check;
+    char mismatch[512];
+    uint64_t latency_ns;
+    uint64_t bad_sectors;
+    uint64_t start_ns = stats_now_ns();
+    uint64_t now_ns;
+    uint64_t busy_share_ns;
+    struct iovec iov[2];
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.fd = -1;
+    ctx.workers = params->workers;
+    ctx.device_name = device_name;
+    pattern_set_fill(&ctx.pattern, pattern_schedule_fill(&params->common_worker_params->patterns,
+                                                         params->common_worker_params->pass));
+    ctx.pattern.blocksize = blocksize;
+    ctx.pattern.sector_size = sector_size;
+    ctx.pattern.tagged = params->common_worker_params->tag_sectors;
+    ctx.pattern.run_id = params->common_worker_params->run_id;
+    ctx.pattern.pass = params->common_worker_params->pass;
+    ctx.blocksize = blocksize;
+    ctx.stats = params->stats;
+    ctx.queue_depth = queue_depth;
+    ctx.id = params->id;
+    ctx.undo = undo;
+    ctx.permute = params->common_worker_params->random ? &ctx.workers->permute : NULL;
+    ctx.disk_size = params->common_worker_params->disk_size;
+    ctx.badmap = params->common_worker_params->badmap;
+    ctx.retries = params->common_worker_params->retries;
+    ctx.last_ns = start_ns;
+    ctx.lag = lag;
+    ctx.lag_flush = params->common_worker_params->verify_flush;
+    ctx.flush_interval = params->common_worker_params->flush_interval;
+
+    /* Move onto the CPUs of the device's hardware queues before anything is allocated. */
+    topology_bind_worker(ctx.workers->topology, ctx.id);
+
+    if (open_disk(device_name, verify_only ? O_RDONLY : O_RDWR, &ctx.fd) != DISKDEV_CHECK_OK)
+        worker_fatal(&ctx, "Can't open device", errno);
 
-    if (lseek(fd, offset, SEEK_SET) == -1) {
-        local_errno = errno;
-        strerror_r(local_errno, error_buffer, sizeof(error_buffer));
-        fprintf(stderr, "Failed to seek on disk device: %s: %s\n", device_name,
-                        error_buffer);
-        cleanup_workers();
-        exit(EXIT_FAILURE);
+    /*
+     * With a verify lag the chunk-sized windows written but not yet read
+     * back are kept in a ring. Its size bounds how far the writes can run
+     * ahead, a few windows past the lag, and each of them holds a chunk.
+     */
+    if (lag > 0)
+        ctx.max_lag = (unsigned int)(lag / ctx.workers->scheduler.chunk_size) + 3;
+
+    ctx.max_held = queue_depth + 1 + ctx.max_lag;
+
+    /* Every in-flight block gets its own buffer for the write and the read-back. */
+    ctx.buffer = ctx.workers->buffers + ctx.id * ctx.workers->worker_buffer_size;
+    ctx.save = ctx.buffer + ctx.workers->slot_buffer_size;
+
+    if ((ctx.slots = malloc(queue_depth * sizeof(io_slot_t))) == NULL ||
+        (ctx.free_slots = malloc(queue_depth * sizeof(unsigned int))) == NULL ||
+        (ctx.completions = malloc(queue_depth * sizeof(io_completion_t))) == NULL ||
+        (ctx.held = malloc(ctx.max_held * sizeof(held_chunk_t))) == NULL ||
+        (lag > 0 && (ctx.lag_ranges = malloc(ctx.max_lag * sizeof(lag_range_t))) == NULL))
+        worker_fatal(&ctx, "No free memory to allocate for device", ENOMEM);
+
+    for (unsigned int i = 0; i < queue_depth; i++) {
+        ctx.slots[i].buffer = ctx.buffer + (size_t)i * blocksize;
+        ctx.slots[i].dirty = true;
+        ctx.slots[i].pos = -1;
+        ctx.free_slots[i] = i;
     }
 
-    if (posix_memalign((void**)&buffer, sector_size, blocksize)  != 0) {
-        fprintf(stderr, "%s\n", "No free memory to allocate.");
-        cleanup_workers();
-        exit(EXIT_FAILURE);
-    }
+    ctx.num_free = queue_depth;
 
-    current_offset = offset;
-    for (off_t block_counter = 0; block_counter < num_blocks; block_counter++) {
+    iov[SLOT_BUF_INDEX].iov_base = ctx.buffer;
+    iov[SLOT_BUF_INDEX].iov_len = (size_t)blocksize * queue_depth;
+    iov[SAVE_BUF_INDEX].iov_base = ctx.save;
+    iov[SAVE_BUF_INDEX].iov_len = (size_t)window;
 
-        if (workers_stop)
-            goto exit_worker;
+    engine_result = ioengine_init(&ctx.engine, params->common_worker_params->engine, ctx.fd,
+                                  queue_depth, iov, (undo != NULL) ? 2 : 1);
 
-        if (verified_bytes > disk_size) {
-            lock_mutex(&mutex_verified_bytes);
-            verified_bytes = disk_size;
-            unlock_mutex(&mutex_verified_bytes);
-            break;
-        }
+    if (engine_result == IOENGINE_CHECK_ERR_MEM_ALLOC)
+        worker_fatal(&ctx, "No free memory to allocate for device", ENOMEM);
+    else if (engine_result != IOENGINE_CHECK_OK)
+        worker_fatal(&ctx, "Can't set up I/O engine for device", errno);
 
-        written_bytes = write(fd, wr_data, blocksize);
+    ioengine_set_source(ctx.engine, read_pattern, &ctx);
+    ioengine_set_dsync(ctx.engine, params->common_worker_params->dsync);
 
-        if (written_bytes == -1) {
-            local_errno = errno;
+    /*
+     * In the default interleaved mode every chunk is a single window and
+     * every block is read back as soon as its write completes. In streaming
+     * mode the window is written sequentially first and only then read back
+     * sequentially, so a spinning disk never seeks between the two. A
+     * verify-only run streams through its chunks without writing at all.
+     * A non-destructive run always streams, one batch-sized window at a
+     * time, since the original data of the whole window has to be saved
+     * before any of it is overwritten.
+     */
+    ctx.window = (!stream || verify_only || window == 0) ? ctx.workers->scheduler.chunk_size :
+                                                           window;
 
-            if (local_errno == ENOSPC) {
-                break;
+    /* A wipe takes all the chunks there are, leaving nothing for the loop below. */
+    if (params->common_worker_params->wipe != DISK_WIPE_NONE)
+        wipe_chunks(&ctx, params->common_worker_params->wipe);
+
+    done = !next_window(&ctx, &window_start, &window_end);
+    write_offset = window_start;
+    read_offset = window_start;
+    save_offset = window_start;
+
+    if (lag > 0 && !done)
+        lag_push(&ctx, window_start, window_end);
+
+    /*
+     * Keep up to queue_depth blocks in flight. On SIGINT no new blocks are
+     * queued, but in-flight ones are drained since the kernel may still be
+     * using their buffers. A non-destructive worker still puts back the
+     * original data of the window it was testing.
+     */
+    for (;;) {
+
+        if (stream && ctx.num_free == queue_depth && !done) {
+            if (undo != NULL && are_workers_stopping(ctx.workers) &&
+                (phase == PHASE_WRITE || phase == PHASE_VERIFY)) {
+                phase = PHASE_RESTORE;
+                save_offset = window_start;
+            }
+
+            if (phase == PHASE_SAVE && save_offset >= window_end &&
+                !are_workers_stopping(ctx.workers)) {
+                if (undo_save(undo, ctx.id, window_start, ctx.save,
+                              (size_t)(window_end - window_start)) != UNDO_CHECK_OK)
+                    worker_fatal(&ctx, "Can't save original data to the undo log for device",
+                                 errno);
+
+                phase = PHASE_WRITE;
+            } else if (phase == PHASE_WRITE && write_offset >= window_end) {
+                phase = PHASE_VERIFY;
+                read_offset = window_start;
+            } else if (phase == PHASE_VERIFY && read_offset >= window_end && undo != NULL) {
+                phase = PHASE_RESTORE;
+                save_offset = window_start;
+            } else if ((phase == PHASE_VERIFY && read_offset >= window_end) ||
+                       (phase == PHASE_RESTORE && save_offset >= window_end)) {
+                if (phase == PHASE_RESTORE)
+                    window_restored(&ctx);
+
+                done = !next_window(&ctx, &window_start, &window_end);
+                phase = first_phase;
+                write_offset = window_start;
+                read_offset = window_start;
+                save_offset = window_start;
+            }
+        }
+
+        while (ctx.num_free > 0 &&
+               (!are_workers_stopping(ctx.workers) || phase == PHASE_RESTORE)) {
+            if (lag > 0 && (range = lag_next_read(&ctx, done && write_offset >= window_end))
+                           != NULL) {
+                range->next += queue_block(&ctx, IO_OP_READ, range->next, range->end);
+            } else if (phase == PHASE_SAVE && save_offset < window_end) {
+                save_offset += queue_save_block(&ctx, IO_OP_READ, save_offset, window_start,
+                                                window_end);
+            } else if (phase == PHASE_WRITE && write_offset < window_end) {
+                write_offset += queue_block(&ctx, IO_OP_WRITE, write_offset, window_end);
+            } else if (phase == PHASE_VERIFY && read_offset < window_end) {
+                read_offset += queue_block(&ctx, IO_OP_READ, read_offset, window_end);
+            } else if (phase == PHASE_RESTORE && save_offset < window_end) {
+                save_offset += queue_save_block(&ctx, IO_OP_WRITE, save_offset, window_start,
+                                                window_end);
+            } else if (!stream && !done && (lag == 0 || ctx.num_lag < ctx.max_lag)) {
+                /*
+                 * Interleaved writes flow straight on into the next chunk,
+                 * with a verify lag once the ring has room for it.
+                 */
+                done = !next_window(&ctx, &window_start, &window_end);
+                write_offset = window_start;
+
+                if (lag > 0 && !done)
+                    lag_push(&ctx, window_start, window_end);
             } else {
-                strerror_r(local_errno, error_buffer, sizeof(error_buffer));
-                fprintf(stderr, "Failed to write data to disk device: %s: %s\n", device_name,
-                                error_buffer);
+                break;
+            }
+        }
 
-                free(buffer);
-                cleanup_workers();
-                exit(EXIT_FAILURE);
+        /* Nothing left in flight means the disk is done or the worker was stopped. */
+        if (ctx.num_free == queue_depth)
+            break;
+
+        if (ioengine_submit(ctx.engine, 1) != IOENGINE_CHECK_OK)
+            worker_fatal(&ctx, "Failed to submit I/O to disk device", errno);
+
+        num_completed = ioengine_reap(ctx.engine, ctx.completions, queue_depth);
+
+        /* The time since the last reap is shared by the blocks it brought in. */
+        now_ns = stats_now_ns();
+        busy_share_ns = (num_completed > 0) ? (now_ns - ctx.last_ns) / num_completed : 0;
+        ctx.last_ns = now_ns;
+
+        for (unsigned int i = 0; i < num_completed; i++) {
+            tag = ctx.completions[i].tag;
+            result = ctx.completions[i].result;
+            slot = &ctx.slots[tag];
+
+            latency_ns = ctx.completions[i].end_ns - slot->submit_ns;
+            slot->pos = -1;
+            hist_record((slot->op == IO_OP_WRITE) ? &ctx.stats->write_latency
+                                                  : &ctx.stats->read_latency, latency_ns);
+
+            zones_record(&ctx.workers->zones, slot->op, slot->offset, (result > 0) ? result : 0,
+                         busy_share_ns, latency_ns);
+
+            /*
+             * Original data that can't be read is never overwritten, and
+             * data that can't be put back stays in the undo log.
+             */
+            if (phase == PHASE_SAVE || phase == PHASE_RESTORE) {
+                if (result < 0 || (size_t)result != slot->len)
+                    worker_fatal(&ctx, (phase == PHASE_SAVE)
+                                       ? "Failed to read original data from disk device"
+                                       : "Failed to restore original data on disk device",
+                                 (result < 0) ? -result : EIO);
+
+                ctx.free_slots[ctx.num_free++] = tag;
+                continue;
+            }
+
+            if (slot->op == IO_OP_WRITE) {
+
+                if (result > 0 && (size_t)result < slot->len)
+                    result = finish_write(&ctx, slot, (size_t)result);
+
+                /* In random order the end of the device can't be narrowed down. */
+                if (ctx.permute != NULL &&
+                    (result == -ENOSPC || (result >= 0 && (size_t)result != slot->len)))
+                    worker_fatal(&ctx, "Failed to write data to disk device", ENOSPC);
+
+                if (result == -ENOSPC || result == 0) {
+                    /* The device turned out to be shorter than it claimed. */
+                    if (window_end > slot->offset)
+                        window_end = slot->offset;
+                    if (ctx.chunk_end > window_end)
+                        ctx.chunk_end = window_end;
+
+                    clamp_chunks(&ctx, slot->offset);
+
+                    ctx.free_slots[ctx.num_free++] = tag;
+                    continue;
+                } else if (result < 0) {
+                    /*
+                     * Sectors that can't be written are not read back either,
+                     * the rest of an interleaved block is read back on retry.
+                     */
+                    bad_sectors = recover_block(&ctx, slot, -result,
+                                                !stream && lag == 0 && !write_only);
+
+                    if (bad_sectors > 0) {
+                        stats_add(&ctx.stats->written_bytes, slot->len);
+
+                        /* A lagged block is still read back, which accounts for it. */
+                        if (write_only) {
+                            chunk_verified(&ctx, slot->seq_offset, slot->seq_len, 0);
+                        } else if (!stream && lag == 0) {
+                            if (ctx.retry_mismatch) {
+                                fprintf(stderr, "Error verifying block on %s at offset #: %ld: "
+                                                "data written around the bad sectors doesn't "
+                                                "read back\n", device_name, slot->offset);
+                                stats_add(&ctx.stats->mismatched_blocks, 1);
+                            }
+
+                            stats_add(&ctx.stats->verified_bytes,
+                                      good_bytes(slot->len, bad_sectors, sector_size));
+                            chunk_verified(&ctx, slot->seq_offset, slot->seq_len, latency_ns);
+                        }
+
+                        ctx.free_slots[ctx.num_free++] = tag;
+                        continue;
+                    }
+
+                    result = slot->len;
+                }
+
+                stats_add(&ctx.stats->written_bytes, result);
+
+                ctx.unflushed += result;
+                if (ctx.flush_interval > 0 && ctx.unflushed >= ctx.flush_interval)
+                    flush_writes(&ctx);
+
+                /* Only the end of the device leaves a write short. */
+                if ((size_t)result < slot->len) {
+                    slot->len = result;
+                    if (window_end > slot->offset + result)
+                        window_end = slot->offset + result;
+                    if (ctx.chunk_end > window_end)
+                        ctx.chunk_end = window_end;
+
+                    clamp_chunks(&ctx, slot->offset + result);
+                }
+
+                /* A write-only pass is done with the block once the disk took it. */
+                if (write_only)
+                    chunk_verified(&ctx, slot->seq_offset, slot->seq_len, 0);
+
+                if (stream || write_only || lag > 0) {
+                    ctx.free_slots[ctx.num_free++] = tag;
+                    continue;
+                }
+
+                /* Read back the written block for verification. */
+                slot->op = IO_OP_READ;
+                throttle_block(&ctx, slot->len);
+                slot->submit_ns = stats_now_ns();
+
+                if (ioengine_queue(ctx.engine, IO_OP_READ, SLOT_BUF_INDEX, slot->buffer,
+                                   slot->len, slot->offset, tag) != IOENGINE_CHECK_OK)
+                    worker_fatal(&ctx, "Failed to queue read on disk device", errno);
+
+                continue;
+            }
+
+            /*
+             * An unreadable block is narrowed down to its bad sectors, it
+             * doesn't end the test. The rest of it is still checked below.
+             */
+            bad_sectors = 0;
+
+            if (result < 0) {
+                bad_sectors = recover_block(&ctx, slot, -result, !scan);
+                result = slot->len;
+
+                if (bad_sectors > 0)
+                    slot->dirty = true;
+            }
+
+            if (scan) {
+                if ((size_t)result != slot->len) {
+                    fprintf(stderr, "Read error on %s at offset #: %ld: short read\n",
+                                    device_name, slot->offset);
+                    stats_add(&ctx.stats->read_errors, 1);
+                }
+
+                stats_add(&ctx.stats->verified_bytes,
+                          good_bytes(slot->len, bad_sectors, sector_size));
+                chunk_verified(&ctx, slot->seq_offset, slot->seq_len, latency_ns);
+
+                ctx.free_slots[ctx.num_free++] = tag;
+                continue;
+            }
+
+            /*
+             * A verified buffer holds the base pattern again, so the next
+             * write through this slot only has to restamp the sector tags.
+             */
+            if ((size_t)result != slot->len) {
+                fprintf(stderr, "Error verifying block on %s at offset #: %ld: short read\n",
+                                device_name, slot->offset);
+                stats_add(&ctx.stats->mismatched_blocks, 1);
+                slot->dirty = true;
+            } else if (!pattern_check_block(&ctx.pattern, slot->buffer, slot->len,
+                                            slot->offset, &check)) {
+                pattern_describe_mismatch(&ctx.pattern, &check, mismatch, sizeof(mismatch));
+                fprintf(stderr, "Error verifying block on %s at offset #: %ld: %s\n",
+                                device_name, slot->offset, mismatch);
+                stats_add(&ctx.stats->mismatched_blocks, 1);
+                stats_add(&ctx.stats->mismatched_sectors, check.bad_sectors);
+                stats_add(&ctx.stats->bit_flips, check.bit_flips);
+                slot->dirty = true;
             }
+
+            stats_add(&ctx.stats->verified_bytes, good_bytes(slot->len, bad_sectors, sector_size));
+            chunk_verified(&ctx, slot->seq_offset, slot->seq_len, latency_ns);
+
+            ctx.free_slots[ctx.num_free++] = tag;
         }
+    }
+
+    /* The tail of the writes is flushed too, so every byte of the pass has been. */
+    if (ctx.flush_interval > 0 && ctx.unflushed > 0)
+        flush_writes(&ctx);
+
+    stats_add(&ctx.stats->busy_ns, stats_now_ns() - start_ns);
+
+    release_worker(&ctx);
+
+    /* Pause briefly to synchronize the output statistic. Nobody watches a probe. */
+    if (!ctx.workers->common_worker_params.probe)
+        sleep(3);
+
+    exit_worker(ctx.workers);
+
+    return NULL;
+}
+
+/* A null disk reads back what this pass would have written. */
+static void read_pattern(void *arg, char *buffer, size_t len, off_t offset)
+{
+    worker_ctx_t *ctx = (worker_ctx_t*)arg;
+
+    pattern_fill_block(&ctx->pattern, buffer, len, offset);
+}
+
+static size_t queue_block(worker_ctx_t *ctx, io_op_t op, off_t offset, off_t limit)
+{
+    io_slot_t *slot;
+    unsigned int tag = ctx->free_slots[--ctx->num_free];
+    ioengine_check_t result;
+
+    slot = &ctx->slots[tag];
+    slot->op = op;
+    slot->seq_offset = offset;
+    slot->seq_len = (limit - offset < ctx->blocksize) ? (size_t)(limit - offset) : ctx->blocksize;
+    slot->offset = offset;
+    slot->len = slot->seq_len;
+
+    /* The last block of the disk may be short wherever it comes in the order. */
+    if (ctx->permute != NULL) {
+        slot->offset = (off_t)permute_index(ctx->permute, (uint64_t)offset / ctx->blocksize) *
+                       ctx->blocksize;
+        slot->len = (ctx->disk_size - slot->offset < ctx->blocksize)
+                    ? (size_t)(ctx->disk_size - slot->offset) : ctx->blocksize;
+    }
+
+    if (op == IO_OP_WRITE) {
+        slot->pos = ctx->write_pos;
+        ctx->write_pos += slot->seq_len;
+
+        if (slot->dirty)
+            pattern_fill_block(&ctx->pattern, slot->buffer, slot->len, slot->offset);
+        else
+            pattern_stamp_block(&ctx->pattern, slot->buffer, slot->len, slot->offset);
+
+        slot->dirty = false;
+    }
+
+    throttle_block(ctx, slot->len);
+    slot->submit_ns = stats_now_ns();
+    result = ioengine_queue(ctx->engine, op, SLOT_BUF_INDEX, slot->buffer, slot->len,
+                            slot->offset, tag);
+
+    if (result != IOENGINE_CHECK_OK)
+        worker_fatal(ctx, "Failed to queue I/O on disk device", errno);
+
+    return slot->seq_len;
+}
+
+/* Read original data of a non-destructive run into the save buffer, or write it back. */
+static size_t queue_save_block(worker_ctx_t *ctx, io_op_t op, off_t offset, off_t window_start,
+                               off_t limit)
+{
+    io_slot_t *slot;
+    unsigned int tag = ctx->free_slots[--ctx->num_free];
+    ioengine_check_t result;
+
+    slot = &ctx->slots[tag];
+    slot->op = op;
+    slot->offset = offset;
+    slot->len = (limit - offset < ctx->blocksize) ? (size_t)(limit - offset) : ctx->blocksize;
+    throttle_block(ctx, slot->len);
+    slot->submit_ns = stats_now_ns();
+
+    result = ioengine_queue(ctx->engine, op, SAVE_BUF_INDEX, ctx->save + (offset - window_start),
+                            slot->len, offset, tag);
 
-        /* Read back the written block for verification. */
-        if (lseek(fd, -written_bytes, SEEK_CUR) == -1) {
-            local_errno = errno;
-            strerror_r(local_errno, error_buffer, sizeof(error_buffer));
-            fprintf(stderr, "Failed to seek on disk device: %s: %s\n", device_name,
-                            error_buffer);
-            free(buffer);
-            cleanup_workers();
-            exit(EXIT_FAILURE);
+    if (result != IOENGINE_CHECK_OK)
+        worker_fatal(ctx, "Failed to queue I/O on disk device", errno);
+
+    return slot->len;
+}
+
+/*
+ * Wait until the rate limit of the device lets a block of len bytes go.
+ * Blocks queued so far are submitted first, so they don't wait as well,
+ * and the wait is cut into short naps so Ctrl+C isn't held up by a low
+ * limit.
+ */
+static void throttle_block(worker_ctx_t *ctx, size_t len)
+{
+    uint64_t wait_ns = throttle_take(&ctx->workers->throttle, len);
+    uint64_t nap_ns;
+    struct timespec nap;
+
+    if (wait_ns == 0)
+        return;
+
+    stats_add(&ctx->stats->throttled_ns, wait_ns);
+
+    if (ioengine_submit(ctx->engine, 0) != IOENGINE_CHECK_OK)
+        worker_fatal(ctx, "Failed to submit I/O to disk device", errno);
+
+    while (wait_ns > 0 && !are_workers_stopping(ctx->workers)) {
+        nap_ns = (wait_ns < THROTTLE_NAP_NS) ? wait_ns : THROTTLE_NAP_NS;
+        nap.tv_sec = nap_ns / 1000000000ULL;
+        nap.tv_nsec = nap_ns % 1000000000ULL;
+        nanosleep(&nap, NULL);
+        wait_ns -= nap_ns;
+    }
+}
+
+/*
+ * The original data of the window has been written back. The undo record
+ * may only go once that data is on stable media, not in the drive's cache.
+ */
+static void window_restored(worker_ctx_t *ctx)
+{
+    if (fdatasync(ctx->fd) == -1)
+        worker_fatal(ctx, "Failed to flush restored data to disk device", errno);
+
+    undo_clear(ctx->undo, ctx->id);
+}
+
+/*
+ * Wipe every chunk the scheduler hands out, a window per call, so the
+ * progress, the zones and a rate limit see the wipe move along. Nothing
+ * is read back. A zero-out the disk can't offload is done by writing
+ * zeros instead, as large as the slot buffers of the worker allow; a
+ * discard can't be emulated and fails the device.
+ */
+static void wipe_chunks(worker_ctx_t *ctx, disk_wipe_t wipe)
+{
+    off_t chunk_start;
+    off_t chunk_end;
+    off_t len;
+    uint64_t start_ns;
+    uint64_t latency_ns;
+    bool offload = (ctx->fd != -1);
+    diskdev_check_t result;
+
+    memset(ctx->buffer, 0, (size_t)ctx->blocksize * ctx->queue_depth);
+
+    while (!are_workers_stopping(ctx->workers) &&
+           sched_next_chunk(&ctx->workers->scheduler, ctx->id, &chunk_start, &chunk_end)) {
+        for (off_t offset = chunk_start; offset < chunk_end; offset += len) {
+            len = (chunk_end - offset < ctx->window) ? chunk_end - offset : ctx->window;
+
+            throttle_block(ctx, (size_t)len);
+            start_ns = stats_now_ns();
+
+            /* A null disk has nothing to wipe. */
+            if (ctx->fd == -1)
+                result = DISKDEV_CHECK_OK;
+            else if (offload)
+                result = disk_wipe_range(ctx->fd, wipe, offset, len);
+            else
+                result = DISKDEV_CHECK_ERR_UNSUPPORTED;
+
+            if (result == DISKDEV_CHECK_ERR_UNSUPPORTED && wipe == DISK_WIPE_ZERO) {
+                lock_mutex(&ctx->workers->mutex_workers_run);
+
+                if (!ctx->workers->wipe_fallback)
+                    fprintf(stderr, "%s can't offload the zero-out, writing zeros instead.\n",
+                                    ctx->device_name);
+
+                ctx->workers->wipe_fallback = true;
+                unlock_mutex(&ctx->workers->mutex_workers_run);
+
+                offload = false;
+                write_zeros(ctx, offset, len);
+            } else if (result == DISKDEV_CHECK_ERR_UNSUPPORTED) {
+                worker_fatal(ctx, (wipe == DISK_WIPE_DISCARD)
+                                  ? "Discard is not supported by disk device"
+                                  : "Secure discard is not supported by disk device", EOPNOTSUPP);
+            } else if (result != DISKDEV_CHECK_OK) {
+                worker_fatal(ctx, "Failed to wipe disk device", errno);
+            }
+
+            latency_ns = stats_now_ns() - start_ns;
+            hist_record(&ctx->stats->write_latency, latency_ns);
+            zones_record(&ctx->workers->zones, IO_OP_WRITE, offset, (uint64_t)len, latency_ns,
+                         latency_ns);
+            stats_add(&ctx->stats->written_bytes, (uint64_t)len);
         }
 
-        if (read(fd, buffer, written_bytes) == -1) {
-            local_errno = errno;
-            strerror_r(local_errno, error_buffer, sizeof(error_buffer));
-            fprintf(stderr, "Failed to read back written data on disk device: %s: %s\n", device_name,
-                            error_buffer);
-            free(buffer);
-            cleanup_workers();
-            exit(EXIT_FAILURE);
+        sched_chunk_done(&ctx->workers->scheduler, chunk_start);
+    }
+}
+
+/* Zeros from the slot buffers, which hold nothing else during a wipe. */
+static void write_zeros(worker_ctx_t *ctx, off_t offset, off_t len)
+{
+    size_t size = (size_t)ctx->blocksize * ctx->queue_depth;
+    char error_buffer[256];
+    uint64_t bad_sectors;
+    size_t count;
+    ssize_t result;
+    int errnum;
+
+    for (off_t end = offset + len; offset < end; offset += count) {
+        count = (end - offset < (off_t)size) ? (size_t)(end - offset) : size;
+
+        if ((result = pwrite(ctx->fd, ctx->buffer, count, offset)) == (ssize_t)count)
+            continue;
+
+        errnum = (result == -1) ? errno : EIO;
+        start_retries(ctx);
+
+        if ((bad_sectors = bisect_range(ctx, IO_OP_WRITE, ctx->buffer, NULL, count, offset,
+                                        ctx->retries)) == 0)
+            continue;
+
+        fprintf(stderr, "Write error on %s at offset #: %ld: %s, %llu bad sectors\n",
+                        ctx->device_name, offset,
+                        worker_strerror(errnum, error_buffer, sizeof(error_buffer)),
+                        (unsigned long long)bad_sectors);
+        stats_add(&ctx->stats->write_errors, 1);
+        stats_add(&ctx->stats->bad_sectors, bad_sectors);
+    }
+}
+
+/*
+ * A write that went through only in part is finished synchronously rather
+ * than cutting the pass short. Only the end of the device stops it, and
+ * an error goes on to the retries of the whole block. Returns the bytes
+ * written or a negative errno.
+ */
+static ssize_t finish_write(worker_ctx_t *ctx, io_slot_t *slot, size_t done)
+{
+    ssize_t result;
+
+    while (done < slot->len) {
+        result = ioengine_pwrite(ctx->engine, slot->buffer + done, slot->len - done,
+                                 slot->offset + (off_t)done);
+
+        if (result == 0 || (result == -1 && errno == ENOSPC))
+            break;
+        else if (result == -1)
+            return -errno;
+
+        done += result;
+    }
+
+    return (ssize_t)done;
+}
+
+/*
+ * A block failed. It is retried as a whole first, then split in halves
+ * down to single sectors, so only the sectors that really fail are marked
+ * bad and the rest of the block is still written or read. The retries are
+ * synchronous: they hold up this worker only, the others go on at full
+ * speed. Returns the number of bad sectors, 0 if the whole block went
+ * through after all.
+ *
+ * With verify set the parts that went through are checked too. Those of a
+ * write are read back right away. A read gets the data the block should
+ * hold in place of its bad sectors, so the block can be checked as usual
+ * and any corruption in the rest of it still shows.
+ */
+static uint64_t recover_block(worker_ctx_t *ctx, io_slot_t *slot, int errnum, bool verify)
+{
+    char error_buffer[256];
+    char *check_buffer = NULL;
+    uint64_t bad_sectors;
+
+    if (verify) {
+        if (ctx->retry_buffer == NULL &&
+            posix_memalign((void**)&ctx->retry_buffer, ARENA_BUFFER_ALIGN, ctx->blocksize) != 0)
+            worker_fatal(ctx, "No free memory to allocate for device", ENOMEM);
+
+        check_buffer = ctx->retry_buffer;
+
+        if (slot->op == IO_OP_READ)
+            pattern_fill_block(&ctx->pattern, check_buffer, slot->len, slot->offset);
+    }
+
+    start_retries(ctx);
+    bad_sectors = bisect_range(ctx, slot->op, slot->buffer, check_buffer, slot->len, slot->offset,
+                               ctx->retries);
+
+    if (bad_sectors == 0) {
+        fprintf(stderr, "%s error on %s at offset #: %ld went away on retry: %s\n",
+                        (slot->op == IO_OP_WRITE) ? "Write" : "Read", ctx->device_name,
+                        slot->offset, worker_strerror(errnum, error_buffer, sizeof(error_buffer)));
+        stats_add(&ctx->stats->recovered_errors, 1);
+        return 0;
+    }
+
+    fprintf(stderr, "%s error on %s at offset #: %ld: %s, %llu bad sectors\n",
+                    (slot->op == IO_OP_WRITE) ? "Write" : "Read", ctx->device_name, slot->offset,
+                    worker_strerror(errnum, error_buffer, sizeof(error_buffer)),
+                    (unsigned long long)bad_sectors);
+    stats_add((slot->op == IO_OP_WRITE) ? &ctx->stats->write_errors : &ctx->stats->read_errors, 1);
+    stats_add(&ctx->stats->bad_sectors, bad_sectors);
+
+    return bad_sectors;
+}
+
+/*
+ * Every failed block gets the same budget of retries. A dead region would
+ * otherwise cost two I/Os per sector of every block in it, and stall the
+ * worker for hours.
+ */
+static void start_retries(worker_ctx_t *ctx)
+{
+    ctx->retry_ios = RETRY_MAX_IOS;
+    ctx->retry_deadline_ns = stats_now_ns() + RETRY_MAX_NS;
+    ctx->retry_mismatch = false;
+}
+
+/*
+ * Try the range attempts times, then each of its halves once. A single
+ * sector that still fails goes into the bad-block map, and so does the
+ * rest of the range once the retries of the block are used up. Returns
+ * the number of bad sectors in the range.
+ */
+static uint64_t bisect_range(worker_ctx_t *ctx, io_op_t op, char *buffer, char *check_buffer,
+                             size_t len, off_t offset, unsigned int attempts)
+{
+    unsigned int sector_size = ctx->pattern.sector_size;
+    size_t half;
+    ssize_t result;
+
+    for (unsigned int i = 0; i < attempts; i++) {
+        if (ctx->retry_ios == 0 || stats_now_ns() >= ctx->retry_deadline_ns)
+            return mark_bad(ctx, op, buffer, check_buffer, len, offset);
+
+        ctx->retry_ios--;
+        result = (op == IO_OP_WRITE) ? ioengine_pwrite(ctx->engine, buffer, len, offset)
+                                     : pread(ctx->fd, buffer, len, offset);
+
+        if (result == (ssize_t)len)
+            return 0;
+    }
+
+    if (len <= sector_size)
+        return mark_bad(ctx, op, buffer, check_buffer, len, offset);
+
+    half = len / sector_size / 2 * sector_size;
+
+    return retry_part(ctx, op, buffer, check_buffer, half, offset) +
+           retry_part(ctx, op, buffer + half, (check_buffer != NULL) ? check_buffer + half : NULL,
+                      len - half, offset + half);
+}
+
+/* One half of a failed range. A half that could be written is read back at once. */
+static uint64_t retry_part(worker_ctx_t *ctx, io_op_t op, char *buffer, char *check_buffer,
+                           size_t len, off_t offset)
+{
+    uint64_t bad_sectors = bisect_range(ctx, op, buffer, check_buffer, len, offset, 1);
+
+    if (bad_sectors > 0 || op != IO_OP_WRITE || check_buffer == NULL)
+        return bad_sectors;
+
+    ctx->retry_ios = (ctx->retry_ios > 0) ? ctx->retry_ios - 1 : 0;
+
+    if (pread(ctx->fd, check_buffer, len, offset) != (ssize_t)len ||
+        memcmp(buffer, check_buffer, len) != 0)
+        ctx->retry_mismatch = true;
+
+    return 0;
+}
+
+/*
+ * A read range that is given up on gets the data it should hold, so only
+ * the rest of the block is checked. Returns the number of its sectors.
+ */
+static uint64_t mark_bad(worker_ctx_t *ctx, io_op_t op, char *buffer, char *check_buffer,
+                         size_t len, off_t offset)
+{
+    unsigned int sector_size = ctx->pattern.sector_size;
+
+    if (badmap_add(ctx->badmap, (uint64_t)offset, len) != BADMAP_CHECK_OK)
+        worker_fatal(ctx, "No free memory to allocate for device", ENOMEM);
+
+    if (op == IO_OP_READ && check_buffer != NULL)
+        memcpy(buffer, check_buffer, len);
+
+    return (len + sector_size - 1) / sector_size;
+}
+
+/*
+ * Move on to the next window: the rest of the current chunk, or a new
+ * chunk from the scheduler. Returns false and leaves an empty window
+ * once there is nothing left to take or the workers are being stopped.
+ */
+static bool next_window(worker_ctx_t *ctx, off_t *window_start, off_t *window_end)
+{
+    off_t chunk_start;
+
+    if (*window_end < ctx->chunk_end) {
+        *window_start = *window_end;
+    } else if (!are_workers_stopping(ctx->workers) &&
+               sched_next_chunk(&ctx->workers->scheduler, ctx->id, &chunk_start, &ctx->chunk_end)) {
+        *window_start = chunk_start;
+
+        /* Without a free entry the chunk just never counts as finished. */
+        if (ctx->num_held < ctx->max_held) {
+            ctx->held[ctx->num_held].start = chunk_start;
+            ctx->held[ctx->num_held].end = ctx->chunk_end;
+            ctx->held[ctx->num_held].verified = 0;
+            ctx->held[ctx->num_held].max_ns = 0;
+            ctx->held[ctx->num_held].total_ns = 0;
+            ctx->held[ctx->num_held].num_reads = 0;
+            ctx->num_held++;
         }
+    } else {
+        *window_start = *window_end;
+        return false;
+    }
+
+    *window_end = (ctx->chunk_end - *window_start < ctx->window) ? ctx->chunk_end
+                                                                : *window_start + ctx->window;
+
+    return true;
+}
+
+/* A window of the write stream is to be read back once the lag has passed it. */
+static void lag_push(worker_ctx_t *ctx, off_t window_start, off_t window_end)
+{
+    lag_range_t *range = &ctx->lag_ranges[(ctx->lag_head + ctx->num_lag++) % ctx->max_lag];
+
+    range->start = window_start;
+    range->end = window_end;
+    range->next = window_start;
+    range->pos = ctx->write_pos;
+}
+
+/*
+ * The window whose next block may be read back now, or NULL. That block
+ * is due once all writes up to lag bytes past it have completed, so it
+ * comes back from the media rather than from the drive's write cache.
+ * With the writes done or the ring full, it only waits for its own
+ * write. A flush, if asked for, covers every completed write at once,
+ * so the next one is only needed lag bytes later.
+ */
+static lag_range_t *lag_next_read(worker_ctx_t *ctx, bool drain)
+{
+    lag_range_t *range;
+    off_t completed = ctx->write_pos;
+    off_t due;
+
+    while (ctx->num_lag > 0) {
+        range = &ctx->lag_ranges[ctx->lag_head];
+
+        if (range->next < range->end)
+            break;
+
+        ctx->lag_head = (ctx->lag_head + 1) % ctx->max_lag;
+        ctx->num_lag--;
+    }
+
+    if (ctx->num_lag == 0)
+        return NULL;
+
+    /* Writes complete out of order; the oldest one still in flight holds the rest up. */
+    for (unsigned int i = 0; i < ctx->queue_depth; i++) {
+        if (ctx->slots[i].pos >= 0 && ctx->slots[i].pos < completed)
+            completed = ctx->slots[i].pos;
+    }
+
+    due = range->pos + (range->next - range->start) +
+          ((range->end - range->next < ctx->blocksize) ? range->end - range->next
+                                                       : ctx->blocksize);
+
+    if (due > completed || (!drain && ctx->num_lag < ctx->max_lag && due + ctx->lag > completed))
+        return NULL;
+
+    if (ctx->lag_flush && due > ctx->flushed_pos) {
+        flush_writes(ctx);
+        ctx->flushed_pos = completed;
+    }
+
+    return range;
+}
+
+/*
+ * Flush the drive's write cache. A drive may take writes quickly and stall
+ * on the flush, so its latency is recorded apart from the writes'. A null
+ * disk has no cache to flush.
+ */
+static void flush_writes(worker_ctx_t *ctx)
+{
+    uint64_t start_ns = stats_now_ns();
+
+    ctx->unflushed = 0;
+
+    if (ctx->fd == -1)
+        return;
+
+    if (fdatasync(ctx->fd) == -1)
+        worker_fatal(ctx, "Failed to flush the write cache of disk device", errno);
+
+    hist_record(&ctx->stats->flush_latency, stats_now_ns() - start_ns);
+}
+
+/*
+ * A chunk is finished once all of its blocks have been verified, whatever
+ * the outcome. Only then is it marked in the scheduler's bitmap, so the
+ * journal never records a chunk with blocks still in flight. Blocks of a
+ * chunk may complete out of order, and with a deep queue several chunks
+ * can have blocks in flight at once.
+ */
+static void chunk_verified(worker_ctx_t *ctx, off_t offset, size_t len, uint64_t latency_ns)
+{
+    held_chunk_t *held;
+
+    for (unsigned int i = 0; i < ctx->num_held; i++) {
+        held = &ctx->held[i];
+
+        if (offset < held->start || offset >= held->start + ctx->workers->scheduler.chunk_size)
+            continue;
+
+        held->verified += len;
+
+        /* Blocks of a write-only pass are never read and come without a latency. */
+        if (latency_ns > 0) {
+            held->total_ns += latency_ns;
+            held->num_reads++;
 
-        if (memcmp(wr_data, buffer, written_bytes) != 0) {
-            fprintf(stderr, "Error verifying block at offset #: %ld\n", current_offset);
+            if (latency_ns > held->max_ns)
+                held->max_ns = latency_ns;
         }
 
-        lock_mutex(&mutex_verified_bytes);
-        verified_bytes += written_bytes;
-        unlock_mutex(&mutex_verified_bytes);
+        if (held->verified >= held->end - held->start)
+            finish_chunk(ctx, held);
+
+        return;
+    }
+}
+
+/* The device ends at offset, so no held chunk nor lagged window can have blocks past it. */
+static void clamp_chunks(worker_ctx_t *ctx, off_t offset)
+{
+    held_chunk_t *held;
+    lag_range_t *range;
+
+    unsigned int i = 0;
+
+    for (unsigned int j = 0; j < ctx->num_lag; j++) {
+        range = &ctx->lag_ranges[(ctx->lag_head + j) % ctx->max_lag];
 
-        current_offset += written_bytes;
+        if (range->end > offset)
+            range->end = (offset > range->start) ? offset : range->start;
     }
 
-exit_worker:
-    free(buffer);
-    close(fd);
+    while (i < ctx->num_held) {
+        held = &ctx->held[i];
 
-    /* Pause briefly to synchronize the output statistic. */
-    sleep(3);
+        if (held->end > offset)
+            held->end = (offset > held->start) ? offset : held->start;
 
-    lock_mutex(&mutex_workers_run);
-    workers_run--;
-    unlock_mutex(&mutex_workers_run);
+        if (held->verified >= held->end - held->start)
+            finish_chunk(ctx, held);
+        else
+            i++;
+    }
+}
+
+/* Mark the chunk done, note how slow its reads were and drop it from the held ones. */
+static void finish_chunk(worker_ctx_t *ctx, held_chunk_t *held)
+{
+    region_latency_t region;
+
+    sched_chunk_done(&ctx->workers->scheduler, held->start);
+
+    /* A chunk of a random pass is scattered over the whole disk, it is no region. */
+    if (held->num_reads > 0 && ctx->permute == NULL) {
+        region.offset = (uint64_t)held->start;
+        region.len = (uint64_t)(held->end - held->start);
+        region.max_ns = held->max_ns;
+        region.total_ns = held->total_ns;
+        region.num_reads = held->num_reads;
+        stats_add_region(ctx->stats->slow_regions, &region);
+    }
+
+    *held = ctx->held[--ctx->num_held];
+}
+
+/*
+ * Closing the engine also waits for or cancels its in-flight requests, so
+ * the slots can be freed right after it. The buffers belong to the arena.
+ */
+static void release_worker(worker_ctx_t *ctx)
+{
+    ioengine_destroy(ctx->engine);
+    free(ctx->held);
+    free(ctx->lag_ranges);
+    free(ctx->completions);
+    free(ctx->free_slots);
+    free(ctx->slots);
+    free(ctx->retry_buffer);
+
+    if (ctx->fd != -1)
+        close(ctx->fd);
+}
+
+static void exit_worker(workers_t *workers)
+{
+    lock_mutex(&workers->mutex_workers_run);
+    workers->workers_run--;
+    unlock_mutex(&workers->mutex_workers_run);
 
     pthread_exit(NULL);
 }
 
+/*
+ * A fatal error takes only its own device out of the test: the other
+ * workers of the device stop, while the other devices keep running.
+ */
+static void worker_fatal(worker_ctx_t *ctx, const char *message, int errnum)
+{
+    char error_buffer[256] = {0};
+
+    fprintf(stderr, "%s: %s: %s\n", message, ctx->device_name,
+                    worker_strerror(errnum, error_buffer, sizeof(error_buffer)));
+
+    ctx->workers->failed = true;
+    ctx->workers->stop = true;
+
+    release_worker(ctx);
+    exit_worker(ctx->workers);
+}
+
+/*
+ * Thread-safe strerror(). With _GNU_SOURCE, glibc's strerror_r() returns
+ * the message and may leave the buffer untouched.
+ */
+static const char *worker_strerror(int errnum, char *buffer, size_t size)
+{
+#if defined(__GLIBC__) && defined(_GNU_SOURCE)
+    return strerror_r(errnum, buffer, size);
+#else
+    strerror_r(errnum, buffer, size);
+
+    return buffer;
+#endif
+}
+
+/* Bytes of a block outside its bad sectors, the ones that could be checked. */
+static inline uint64_t good_bytes(size_t len, uint64_t bad_sectors, unsigned int sector_size)
+{
+    uint64_t bad_bytes = bad_sectors * sector_size;
+
+    return (bad_bytes < len) ? len - bad_bytes : 0;
+}
+
+static inline bool are_workers_stopping(workers_t *workers)
+{
+    return workers_stop || workers->stop;
+}
+
 static inline void lock_mutex(pthread_mutex_t *mutex)
 {
     char error_buffer[256] = {0};
     int mutex_errno;
 
     if ((mutex_errno = pthread_mutex_lock(mutex)) != 0) {
-        strerror_r(mutex_errno, error_buffer, sizeof(error_buffer));
-        fprintf(stderr, "Failed to lock mutex: %s\n", error_buffer);
-        cleanup_workers();
+        fprintf(stderr, "Failed to lock mutex: %s\n",
+                        worker_strerror(mutex_errno, error_buffer, sizeof(error_buffer)));
         exit(EXIT_FAILURE);
     }
 
@@ -317,62 +1569,131 @@ static inline void unlock_mutex(pthread_mutex_t *mutex)
     int mutex_errno;
 
     if ((mutex_errno = pthread_mutex_unlock(mutex)) != 0) {
-        strerror_r(mutex_errno, error_buffer, sizeof(error_buffer));
-        fprintf(stderr, "Failed to unlock mutex: %s\n", error_buffer);
-        cleanup_workers();
+        fprintf(stderr, "Failed to unlock mutex: %s\n",
+                        worker_strerror(mutex_errno, error_buffer, sizeof(error_buffer)));
         exit(EXIT_FAILURE);
     }
 
     return;
 }
 
-bool are_workers_running(void)
+bool are_workers_running(workers_t *workers)
 {
     bool workers_runing = false;
 
-    lock_mutex(&mutex_workers_run);
+    lock_mutex(&workers->mutex_workers_run);
 
-    if (workers_run)
+    if (workers->workers_run)
         workers_runing = true;
 
-    unlock_mutex(&mutex_workers_run);
+    unlock_mutex(&workers->mutex_workers_run);
 
     return workers_runing;
 }
 
-off_t get_workers_progress(void)
+bool have_workers_failed(workers_t *workers)
+{
+    return workers->failed;
+}
+
+int get_workers_numa_node(workers_t *workers)
+{
+    return topology_numa_node(workers->topology);
+}
+
+void get_workers_progress(workers_t *workers, off_t *written, off_t *verified)
 {
     /*
-     *  The return value from the function are the bytes verified by  all workers.
+     *  Report the bytes written and the bytes verified by all workers of the device.
      */
 
-    off_t vrfd_bytes;
+    *written = 0;
+    *verified = 0;
 
-    lock_mutex(&mutex_verified_bytes);
-    vrfd_bytes = verified_bytes;
-    unlock_mutex(&mutex_verified_bytes);
+    /* Plain relaxed reads: each counter is only ever written by its own worker. */
+    for (unsigned int i = 0; i < workers->num_workers; i++) {
+        *written += stats_get(&workers->stats[i].written_bytes);
+        *verified += stats_get(&workers->stats[i].verified_bytes);
+    }
 
-    return vrfd_bytes;
+    return;
 }
 
-void cleanup_workers(void)
+/* Writes and reads completed by all workers of the device. */
+void get_workers_ops(workers_t *workers, uint64_t *writes, uint64_t *reads)
 {
-    pthread_mutex_destroy(&mutex_verified_bytes);
-    pthread_mutex_destroy(&mutex_workers_run);
-    pthread_attr_destroy(&tattr);
+    *writes = 0;
+    *reads = 0;
 
-    if (common_worker_params->wr_data != NULL)
-        free((void*)common_worker_params->wr_data);
+    for (unsigned int i = 0; i < workers->num_workers; i++) {
+        *writes += stats_get(&workers->stats[i].write_latency.count);
+        *reads += stats_get(&workers->stats[i].read_latency.count);
+    }
+}
 
-    if (common_worker_params != NULL)
-        free(common_worker_params);
+worker_stats_t *get_workers_stats(workers_t *workers)
+{
+    return workers->stats;
+}
 
-    if (worker_params != NULL)
-        free(worker_params);
+/* Limits for the next pass in bytes and operations per second, 0 for none. */
+void throttle_workers(workers_t *workers, uint64_t bytes_per_sec, uint64_t ops_per_sec)
+{
+    throttle_set(&workers->throttle, bytes_per_sec, ops_per_sec);
+}
 
-    if (workers_id != NULL)
-        free(workers_id);
+/*
+ * Change what the next pass does: a wipe, the order of the blocks and
+ * whether they are read back. A preconditioning run goes through all of
+ * them with the same workers. Only set while no worker runs.
+ */
+void set_workers_mode(workers_t *workers, disk_wipe_t wipe, bool random, bool write_only)
+{
+    workers->common_worker_params.wipe = wipe;
+    workers->common_worker_params.random = random;
+    workers->common_worker_params.write_only = write_only;
+}
 
-    return;
+zones_t *get_workers_zones(workers_t *workers)
+{
+    return &workers->zones;
+}
+
+/* The chunks the disk is cut into, as the checkpoint journal records them. */
+void get_workers_chunks(workers_t *workers, off_t *chunk_size, uint64_t *num_chunks)
+{
+    *chunk_size = workers->scheduler.chunk_size;
+    *num_chunks = workers->scheduler.num_chunks;
+}
+
+/* Bitmap of the chunks finished in the current pass. */
+void get_workers_done(workers_t *workers, uint64_t *done)
+{
+    sched_get_done(&workers->scheduler, done);
 }
 
+void cleanup_workers(workers_t *workers)
+{
+    if (workers == NULL)
+        return;
+
+    pthread_mutex_destroy(&workers->mutex_workers_run);
+    pthread_attr_destroy(&workers->tattr);
+
+    if (workers->worker_params != NULL)
+        free(workers->worker_params);
+
+    if (workers->stats != NULL)
+        free(workers->stats);
+
+    sched_destroy(&workers->scheduler);
+    zones_destroy(&workers->zones);
+    topology_destroy(workers->topology);
+
+    if (workers->workers_id != NULL)
+        free(workers->workers_id);
+
+    free(workers);
+
+    return;
+}
@@ -31,20 +31,81 @@
 #ifndef WORKERS_H
 #define WORKERS_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "arena.h"
+#include "badmap.h"
+#include "disk.h"
+#include "ioengine.h"
+#include "pattern.h"
+#include "stats.h"
+#include "undo.h"
+#include "zones.h"
+
 extern int pthread_errno;
 
+/* Workers of one disk device. Any number of devices can be tested at once. */
+typedef struct workers_t workers_t;
+
+typedef struct workers_config_t {
+    const char *device_name;
+    arena_t *arena;         /* Where the I/O buffers of the workers are carved from. */
+    off_t disk_size;
+    unsigned int num_workers;
+    unsigned int blocksize;
+    unsigned int sector_size;
+    ioengine_type_t engine;
+    unsigned int queue_depth;
+    bool stream;            /* Write a whole window before reading it back. */
+    off_t stream_window;    /* Streaming window in bytes, 0 for the whole chunk. */
+    off_t chunk_size;       /* Unit of work handed out to the workers. */
+    pattern_schedule_t patterns;    /* Base data of every pass, empty for the data stream. */
+    bool tag_sectors;       /* Stamp every sector with its LBA, the pass and run_id. */
+    bool verify_only;       /* Only read back and check blocks of an earlier run. */
+    bool scan;              /* Only read, to find unreadable and slow regions. */
+    disk_wipe_t wipe;       /* Only wipe the chunks, through the device if it can. */
+    undo_t *undo;           /* Non-destructive: save and restore every window through it. */
+    bool random;            /* Visit the blocks in a pseudo-random order. */
+    bool write_only;        /* Only write the blocks, without reading them back. */
+    off_t verify_lag;       /* Bytes a worker writes after a block before reading it back. */
+    bool verify_flush;      /* Flush the drive's cache before a lagged read-back. */
+    bool dsync;             /* Every write is durable once it completes: FUA or write+flush. */
+    off_t flush_interval;   /* Bytes a worker writes between cache flushes, 0 for none. */
+    badmap_t *badmap;       /* Where sectors that keep failing are recorded. */
+    unsigned int retries;   /* Attempts at a failed block before it is bisected. */
+    off_t zone_size;        /* LBA range of one zone of the throughput profile, 0 for 1 GiB. */
+    bool numa;              /* Place workers and buffers close to the device. */
+    bool probe;             /* A short autotune run: no pause for the progress at the end. */
+    uint32_t run_id;
+} workers_config_t;
+
 typedef enum {
     WORKERS_CHECK_OK = 0,
     WORKERS_CHECK_ERR_MEM_ALLOC,
     WORKERS_CHECK_ERR_PTHREAD
 } workers_check_t;
 
-workers_check_t init_workers(unsigned int, const char*, off_t, unsigned int, unsigned int, const char*);
-workers_check_t start_workers(void);
-bool are_workers_running(void);
-off_t get_workers_progress(void);
-void cleanup_workers(void);
+size_t workers_buffer_size(unsigned int, unsigned int, unsigned int, size_t);
+off_t random_block_offset(off_t, unsigned int, uint32_t, unsigned int, off_t);
+workers_check_t init_workers(workers_t**, const workers_config_t*);
+workers_check_t start_workers(workers_t*, unsigned int, const uint64_t*);
+bool are_workers_running(workers_t*);
+bool have_workers_failed(workers_t*);
+int get_workers_numa_node(workers_t*);
+void get_workers_progress(workers_t*, off_t*, off_t*);
+void get_workers_ops(workers_t*, uint64_t*, uint64_t*);
+worker_stats_t *get_workers_stats(workers_t*);
+void throttle_workers(workers_t*, uint64_t, uint64_t);
+void set_workers_mode(workers_t*, disk_wipe_t, bool, bool);
+zones_t *get_workers_zones(workers_t*);
+void get_workers_chunks(workers_t*, off_t*, uint64_t*);
+void get_workers_done(workers_t*, uint64_t*);
+void cleanup_workers(workers_t*);
+void halt_workers(workers_t*);
 void stop_workers(void);
+bool are_workers_stopped(void);
 
 #endif
 
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "zones.h"
+#include "utils.h"
+
+/*
+ * Internal functions' prototypes
+ */
+
+static inline void store_max(_Atomic uint64_t*, uint64_t);
+static double zone_rate(uint64_t, uint64_t, unsigned int);
+static bool write_zones(FILE*, zones_t*, zones_format_t, const char*, unsigned int, unsigned int);
+
+/* A zone_size of 0 picks the default. */
+zones_check_t zones_init(zones_t *zones, off_t disk_size, off_t zone_size)
+{
+    if (zone_size <= 0)
+        zone_size = ZONES_DEFAULT_SIZE;
+
+    while ((disk_size + zone_size - 1) / zone_size > ZONES_MAX)
+        zone_size *= 2;
+
+    zones->zone_size = zone_size;
+    zones->disk_size = disk_size;
+    zones->num_zones = (uint64_t)((disk_size + zone_size - 1) / zone_size);
+
+    if ((zones->zones = calloc(zones->num_zones ? zones->num_zones : 1, sizeof(zone_t))) == NULL)
+        return ZONES_CHECK_ERR_MEM_ALLOC;
+
+    return ZONES_CHECK_OK;
+}
+
+void zones_reset(zones_t *zones)
+{
+    memset(zones->zones, 0, zones->num_zones * sizeof(zone_t));
+}
+
+/* An I/O that crosses into the next zone counts for the zone it starts in. */
+void zones_record(zones_t *zones, io_op_t op, off_t offset, uint64_t bytes, uint64_t busy_ns,
+                  uint64_t latency_ns)
+{
+    zone_t *zone;
+
+    if ((uint64_t)(offset / zones->zone_size) >= zones->num_zones)
+        return;
+
+    zone = &zones->zones[offset / zones->zone_size];
+
+    if (op == IO_OP_WRITE) {
+        atomic_fetch_add_explicit(&zone->write_bytes, bytes, memory_order_relaxed);
+        atomic_fetch_add_explicit(&zone->write_ns, busy_ns, memory_order_relaxed);
+        store_max(&zone->max_write_ns, latency_ns);
+    } else {
+        atomic_fetch_add_explicit(&zone->read_bytes, bytes, memory_order_relaxed);
+        atomic_fetch_add_explicit(&zone->read_ns, busy_ns, memory_order_relaxed);
+        store_max(&zone->max_read_ns, latency_ns);
+    }
+}
+
+zones_check_t zones_parse_format(const char *name, zones_format_t *format)
+{
+    if (strcmp(name, "csv") == 0)
+        *format = ZONES_FORMAT_CSV;
+    else if (strcmp(name, "json") == 0)
+        *format = ZONES_FORMAT_JSON;
+    else
+        return ZONES_CHECK_ERR_UNKNOWN_FORMAT;
+
+    return ZONES_CHECK_OK;
+}
+
+const char *zones_suffix(zones_format_t format)
+{
+    return (format == ZONES_FORMAT_JSON) ? ZONES_SUFFIX_JSON : ZONES_SUFFIX_CSV;
+}
+
+/*
+ * Write the profile of a pass to path, replacing an older one only once
+ * the new one is complete. Throughput is given for the whole device, as
+ * if all num_workers workers were running in the zone.
+ */
+zones_check_t zones_export(zones_t *zones, const char *path, zones_format_t format,
+                           const char *device_name, unsigned int pass, unsigned int num_workers)
+{
+    FILE *file;
+    char *tmp_path;
+    bool written;
+
+    if ((tmp_path = malloc(strlen(path) + sizeof(".tmp"))) == NULL)
+        return ZONES_CHECK_ERR_MEM_ALLOC;
+
+    sprintf(tmp_path, "%s.tmp", path);
+
+    if ((file = fopen(tmp_path, "w")) == NULL) {
+        free(tmp_path);
+        return ZONES_CHECK_ERR_IO;
+    }
+
+    written = write_zones(file, zones, format, device_name, pass, num_workers);
+    written = (fclose(file) == 0) && written;
+
+    if (!written || rename(tmp_path, path) == -1) {
+        unlink(tmp_path);
+        free(tmp_path);
+        return ZONES_CHECK_ERR_IO;
+    }
+
+    free(tmp_path);
+
+    return ZONES_CHECK_OK;
+}
+
+void zones_destroy(zones_t *zones)
+{
+    free(zones->zones);
+    zones->zones = NULL;
+    zones->num_zones = 0;
+}
+
+static inline void store_max(_Atomic uint64_t *max, uint64_t value)
+{
+    uint64_t current = atomic_load_explicit(max, memory_order_relaxed);
+
+    while (value > current &&
+           !atomic_compare_exchange_weak_explicit(max, &current, value, memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+}
+
+/* MB/s of the device in the zone: the workers shared the time, each ran 1/num_workers of it. */
+static double zone_rate(uint64_t bytes, uint64_t busy_ns, unsigned int num_workers)
+{
+    if (busy_ns == 0)
+        return 0.0;
+
+    return bytes / 1024.0 / 1024.0 / (busy_ns / 1e9 / num_workers);
+}
+
+static bool write_zones(FILE *file, zones_t *zones, zones_format_t format, const char *device_name,
+                        unsigned int pass, unsigned int num_workers)
+{
+    zone_t *zone;
+    uint64_t offset;
+    uint64_t len;
+
+    if (format == ZONES_FORMAT_CSV) {
+        fprintf(file, "offset_mb,size_mb,write_mb_s,read_mb_s,max_write_ms,max_read_ms\n");
+    } else {
+        fprintf(file, "{\n  \"device\": ");
+        write_json_string(file, device_name);
+        fprintf(file, ",\n  \"pass\": %u,\n  \"zone_size\": %lld,\n  \"zones\": [",
+                      pass, (long long)zones->zone_size);
+    }
+
+    for (uint64_t i = 0; i < zones->num_zones; i++) {
+        zone = &zones->zones[i];
+        offset = i * (uint64_t)zones->zone_size;
+        len = ((uint64_t)zones->disk_size - offset < (uint64_t)zones->zone_size)
+              ? (uint64_t)zones->disk_size - offset : (uint64_t)zones->zone_size;
+
+        if (format == ZONES_FORMAT_CSV)
+            fprintf(file, "%" PRIu64 ",%" PRIu64 ",%.1f,%.1f,%.3f,%.3f\n",
+                          offset / 1024 / 1024, len / 1024 / 1024,
+                          zone_rate(zone->write_bytes, zone->write_ns, num_workers),
+                          zone_rate(zone->read_bytes, zone->read_ns, num_workers),
+                          zone->max_write_ns / 1e6, zone->max_read_ns / 1e6);
+        else
+            fprintf(file, "%s\n    {\"offset\": %" PRIu64 ", \"length\": %" PRIu64 ", "
+                          "\"write_mb_s\": %.1f, \"read_mb_s\": %.1f, "
+                          "\"max_write_ms\": %.3f, \"max_read_ms\": %.3f}",
+                          (i > 0) ? "," : "", offset, len,
+                          zone_rate(zone->write_bytes, zone->write_ns, num_workers),
+                          zone_rate(zone->read_bytes, zone->read_ns, num_workers),
+                          zone->max_write_ns / 1e6, zone->max_read_ns / 1e6);
+    }
+
+    if (format == ZONES_FORMAT_JSON)
+        fprintf(file, "%s]\n}\n", (zones->num_zones > 0) ? "\n  " : "");
+
+    return !ferror(file);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2026, Pavel Golubinskiy
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef ZONES_H
+#define ZONES_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "ioengine.h"
+
+/*
+ * Throughput versus LBA. The disk is cut into fixed zones, 1 GiB unless
+ * asked otherwise, and every completed I/O adds its bytes, its latency
+ * and the time its worker spent on it to the zone it falls into. A
+ * worker's time is the gap since it last reaped completions, shared by the
+ * blocks it reaps, so the time of all zones adds up to the time the
+ * workers were busy, and a zone the drive crawls through takes a larger
+ * share of it. Zones grow on very
+ * large disks, so a profile never takes more than ZONES_MAX entries.
+ *
+ * Workers of a device update the zones concurrently, so every counter is
+ * atomic. The profile is exported as CSV or JSON at the end of a pass.
+ */
+
+#define ZONES_DEFAULT_SIZE (1024LL * 1024 * 1024)
+#define ZONES_MAX 65536
+#define ZONES_SUFFIX_CSV ".zones.csv"
+#define ZONES_SUFFIX_JSON ".zones.json"
+
+typedef struct zone_t {
+    _Atomic uint64_t write_bytes;
+    _Atomic uint64_t read_bytes;
+    _Atomic uint64_t write_ns;
+    _Atomic uint64_t read_ns;
+    _Atomic uint64_t max_write_ns;
+    _Atomic uint64_t max_read_ns;
+} zone_t;
+
+typedef struct zones_t {
+    zone_t *zones;
+    uint64_t num_zones;
+    off_t zone_size;
+    off_t disk_size;
+} zones_t;
+
+typedef enum {
+    ZONES_FORMAT_CSV = 0,
+    ZONES_FORMAT_JSON
+} zones_format_t;
+
+typedef enum {
+    ZONES_CHECK_OK = 0,
+    ZONES_CHECK_ERR_MEM_ALLOC,
+    ZONES_CHECK_ERR_UNKNOWN_FORMAT,
+    ZONES_CHECK_ERR_IO
+} zones_check_t;
+
+zones_check_t zones_init(zones_t*, off_t, off_t);
+void zones_reset(zones_t*);
+void zones_record(zones_t*, io_op_t, off_t, uint64_t, uint64_t, uint64_t);
+zones_check_t zones_parse_format(const char*, zones_format_t*);
+const char *zones_suffix(zones_format_t);
+zones_check_t zones_export(zones_t*, const char*, zones_format_t, const char*, unsigned int,
+                           unsigned int);
+void zones_destroy(zones_t*);
+
+#endif